@@ -1,21 +1,44 @@
+#include <charconv>
 #include <fstream>
-#include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include "scanner.hpp"
+#include "source_file.hpp"
+#include "bytecode_cache.hpp"
+#include "native_module.hpp"
+#include "vm.hpp"
 
 
 
 class Axiom{
 public:
     inline static bool hadError = false;
+    inline static bool hadRuntimeError = false;
 
     static int main(int argc, char*argv[]){
-        if (argc > 2) {
-            std::cout << "Usage: axiom [script]\n";
+        Options options;
+        bool badFlag = false;
+        for (; argc > 1 && std::string_view(argv[1]).substr(0, 2) == "--"; argc--, argv++) {
+            std::string_view flag = argv[1];
+            if (flag == "--no-cache") options.useCache = false;
+            else if (flag == "--opt-stats") options.optStats = true;
+            else if (flag == "--ic-stats") options.icStats = true;
+            else if (flag == "--gc-stats") options.gcStats = true;
+            else if (flag == "--jit-stats") options.jitStats = true;
+            else if (flag == "--profile") options.profile = true;
+            else if (flag == "--profile-ops") options.profile = options.profileOps = true;
+            else if (!sizeFlag(flag, "--nursery=", 1 << 10, &heapConfig.nurseryBytes) &&
+                     !sizeFlag(flag, "--heap=", 1 << 20, &heapConfig.heapBytes)) {
+                badFlag = true;
+            }
+        }
+        if (argc > 2 || badFlag) {
+            std::cout << "Usage: axiom [--no-cache] [--opt-stats] [--ic-stats] [--gc-stats] [--jit-stats] [--profile] [--profile-ops] [--nursery=KB] [--heap=MB] [script]\n";
             hadError = true;
         } else if (argc == 2) {
-            runFile(argv[1]);
+            runFile(argv[1], options);
         } else {
             runPrompt();
         }
@@ -24,55 +47,159 @@ public:
     }
 
 private:
-    static void runFile(const std::string& path) {
-        std::ifstream file(path, std::ios::binary);
-        if (!file) {
+    struct Options {
+        bool useCache = true;
+        bool optStats = false;   // instruction counts before and after the optimizer
+        bool icStats = false;    // inline cache hit rate after the run
+        bool gcStats = false;    // collections and pause times after the run
+        bool jitStats = false;   // functions compiled to machine code
+        bool profile = false;    // sample the run, see writeProfile()
+        bool profileOps = false; // and count every opcode executed
+    };
+
+    inline static HeapConfig heapConfig;
+
+    // `--name=N`: stores N * unit in `bytes`. False if `flag` is not `name`
+    // or N is not a positive number.
+    static bool sizeFlag(std::string_view flag, std::string_view name, size_t unit, size_t* bytes) {
+        if (flag.substr(0, name.size()) != name) return false;
+        flag.remove_prefix(name.size());
+        size_t count = 0;
+        auto [end, error] = std::from_chars(flag.data(), flag.data() + flag.size(), count);
+        if (error != std::errc() || end != flag.data() + flag.size() || count == 0) return false;
+        *bytes = count * unit;
+        return true;
+    }
+
+    static void runFile(const std::string& path, const Options& options) {
+        // "-" reads the script from stdin. The scanner gets a view of the
+        // mapped (or buffered) bytes, so the source is never copied.
+        SourceFile file;
+        if (!file.open(path)) {
             std::cerr << "Could not open file: " << path << "\n";
             std::exit(65);
         }
 
-        std::ostringstream buffer;
-        buffer << file.rdbuf();
-        run(buffer.str());
+        // A cache next to the script holds its compiled bytecode; a hit
+        // skips scanning and compiling.
+        ObjFunction* script = nullptr;
+        std::string cachePath = BytecodeCache::pathFor(path);
+        bool useCache = options.useCache && path != "-";
+        if (useCache) {
+            SourceFile cache;
+            if (cache.open(cachePath)) {
+                script = BytecodeCache::deserialize(cache.view(), file.view(), vm().heap, vm().symbols, vm().globals);
+            }
+        }
+        if (!script) {
+            script = vm().compile(file.view());
+            if (!script) hadError = true;
+            else if (useCache) {
+                BytecodeCache::write(cachePath, BytecodeCache::serialize(script, file.view(), vm().symbols, vm().globals));
+            }
+            if (script && options.optStats) printOptimizerStats(vm().optimizerStats);
+        } else if (options.optStats) {
+            std::cerr << "optimizer: loaded from " << cachePath << ", nothing compiled\n";
+        }
+        Profiler profiler(std::chrono::microseconds(1000), options.profileOps);
+        if (script && options.profile) {
+            if (!profiler.start()) std::cerr << "profile: sampling is not supported here\n";
+            vm().profiler = &profiler;
+        }
+        if (script && vm().interpret(script) == InterpretResult::RUNTIME_ERROR) hadRuntimeError = true;
+        if (script && options.profile) {
+            profiler.stop();
+            vm().profiler = nullptr;
+            writeProfile(profiler, path);
+        }
+        if (script && options.icStats) {
+            const InlineCacheStats& stats = vm().cacheStats;
+            std::cerr << "inline caches: " << stats.hits << " hits, " << stats.misses << " misses ("
+                      << std::fixed << std::setprecision(1) << stats.hitRate() * 100 << "% hit rate)\n";
+        }
+        if (script && options.gcStats) printGcStats(vm().heap.gcStats());
+        if (script && options.jitStats) printJitStats();
 
         if (hadError) std::exit(65);
+        if (hadRuntimeError) std::exit(70);
+    }
+
+    // Folded stacks for a flame graph go next to the script (script.folded,
+    // or axiom.folded for stdin); the summary goes to stderr.
+    static void writeProfile(const Profiler& profiler, const std::string& path) {
+        std::string foldedPath = path == "-" ? "axiom.folded" : path;
+        if (foldedPath.size() > 3 && foldedPath.compare(foldedPath.size() - 3, 3, ".ax") == 0) {
+            foldedPath.resize(foldedPath.size() - 3);
+        }
+        foldedPath += ".folded";
+        std::ofstream folded(foldedPath);
+        profiler.writeFolded(folded);
+        profiler.writeSummary(std::cerr);
+        std::cerr << "profile: stacks written to " << foldedPath << (folded ? "\n" : " failed\n");
+    }
+
+    static void printOptimizerStats(const OptimizerStats& stats) {
+        std::cerr << "optimizer: " << stats.before << " -> " << stats.after << " instructions ("
+                  << stats.folded << " folded, " << stats.deadBranches << " constant branches, "
+                  << stats.increments << " increments, " << stats.fusedJumps << " fused jumps, "
+                  << stats.superinstructions << " superinstructions, " << stats.removed << " removed)\n";
+    }
+
+    static void printJitStats() {
+#ifdef AXIOM_JIT
+        const JitStats& stats = vm().jitStats;
+        std::cerr << "jit: " << stats.compiled << " functions compiled (" << stats.codeBytes << " bytes), "
+                  << stats.rejected << " rejected, " << stats.entries << " entries\n";
+#else
+        std::cerr << "jit: not built in (build with -DAXIOM_JIT)\n";
+#endif
+    }
+
+    static void printGcStats(const GcStats& stats) {
+        auto ms = [](std::chrono::nanoseconds pause) { return pause.count() / 1e6; };
+        std::cerr << std::fixed << std::setprecision(2) << "gc: " << stats.minorCollections << " minor ("
+                  << ms(stats.minorPause) << " ms), " << stats.majorCollections << " major (" << ms(stats.majorPause)
+                  << " ms), longest pause " << ms(stats.maxPause) << " ms; " << stats.promotedBytes / 1024
+                  << " KB promoted, " << stats.freedBytes / 1024 << " KB freed, " << stats.oldBytes / 1024
+                  << " KB old\n";
     }
 
     static void runPrompt() {
         std::string line;
         for (;;) {
             std::cout << "> ";
-            if (line.empty()) continue;
             if (!std::getline(std::cin, line)) {
                 std::cout << "\n";
                 break;
             }
-            run(line);
-            hadError = false;
-        }
-    }
+            if (line.empty()) continue;
 
-    static void run(const std::string& source) {
-        // Placeholder for actual interpretation logic
-        std::cout << "Running source:\n" << source << "\n";
-        Scanner scanner(source);
-        auto tokens = scanner.scanTokens();
-        for (const auto& token : tokens) {
-            std::cout << token.toString() << "\n";
+            // A line ending in ':' opens a block; read until a blank line.
+            std::string source = line;
+            size_t last = line.find_last_not_of(" \t\r");
+            if (last != std::string::npos && line[last] == ':') {
+                while (std::cout << "... " && std::getline(std::cin, line) && !line.empty()) source += "\n" + line;
+            }
+            run(source);
+            hadError = false;
+            hadRuntimeError = false;
         }
     }
 
-    static void error(int line, const std::string& message) {
-        report(line, "", message);
+    static VM& vm() {
+        static VM instance(std::cout, std::cin, std::cerr, heapConfig);
+        static bool modules = (NativeModules::install(instance), true);
+        (void)modules;
+        return instance;
     }
 
-    static void report(int line, const std::string& where, const std::string& message) {
-        std::cerr << "[line " << line << "] Error" << where << ": " << message << "\n";
-        hadError = true;
+    static void run(std::string_view source) {
+        InterpretResult result = vm().interpret(source);
+        if (result == InterpretResult::COMPILE_ERROR) hadError = true;
+        if (result == InterpretResult::RUNTIME_ERROR) hadRuntimeError = true;
     }
 };
 
-
 int main(int argc, char* argv[]){
     return Axiom::main(argc, argv);
 }
@@ -0,0 +1,414 @@
+#include "../scanner.hpp"
+#include "../parallel_scanner.hpp"
+#include "../vm.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+// axiom_bench: throughput of each interpreter stage on deterministic
+// synthetic corpora.
+//
+//   axiom_bench [--size=MB] [--repeat=N] [--corpus=NAME] [--stage=NAME]
+//               [--format=table|csv|json] [--baseline=FILE.csv] [--tolerance=PCT]
+//
+// For every corpus/stage pair it reports MB/s, tokens/s, heap allocations per
+// token and the peak RSS reached while the stage ran. With --baseline it
+// compares MB/s against an earlier --format=csv run and exits with status 1
+// if any pair got slower by more than the tolerance (default 10%).
+
+// ---- allocation counting ---------------------------------------------------
+
+// Atomic because the scan-parallel stage allocates on worker threads.
+static std::atomic<size_t> allocationCount {0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+// GCC sees free() on what it takes for operator new's memory; here operator
+// new is malloc, so the pairing is right.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
+
+// ---- corpora ---------------------------------------------------------------
+
+struct Corpus {
+    const char* name;
+    std::string (*generate)(size_t bytes);
+};
+
+static std::string deepIndent(size_t bytes) {
+    std::string out;
+    for (int block = 0; out.size() < bytes; block++) {
+        for (int depth = 0; depth < 24; depth++) {
+            out.append(depth * 4, ' ');
+            out += "if level" + std::to_string(depth) + " > " + std::to_string(block) + ":\n";
+        }
+        out.append(24 * 4, ' ');
+        out += "total += 1\n";
+    }
+    return out;
+}
+
+static std::string fstringHeavy(size_t bytes) {
+    std::string out;
+    for (int i = 0; out.size() < bytes; i++) {
+        out += "line = f\"user {name} has {count + " + std::to_string(i % 97) +
+               "} items, {{literal}} and {total / 3} left\"\n";
+    }
+    return out;
+}
+
+static std::string commentHeavy(size_t bytes) {
+    std::string out;
+    for (int i = 0; out.size() < bytes; i++) {
+        out += "// configuration block " + std::to_string(i) + ": values below are generated, do not edit\n";
+        if (i % 4 == 0) out += "enabled = true\n";
+    }
+    return out;
+}
+
+static std::string numberHeavy(size_t bytes) {
+    std::string out;
+    unsigned seed = 7;
+    for (int i = 0; out.size() < bytes; i++) {
+        out += "row = [";
+        for (int col = 0; col < 12; col++) {
+            seed = seed * 1103515245 + 12345;
+            out += std::to_string((seed >> 8) % 100000);
+            if (col % 3 == 0) out += "." + std::to_string((seed >> 4) % 1000);
+            out += col < 11 ? ", " : "]\n";
+        }
+    }
+    return out;
+}
+
+static std::string identifierHeavy(size_t bytes) {
+    static const char* names[] = {"alpha", "beta", "gamma", "deltaValue", "counter", "index", "result",
+                                  "accumulatedTotal", "x", "y", "temporary", "record", "item", "node"};
+    std::string out;
+    unsigned seed = 11;
+    for (int i = 0; out.size() < bytes; i++) {
+        for (int term = 0; term < 8; term++) {
+            seed = seed * 1103515245 + 12345;
+            out += names[(seed >> 8) % 14];
+            out += term == 0 ? " = " : term < 7 ? " + " : "\n";
+        }
+    }
+    return out;
+}
+
+// Small methods-and-fields functions, each run in a loop so that property
+// sites are hit repeatedly and the run stage measures inline caches.
+static std::string attributeHeavy(size_t bytes) {
+    static const char* fields[] = {"x", "y", "width", "height", "count"};
+    std::string out;
+    for (int i = 0; out.size() < bytes; i++) {
+        const char* a = fields[i % 5];
+        const char* b = fields[(i / 5) % 5];
+        std::string name = "walk" + std::to_string(i);
+        out += "def " + name + "(p):\n    i = 0\n    while i < 20:\n";
+        out += "        p." + std::string(a) + " = p." + b + " + p.area() % 7\n";
+        out += "        i += 1\n    return p." + std::string(a) + "\n";
+        out += "total += " + name + "(" + (i % 2 ? "box" : "point") + ")\n";
+    }
+    return out;
+}
+
+// Functions that spend their time in tight loops over locals: counting,
+// arithmetic, comparisons and small list and string work, the shape the
+// dispatch loop matters most for.
+static std::string loopHeavy(size_t bytes) {
+    std::string out;
+    for (int i = 0; out.size() < bytes; i++) {
+        std::string name = "spin" + std::to_string(i);
+        std::string k = std::to_string(i % 5 + 2);
+        switch (i % 3) {
+            case 0:
+                out += "def " + name + "(n):\n    total = 0\n    i = 0\n    while i < n:\n"
+                       "        total = total + i * " + k + " - 1\n        i++\n    return total\n";
+                break;
+            case 1:
+                out += "def " + name + "(n):\n    odd = 0\n    for i in range(n):\n"
+                       "        if i % " + k + " == 1:\n            odd += i\n    return odd\n";
+                break;
+            default:
+                out += "def " + name + "(n):\n    a = 0\n    b = 1\n    for i in range(n):\n"
+                       "        c = a + b\n        a = b\n        b = c % 1000\n    return b\n";
+                break;
+        }
+        out += "total += " + name + "(2000)\n";
+    }
+    return out;
+}
+
+// Small recursive functions, most of them tail recursive, so the run stage
+// measures calls and returns. The tail-recursive ones recurse deeper than
+// the frame stack and only finish because their calls reuse the frame.
+static std::string callHeavy(size_t bytes) {
+    std::string out;
+    for (int i = 0; out.size() < bytes; i++) {
+        std::string n = std::to_string(i);
+        std::string k = std::to_string(i % 5 + 2);
+        switch (i % 3) {
+            case 0:
+                out += "def fib" + n + "(n):\n    if n < 2: return n\n    return fib" + n + "(n - 1) + fib" + n +
+                       "(n - 2)\ntotal += fib" + n + "(12)\n";
+                break;
+            case 1:
+                out += "def sum" + n + "(n, acc):\n    if n == 0: return acc\n    return sum" + n + "(n - 1, acc + n * " + k +
+                       ")\ntotal += sum" + n + "(2000, 0)\n";
+                break;
+            default:
+                out += "def even" + n + "(n):\n    if n == 0: return 1\n    return odd" + n + "(n - 1)\n";
+                out += "def odd" + n + "(n):\n    if n == 0: return 0\n    return even" + n + "(n - 1)\n";
+                out += "total += even" + n + "(100" + k + ")\n";
+                break;
+        }
+    }
+    return out;
+}
+
+static const Corpus corpora[] = {
+    {"deep-indent", deepIndent},
+    {"fstring-heavy", fstringHeavy},
+    {"comment-heavy", commentHeavy},
+    {"number-heavy", numberHeavy},
+    {"identifier-heavy", identifierHeavy},
+    {"attribute-heavy", attributeHeavy},
+    {"loop-heavy", loopHeavy},
+    {"call-heavy", callHeavy},
+};
+
+// Defines every free name the corpora read so the run stage executes them
+// to the end instead of stopping at the first undefined variable.
+static std::string prelude() {
+    std::string out = "total = 0\nname = \"bench\"\ncount = 3\nenabled = false\n";
+    for (int depth = 0; depth < 24; depth++) out += "level" + std::to_string(depth) + " = 1000000\n";
+    for (const char* name : {"alpha", "beta", "gamma", "deltaValue", "counter", "index", "result",
+                             "accumulatedTotal", "x", "y", "temporary", "record", "item", "node"}) {
+        out += std::string(name) + " = 1\n";
+    }
+    // Two classes whose instances end up with different shapes
+    out += "class Shape:\n    def init(w, h):\n        this.width = w\n        this.height = h\n"
+           "        this.x = 0\n        this.y = 0\n        this.count = 0\n"
+           "    def area():\n        return this.width * this.height\n";
+    out += "class Box(Shape):\n    def init(w, h):\n        this.count = 1\n        super.init(w, h)\n";
+    out += "point = Shape(2, 3)\nbox = Box(4, 5)\n";
+    return out;
+}
+
+// ---- stages ----------------------------------------------------------------
+
+// A stage processes a whole source; what it returns only keeps the work
+// from being optimized away.
+struct Stage {
+    const char* name;
+    std::function<size_t(std::string_view)> run;
+};
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+static const std::vector<Stage>& stages() {
+    static const std::vector<Stage> all = {
+        {"scan", [](std::string_view source) { return Scanner(source).scanTokens().size(); }},
+        {"scan-stream", [](std::string_view source) {
+            Scanner scanner(source);
+            size_t count = 0;
+            for (auto it = scanner.begin(); it != scanner.end(); ++it) count++;
+            return count;
+        }},
+        {"scan-parallel", [](std::string_view source) { return ParallelScanner(source).scanTokens().size(); }},
+        {"compile", [](std::string_view source) {
+            Heap heap;
+            Interner symbols;
+            Globals globals;
+            ObjFunction* script = Compiler(heap, symbols, globals).compile(source);
+            return script ? script->chunk.code.size() : 0;
+        }},
+        {"compile-opt", [](std::string_view source) {
+            Heap heap;
+            Interner symbols;
+            Globals globals;
+            OptimizerStats stats;
+            Optimizer optimizer(heap, stats);
+            ObjFunction* script = Compiler(heap, symbols, globals, &optimizer).compile(source);
+            return script ? script->chunk.code.size() : 0;
+        }},
+        {"run", [](std::string_view source) {
+            NullBuffer discard;
+            std::ostream out(&discard);
+            std::istringstream in;
+            VM vm(out, in, out);
+            return static_cast<size_t>(vm.interpret(source));
+        }},
+    };
+    return all;
+}
+
+// ---- measurement -----------------------------------------------------------
+
+struct Result {
+    std::string corpus;
+    std::string stage;
+    size_t bytes;
+    size_t tokens;
+    double seconds;
+    double allocationsPerToken;
+    long peakRssKb;
+};
+
+static void resetPeakRss() {
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs) clearRefs << "5";
+#endif
+}
+
+static long peakRssKb() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::strtol(line.c_str() + 6, nullptr, 10);
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) return usage.ru_maxrss;
+#endif
+    return 0;
+}
+
+static Result measure(const Corpus& corpus, const std::string& source, size_t tokens, const Stage& stage,
+                      int repeat) {
+    Result result {corpus.name, stage.name, source.size(), tokens, 1e30, 0, 0};
+
+    resetPeakRss();
+    size_t before = allocationCount;
+    stage.run(source);
+    result.allocationsPerToken = double(allocationCount - before) / std::max<size_t>(result.tokens, 1);
+    result.peakRssKb = peakRssKb();
+
+    for (int r = 0; r < repeat; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        stage.run(source);
+        auto t1 = std::chrono::steady_clock::now();
+        result.seconds = std::min(result.seconds, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return result;
+}
+
+static double megabytesPerSecond(const Result& r) { return r.bytes / r.seconds / 1e6; }
+static double tokensPerSecond(const Result& r) { return r.tokens / r.seconds; }
+
+static void print(const std::vector<Result>& results, const std::string& format) {
+    if (format == "csv") {
+        std::printf("corpus,stage,bytes,tokens,seconds,mb_per_s,tokens_per_s,allocs_per_token,peak_rss_kb\n");
+        for (const Result& r : results) {
+            std::printf("%s,%s,%zu,%zu,%.6f,%.2f,%.0f,%.4f,%ld\n", r.corpus.c_str(), r.stage.c_str(), r.bytes,
+                        r.tokens, r.seconds, megabytesPerSecond(r), tokensPerSecond(r), r.allocationsPerToken,
+                        r.peakRssKb);
+        }
+    } else if (format == "json") {
+        std::printf("[\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            std::printf("  {\"corpus\": \"%s\", \"stage\": \"%s\", \"bytes\": %zu, \"tokens\": %zu, "
+                        "\"seconds\": %.6f, \"mb_per_s\": %.2f, \"tokens_per_s\": %.0f, "
+                        "\"allocs_per_token\": %.4f, \"peak_rss_kb\": %ld}%s\n",
+                        r.corpus.c_str(), r.stage.c_str(), r.bytes, r.tokens, r.seconds, megabytesPerSecond(r),
+                        tokensPerSecond(r), r.allocationsPerToken, r.peakRssKb, i + 1 < results.size() ? "," : "");
+        }
+        std::printf("]\n");
+    } else {
+        std::printf("%-18s %-14s %10s %14s %12s %12s\n", "corpus", "stage", "MB/s", "tokens/s", "allocs/tok",
+                    "peak RSS KB");
+        for (const Result& r : results) {
+            std::printf("%-18s %-14s %10.1f %14.0f %12.4f %12ld\n", r.corpus.c_str(), r.stage.c_str(),
+                        megabytesPerSecond(r), tokensPerSecond(r), r.allocationsPerToken, r.peakRssKb);
+        }
+    }
+}
+
+// Compares MB/s with a previous --format=csv run; returns false on regression.
+static bool compareWithBaseline(const std::vector<Result>& results, const std::string& path, double tolerance) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open baseline: " << path << "\n";
+        return false;
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::getline(file, line); // header
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields;
+        std::stringstream row(line);
+        for (std::string field; std::getline(row, field, ',');) fields.push_back(field);
+        if (fields.size() >= 6) baseline[fields[0] + "/" + fields[1]] = std::strtod(fields[5].c_str(), nullptr);
+    }
+
+    bool ok = true;
+    for (const Result& r : results) {
+        auto it = baseline.find(r.corpus + "/" + r.stage);
+        if (it == baseline.end() || it->second <= 0) continue;
+        double change = (megabytesPerSecond(r) - it->second) / it->second * 100;
+        if (change < -tolerance) {
+            std::fprintf(stderr, "REGRESSION %s/%s: %.1f -> %.1f MB/s (%.1f%%)\n", r.corpus.c_str(),
+                         r.stage.c_str(), it->second, megabytesPerSecond(r), change);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static std::string option(int argc, char* argv[], const std::string& name, const std::string& fallback) {
+    std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], prefix.c_str(), prefix.size()) == 0) return argv[i] + prefix.size();
+    }
+    return fallback;
+}
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = std::stoul(option(argc, argv, "size", "8"));
+    int repeat = std::stoi(option(argc, argv, "repeat", "3"));
+    std::string onlyCorpus = option(argc, argv, "corpus", "");
+    std::string onlyStage = option(argc, argv, "stage", "");
+    std::string format = option(argc, argv, "format", "table");
+    std::string baseline = option(argc, argv, "baseline", "");
+    double tolerance = std::stod(option(argc, argv, "tolerance", "10"));
+
+    std::vector<Result> results;
+    for (const Corpus& corpus : corpora) {
+        if (!onlyCorpus.empty() && onlyCorpus != corpus.name) continue;
+        std::string source = prelude() + corpus.generate(megabytes << 20);
+        size_t tokens = Scanner(source).scanTokens().size();
+        for (const Stage& stage : stages()) {
+            if (!onlyStage.empty() && onlyStage != stage.name) continue;
+            results.push_back(measure(corpus, source, tokens, stage, repeat));
+        }
+    }
+
+    print(results, format);
+    if (!baseline.empty() && !compareWithBaseline(results, baseline, tolerance)) return 1;
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "../object.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The runtime's dict and list storage against the standard containers a
+// straightforward implementation would use, on insert, lookup and
+// iteration. Keys are ints and short strings; the standard map hashes and
+// compares through the same hashValue and valuesEqual as the dict.
+
+struct ValueHash {
+    size_t operator()(Value key) const {
+        uint64_t hash = 0;
+        hashValue(key, &hash);
+        return static_cast<size_t>(hash);
+    }
+};
+struct ValueEqual {
+    bool operator()(Value a, Value b) const { return valuesEqual(a, b); }
+};
+using StdMap = std::unordered_map<Value, Value, ValueHash, ValueEqual>;
+
+template <class F>
+static double bestOf(int runs, F&& body) {
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        body();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+static void report(const char* keys, const char* what, size_t operations, double seconds) {
+    std::printf("%-8s %-28s %8.1f ns/op\n", keys, what, seconds / operations * 1e9);
+}
+
+static void benchDicts(Heap& heap, const char* name, const std::vector<Value>& keys) {
+    volatile int64_t sink = 0;
+    size_t n = keys.size();
+
+    report(name, "insert/dict", n, bestOf(5, [&] {
+        ObjDict dict;
+        for (size_t i = 0; i < n; i++) dictSet(&dict, keys[i], Value::integer(static_cast<int64_t>(i)));
+        sink = sink + static_cast<int64_t>(dict.table.size());
+    }));
+    report(name, "insert/unordered_map", n, bestOf(5, [&] {
+        StdMap map;
+        for (size_t i = 0; i < n; i++) map[keys[i]] = Value::integer(static_cast<int64_t>(i));
+        sink = sink + static_cast<int64_t>(map.size());
+    }));
+
+    ObjDict dict;
+    StdMap map;
+    for (size_t i = 0; i < n; i++) {
+        dictSet(&dict, keys[i], Value::integer(static_cast<int64_t>(i)));
+        map[keys[i]] = Value::integer(static_cast<int64_t>(i));
+    }
+    report(name, "lookup/dict", n, bestOf(5, [&] {
+        int64_t total = 0;
+        Value value;
+        for (Value key : keys) total += dictGet(&dict, key, &value) ? value.asInt() : 0;
+        sink = sink + total;
+    }));
+    report(name, "lookup/unordered_map", n, bestOf(5, [&] {
+        int64_t total = 0;
+        for (Value key : keys) total += map.find(key)->second.asInt();
+        sink = sink + total;
+    }));
+    report(name, "iterate/dict", n, bestOf(5, [&] {
+        int64_t total = 0;
+        for (const DictTable::Entry& entry : dict.table) total += entry.value.asInt();
+        sink = sink + total;
+    }));
+    report(name, "iterate/unordered_map", n, bestOf(5, [&] {
+        int64_t total = 0;
+        for (const auto& entry : map) total += entry.second.asInt();
+        sink = sink + total;
+    }));
+    (void)heap;
+}
+
+// Many short lists, the common shape in scripts, then one long one.
+static void benchLists(size_t n) {
+    volatile int64_t sink = 0;
+    const size_t lists = n / 3;
+    report("lists", "build 3 items/ValueList", lists, bestOf(5, [&] {
+        int64_t total = 0;
+        for (size_t i = 0; i < lists; i++) {
+            ValueList items;
+            for (int64_t k = 0; k < 3; k++) items.push_back(Value::integer(k));
+            total += static_cast<int64_t>(items.size());
+        }
+        sink = sink + total;
+    }));
+    report("lists", "build 3 items/vector", lists, bestOf(5, [&] {
+        int64_t total = 0;
+        for (size_t i = 0; i < lists; i++) {
+            std::vector<Value> items;
+            for (int64_t k = 0; k < 3; k++) items.push_back(Value::integer(k));
+            total += static_cast<int64_t>(items.size());
+        }
+        sink = sink + total;
+    }));
+    report("lists", "append/ValueList", n, bestOf(5, [&] {
+        ValueList items;
+        for (size_t i = 0; i < n; i++) items.push_back(Value::integer(static_cast<int64_t>(i)));
+        sink = sink + static_cast<int64_t>(items.size());
+    }));
+    report("lists", "append/vector", n, bestOf(5, [&] {
+        std::vector<Value> items;
+        for (size_t i = 0; i < n; i++) items.push_back(Value::integer(static_cast<int64_t>(i)));
+        sink = sink + static_cast<int64_t>(items.size());
+    }));
+
+    ValueList list;
+    std::vector<Value> vector;
+    for (size_t i = 0; i < n; i++) {
+        list.push_back(Value::integer(static_cast<int64_t>(i)));
+        vector.push_back(Value::integer(static_cast<int64_t>(i)));
+    }
+    report("lists", "iterate/ValueList", n, bestOf(5, [&] {
+        int64_t total = 0;
+        for (Value item : list) total += item.asInt();
+        sink = sink + total;
+    }));
+    report("lists", "iterate/vector", n, bestOf(5, [&] {
+        int64_t total = 0;
+        for (Value item : vector) total += item.asInt();
+        sink = sink + total;
+    }));
+}
+
+int main(int argc, char* argv[]) {
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    Heap heap(HeapConfig {size_t(256) << 20, size_t(256) << 20});
+    Heap::Tenured tenured(heap);
+
+    std::vector<Value> ints, strings;
+    for (size_t i = 0; i < n; i++) {
+        ints.push_back(Value::integer(static_cast<int64_t>(i * 7919)));
+        strings.push_back(Value::object(heap.makeString("key" + std::to_string(i))));
+    }
+    benchDicts(heap, "ints", ints);
+    benchDicts(heap, "strings", strings);
+    benchLists(n);
+    return 0;
+}
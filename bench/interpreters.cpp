@@ -0,0 +1,56 @@
+#include "../interpreter.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Throughput of InterpreterPool on many small independent scripts, the
+// shape of a service evaluating user snippets, at 1, 2, 4, ... threads up to
+// the core count. Each script builds a few values, loops and prints, and
+// runs in a fresh Interpreter.
+
+static std::string script(int i) {
+    std::string n = std::to_string(i % 97 + 1);
+    return "def score(xs):\n"
+           "    total = 0\n"
+           "    for x in xs:\n"
+           "        total += x * x\n"
+           "    return total\n"
+           "items = []\n"
+           "for i in range(200):\n"
+           "    items += [i % " + n + " + 1]\n"
+           "counts = {\"a\": 1, \"b\": 2}\n"
+           "print f\"{score(items)} {len(counts)}\"\n";
+}
+
+static double run(unsigned threads, const std::vector<std::string>& scripts) {
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        InterpreterPool pool(threads, HeapConfig {64 * 1024, size_t(4) << 20});
+        std::vector<std::future<ScriptResult>> results;
+        results.reserve(scripts.size());
+        for (const std::string& source : scripts) results.push_back(pool.submit(source));
+        size_t failed = 0;
+        for (auto& result : results) failed += result.get().status != InterpretResult::OK;
+        if (failed) std::printf("%zu scripts failed\n", failed);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 20000;
+    std::vector<std::string> scripts;
+    for (size_t i = 0; i < count; i++) scripts.push_back(script(static_cast<int>(i)));
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    double single = 0;
+    for (unsigned threads = 1; threads <= cores; threads *= 2) {
+        double best = 1e30;
+        for (int r = 0; r < 3; r++) best = std::min(best, run(threads, scripts));
+        if (threads == 1) single = best;
+        std::printf("%2u threads %10.0f scripts/s  %5.2fx\n", threads, count / best, single / best);
+        if (threads < cores && threads * 2 > cores) threads = cores / 2; // end on the core count
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "../scanner.hpp"
+#include "../scan_kernels.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Throughput of the scanner's run-skipping kernels on comment-heavy and
+// string-heavy input. Each kernel set this CPU supports is timed directly;
+// the end-to-end scanTokens() figure uses the set the scanner selected, so
+// run once more with AXIOM_SCAN_ISA=scalar to compare whole-scanner speed.
+
+static std::string commentHeavy(size_t bytes) {
+    std::string out;
+    int i = 0;
+    while (out.size() < bytes) {
+        out += "// the quick brown fox jumps over the lazy dog, again and again, line ";
+        out += std::to_string(i++);
+        out += "\n";
+        if (i % 8 == 0) out += "x = x + 1\n";
+    }
+    return out;
+}
+
+static std::string stringHeavy(size_t bytes) {
+    std::string out;
+    int i = 0;
+    while (out.size() < bytes) {
+        out += "message = \"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod ";
+        out += std::to_string(i++);
+        out += (i % 4 == 0) ? "\\n tempor\"\n" : " tempor incididunt\"\n";
+    }
+    return out;
+}
+
+template <class F>
+static double bestOf(int runs, F&& body) {
+    double best = 1e30;
+    for (int r = 0; r < runs; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        body();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+static void report(const char* corpus, const char* what, size_t bytes, double seconds) {
+    std::printf("%-14s %-22s %10.1f MB/s\n", corpus, what, bytes / seconds / 1e6);
+}
+
+static void benchCorpus(const char* corpus, const std::string& text, bool strings) {
+    const ScanKernels* all[3];
+    int count = availableScanKernels(all);
+    const char* end = text.data() + text.size();
+    volatile size_t sink = 0;
+
+    for (int k = 0; k < count; k++) {
+        const ScanKernels& kernels = *all[k];
+        double seconds = bestOf(5, [&] {
+            const char* p = text.data();
+            size_t stops = 0;
+            while (p < end) {
+                p = strings ? kernels.skipStringBody(p, end) : kernels.skipToNewline(p, end);
+                if (p < end) p++;
+                stops++;
+            }
+            sink = sink + stops;
+        });
+        report(corpus, (std::string("kernel/") + kernels.name).c_str(), text.size(), seconds);
+    }
+
+    double seconds = bestOf(5, [&] {
+        Scanner scanner(text);
+        sink = sink + scanner.scanTokens().size();
+    });
+    report(corpus, (std::string("scanTokens/") + scanKernels().name).c_str(), text.size(), seconds);
+}
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 16;
+    benchCorpus("comment-heavy", commentHeavy(megabytes << 20), false);
+    benchCorpus("string-heavy", stringHeavy(megabytes << 20), true);
+    return 0;
+}
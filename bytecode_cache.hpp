@@ -0,0 +1,381 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "chunk.hpp"
+#include "globals.hpp"
+#include "interner.hpp"
+#include "object.hpp"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// Precompiled scripts (.axc). A cache file holds the compiled functions of
+// one script, keyed by a hash of the source bytes and the interpreter's
+// bytecode version, so a hit skips scanning and compiling entirely.
+//
+// The layout is flat and position independent, so the file can be mapped and
+// read in place. Everything that depends on the interpreter instance is
+// relocated on load: global slots are stored as names and re-resolved, and
+// function constants refer to other functions by index.
+//
+//   header   magic "AXC\0", byte-order mark, BYTECODE_VERSION, payload
+//            checksum, source hash, source size
+//   globals  u32 count, then each name (u32 length + bytes), by file slot
+//   functions u32 count, callees before callers, the script last:
+//            name (u32 length + bytes, or NO_NAME), arity, slot count,
+//            generator flag, inline cache count, code, line runs, constants
+//
+// A constant is a kind byte followed by an i64 (INT), the bits of a double
+// (DOUBLE), a string (STRING) or a function index (FUNCTION).
+class BytecodeCache {
+public:
+    static uint64_t hashSource(std::string_view source) {
+        uint64_t hash = 14695981039346656037ull; // FNV-1a, 64-bit
+        for (char c : source) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // script.ax -> script.axc; anything else gets ".axc" appended.
+    static std::string pathFor(const std::string& scriptPath) {
+        if (scriptPath.size() > 3 && scriptPath.compare(scriptPath.size() - 3, 3, ".ax") == 0) return scriptPath + "c";
+        return scriptPath + ".axc";
+    }
+
+    static std::string serialize(const ObjFunction* script, std::string_view source, const Interner& symbols,
+                                 const Globals& globals) {
+        Writer writer(symbols, globals);
+        writer.function(script);
+
+        std::string payload;
+        put32(payload, static_cast<uint32_t>(writer.globalNames.size()));
+        for (SymbolId symbol : writer.globalNames) putString(payload, symbols.name(symbol));
+        put32(payload, static_cast<uint32_t>(writer.functions.size()));
+        payload += writer.body;
+
+        std::string out(MAGIC, sizeof(MAGIC));
+        put32(out, BYTE_ORDER_MARK);
+        put32(out, BYTECODE_VERSION);
+        put64(out, hashSource(payload));
+        put64(out, hashSource(source));
+        put64(out, source.size());
+        return out + payload;
+    }
+
+    // The cached script for `source`, or nullptr if the cache is stale,
+    // from another interpreter version, or damaged.
+    static ObjFunction* deserialize(std::string_view bytes, std::string_view source, Heap& heap, Interner& symbols,
+                                    Globals& globals) {
+        Reader in {bytes};
+        uint32_t byteOrder, version;
+        uint64_t checksum, sourceHash, sourceSize;
+        if (bytes.size() < sizeof(MAGIC) || std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0) return nullptr;
+        in.position = sizeof(MAGIC);
+        if (!in.get32(&byteOrder) || byteOrder != BYTE_ORDER_MARK) return nullptr;
+        if (!in.get32(&version) || version != BYTECODE_VERSION) return nullptr;
+        if (!in.get64(&checksum) || !in.get64(&sourceHash) || !in.get64(&sourceSize)) return nullptr;
+        if (sourceSize != source.size() || checksum != hashSource(bytes.substr(in.position))) return nullptr;
+        if (sourceHash != hashSource(source)) return nullptr;
+
+        uint32_t globalCount;
+        if (!in.get32(&globalCount)) return nullptr;
+        std::vector<int> globalSlots;
+        for (uint32_t i = 0; i < globalCount; i++) {
+            std::string_view name;
+            if (!in.getString(&name)) return nullptr;
+            int slot = globals.slot(symbols.intern(name));
+            if (slot < 0) return nullptr;
+            globalSlots.push_back(slot);
+        }
+
+        uint32_t functionCount;
+        if (!in.get32(&functionCount) || functionCount == 0) return nullptr;
+        Heap::Tenured tenured(heap);
+        std::vector<ObjFunction*> functions;
+        for (uint32_t i = 0; i < functionCount; i++) {
+            ObjFunction* function = readFunction(in, heap, functions, globalSlots);
+            if (!function) return nullptr;
+            functions.push_back(function);
+        }
+        if (in.position != bytes.size() || functions.back()->name || functions.back()->generator) return nullptr;
+        return functions.back();
+    }
+
+    // Writes through a temporary file and a rename, so a concurrent run
+    // never maps a half-written cache. Failure is silent: the cache is only
+    // an optimization.
+    static bool write(const std::string& path, const std::string& bytes) {
+#ifdef _WIN32
+        std::string temporary = path + ".tmp";
+#else
+        std::string temporary = path + ".tmp" + std::to_string(getpid());
+#endif
+        FILE* file = std::fopen(temporary.c_str(), "wb");
+        if (!file) return false;
+        bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        ok = std::fclose(file) == 0 && ok;
+        if (ok) {
+#ifdef _WIN32
+            std::remove(path.c_str());
+#endif
+            ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+        }
+        if (!ok) std::remove(temporary.c_str());
+        return ok;
+    }
+
+private:
+    static constexpr char MAGIC[4] = {'A', 'X', 'C', '\0'};
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static constexpr uint32_t NO_NAME = UINT32_MAX;
+    enum ConstantKind : uint8_t { INT, DOUBLE, STRING, FUNCTION };
+
+    static void put32(std::string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), 4); }
+    static void put64(std::string& out, uint64_t value) { out.append(reinterpret_cast<const char*>(&value), 8); }
+    static void putString(std::string& out, std::string_view text) {
+        put32(out, static_cast<uint32_t>(text.size()));
+        out.append(text);
+    }
+
+    struct Writer {
+        const Interner& symbols;
+        const Globals& globals;
+        std::string body;
+        std::unordered_map<const ObjFunction*, uint32_t> functions;
+        std::vector<SymbolId> globalNames;
+        std::unordered_map<int, uint32_t> fileSlots; // runtime global slot -> file slot
+
+        Writer(const Interner& symbols, const Globals& globals) : symbols(symbols), globals(globals) {}
+
+        uint32_t function(const ObjFunction* function) {
+            auto found = functions.find(function);
+            if (found != functions.end()) return found->second;
+
+            // Callees first, so every function index a constant names is
+            // already defined when the reader gets to it.
+            std::vector<uint32_t> callees;
+            for (Value constant : function->chunk.constants) {
+                if (isObjType(constant, ObjType::FUNCTION)) callees.push_back(this->function(asFunction(constant)));
+            }
+
+            if (function->name) putString(body, function->name->view());
+            else put32(body, NO_NAME);
+            put32(body, static_cast<uint32_t>(function->arity));
+            put32(body, static_cast<uint32_t>(function->slotCount));
+            put32(body, function->generator ? 1 : 0);
+            put32(body, static_cast<uint32_t>(function->caches.size()));
+            putString(body, relocatedCode(function->chunk.code));
+            put32(body, static_cast<uint32_t>(function->chunk.lines.size()));
+            for (const Chunk::LineRun& run : function->chunk.lines) {
+                put32(body, run.offset);
+                put32(body, static_cast<uint32_t>(run.line));
+            }
+            put32(body, static_cast<uint32_t>(function->chunk.constants.size()));
+            size_t callee = 0;
+            for (Value constant : function->chunk.constants) {
+                if (isInteger(constant)) {
+                    body += static_cast<char>(INT);
+                    put64(body, static_cast<uint64_t>(asInteger(constant)));
+                } else if (constant.isDouble()) {
+                    double d = constant.asDouble();
+                    uint64_t bits;
+                    std::memcpy(&bits, &d, sizeof(bits));
+                    body += static_cast<char>(DOUBLE);
+                    put64(body, bits);
+                } else if (isString(constant)) {
+                    body += static_cast<char>(STRING);
+                    putString(body, asString(constant)->view());
+                } else {
+                    body += static_cast<char>(FUNCTION);
+                    put32(body, callees[callee++]);
+                }
+            }
+
+            uint32_t index = static_cast<uint32_t>(functions.size());
+            functions.emplace(function, index);
+            return index;
+        }
+
+        // Global operands are rewritten from this VM's slots to file slots.
+        std::string relocatedCode(const std::vector<uint8_t>& code) {
+            std::string out(code.begin(), code.end());
+            for (size_t ip = 0; ip < code.size(); ip += 1 + operandBytes(static_cast<OpCode>(code[ip]))) {
+                OpCode op = static_cast<OpCode>(code[ip]);
+                if (op != OpCode::GET_GLOBAL && op != OpCode::SET_GLOBAL && op != OpCode::INC_GLOBAL) continue;
+                int slot = (code[ip + 1] << 8) | code[ip + 2];
+                auto [it, added] = fileSlots.try_emplace(slot, static_cast<uint32_t>(globalNames.size()));
+                if (added) globalNames.push_back(globals.symbols[slot]);
+                out[ip + 1] = static_cast<char>(it->second >> 8);
+                out[ip + 2] = static_cast<char>(it->second & 0xff);
+            }
+            return out;
+        }
+    };
+
+    // Bounds-checked reads over the mapped bytes.
+    struct Reader {
+        std::string_view bytes;
+        size_t position = 0;
+
+        bool get(void* out, size_t size) {
+            if (bytes.size() - position < size) return false;
+            std::memcpy(out, bytes.data() + position, size);
+            position += size;
+            return true;
+        }
+        bool get8(uint8_t* out) { return get(out, 1); }
+        bool get32(uint32_t* out) { return get(out, 4); }
+        bool get64(uint64_t* out) { return get(out, 8); }
+        bool getString(std::string_view* out) {
+            uint32_t length;
+            if (!get32(&length) || bytes.size() - position < length) return false;
+            *out = bytes.substr(position, length);
+            position += length;
+            return true;
+        }
+    };
+
+    static ObjFunction* readFunction(Reader& in, Heap& heap, const std::vector<ObjFunction*>& functions,
+                                     const std::vector<int>& globalSlots) {
+        uint32_t nameLength, arity, slotCount, generator, cacheCount, lineCount, constantCount;
+        std::string_view name, code;
+        if (!in.get32(&nameLength)) return nullptr;
+        if (nameLength != NO_NAME) {
+            in.position -= 4;
+            if (!in.getString(&name)) return nullptr;
+        }
+        if (!in.get32(&arity) || !in.get32(&slotCount) || !in.get32(&generator) || !in.get32(&cacheCount) ||
+            !in.getString(&code)) {
+            return nullptr;
+        }
+        if (slotCount < 1 || slotCount > 256 || arity >= slotCount || generator > 1 || cacheCount > UINT16_MAX + 1u) {
+            return nullptr;
+        }
+
+        ObjFunction* function = heap.makeFunction();
+        if (nameLength != NO_NAME) function->name = heap.makeString(name);
+        function->arity = static_cast<int>(arity);
+        function->slotCount = static_cast<int>(slotCount);
+        function->generator = generator == 1;
+        function->caches.resize(cacheCount);
+        Chunk& chunk = function->chunk;
+        chunk.code.assign(code.begin(), code.end());
+
+        if (!in.get32(&lineCount)) return nullptr;
+        chunk.lines.resize(lineCount);
+        for (Chunk::LineRun& run : chunk.lines) {
+            uint32_t line;
+            if (!in.get32(&run.offset) || !in.get32(&line)) return nullptr;
+            run.line = static_cast<int>(line);
+        }
+
+        if (!in.get32(&constantCount)) return nullptr;
+        for (uint32_t i = 0; i < constantCount; i++) {
+            uint8_t kind;
+            uint64_t bits;
+            uint32_t index;
+            std::string_view text;
+            if (!in.get8(&kind)) return nullptr;
+            switch (kind) {
+                case INT:
+                    if (!in.get64(&bits)) return nullptr;
+                    chunk.constants.push_back(heap.makeInteger(static_cast<int64_t>(bits)));
+                    break;
+                case DOUBLE: {
+                    double d;
+                    if (!in.get64(&bits)) return nullptr;
+                    std::memcpy(&d, &bits, sizeof(d));
+                    chunk.constants.push_back(Value::number(d));
+                    break;
+                }
+                case STRING:
+                    if (!in.getString(&text)) return nullptr;
+                    chunk.constants.push_back(Value::object(heap.makeString(text)));
+                    break;
+                case FUNCTION:
+                    if (!in.get32(&index) || index >= functions.size()) return nullptr;
+                    chunk.constants.push_back(Value::object(functions[index]));
+                    break;
+                default:
+                    return nullptr;
+            }
+        }
+        return relocate(chunk, slotCount, cacheCount, globalSlots) ? function : nullptr;
+    }
+
+    // Checks that every instruction decodes and stays in bounds, and points
+    // global operands at this VM's slots.
+    static bool relocate(Chunk& chunk, uint32_t slotCount, uint32_t cacheCount, const std::vector<int>& globalSlots) {
+        std::vector<uint8_t>& code = chunk.code;
+        if (code.empty() || code.back() != static_cast<uint8_t>(OpCode::RETURN)) return false;
+        for (size_t ip = 0; ip < code.size();) {
+            if (code[ip] >= OPCODE_COUNT) return false;
+            OpCode op = static_cast<OpCode>(code[ip]);
+            size_t width = operandBytes(op);
+            if (code.size() - ip - 1 < width) return false;
+            const uint8_t* operand = &code[ip + 1];
+            uint16_t u16 = width >= 2 ? static_cast<uint16_t>((operand[0] << 8) | operand[1]) : 0;
+            size_t next = ip + 1 + width;
+            if (hasConstantOperand(op)) {
+                if (u16 >= chunk.constants.size()) return false;
+                // Every constant but CONSTANT's and LOCAL_OP_CONSTANT's names a
+                // property or class
+                if (op != OpCode::CONSTANT && op != OpCode::LOCAL_OP_CONSTANT && !isString(chunk.constants[u16])) {
+                    return false;
+                }
+                if (hasCacheOperand(op) && ((operand[2] << 8) | operand[3]) >= static_cast<int>(cacheCount)) return false;
+            }
+            switch (op) {
+                case OpCode::GET_LOCAL: case OpCode::SET_LOCAL: case OpCode::INC_LOCAL: case OpCode::STORE_LOCAL:
+                    if (operand[0] >= slotCount) return false;
+                    break;
+                case OpCode::GET_LOCALS:
+                    if (operand[0] >= slotCount || operand[1] >= slotCount) return false;
+                    break;
+                case OpCode::LOCAL_OP_CONSTANT: {
+                    OpCode arithmetic = static_cast<OpCode>(operand[3]);
+                    if (operand[2] >= slotCount || (arithmetic != OpCode::ADD && arithmetic != OpCode::SUBTRACT &&
+                                                    arithmetic != OpCode::MULTIPLY && arithmetic != OpCode::MODULO)) {
+                        return false;
+                    }
+                    break;
+                }
+                case OpCode::GET_GLOBAL: case OpCode::SET_GLOBAL: case OpCode::INC_GLOBAL: {
+                    if (u16 >= globalSlots.size()) return false;
+                    int slot = globalSlots[u16];
+                    code[ip + 1] = static_cast<uint8_t>(slot >> 8);
+                    code[ip + 2] = static_cast<uint8_t>(slot & 0xff);
+                    break;
+                }
+                case OpCode::JUMP: case OpCode::JUMP_IF_FALSE:
+                    if (next + u16 > code.size()) return false;
+                    break;
+                case OpCode::JUMP_UNLESS:
+                    if (next + u16 > code.size() || operand[2] < static_cast<uint8_t>(OpCode::EQUAL) ||
+                        operand[2] > static_cast<uint8_t>(OpCode::LESS_EQUAL)) {
+                        return false;
+                    }
+                    break;
+                case OpCode::LOOP:
+                    if (u16 > next) return false;
+                    break;
+                case OpCode::FOR_ITER: {
+                    uint16_t exit = static_cast<uint16_t>((operand[1] << 8) | operand[2]);
+                    if (operand[0] + 1u >= slotCount || next + exit > code.size()) return false;
+                    break;
+                }
+                default:
+                    break;
+            }
+            ip = next;
+        }
+        return true;
+    }
+};
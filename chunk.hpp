@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "value.hpp"
+
+// Operand widths: u8 = 1 byte, u16 = 2 bytes big-endian.
+enum class OpCode : uint8_t {
+    CONSTANT,       // u16 constant index
+    NONE, TRUE, FALSE,
+    POP,
+    DUP,
+    DUP2,
+    GET_LOCAL,      // u8 slot
+    SET_LOCAL,      // u8 slot (leaves the value on the stack)
+    GET_GLOBAL,     // u16 global slot
+    SET_GLOBAL,     // u16 global slot (leaves the value on the stack)
+    GET_INDEX,
+    SET_INDEX,      // [container, index, value] -> value
+    EQUAL, NOT_EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL,
+    ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO,
+    NOT, NEGATE,
+    BUILD_STRING,   // u8 piece count; formats any non-string pieces and joins them
+    PRINT,          // u8 value count
+    INPUT,          // u8 1 if a prompt is on the stack
+    JUMP,           // u16 forward offset
+    JUMP_IF_FALSE,  // u16 forward offset, condition stays on the stack
+    LOOP,           // u16 backward offset
+    FOR_ITER,       // u8 iterator slot, u16 exit offset; slot+1 holds the position
+    BUILD_LIST,     // u8 element count
+    EXTEND_LIST,    // u8 element count, appended to the list below them
+    BUILD_DICT,     // u8 pair count; key, value, key, value...
+    EXTEND_DICT,    // u8 pair count, added to the dict below them
+    CALL,           // u8 argument count
+    TAIL_CALL,      // u8 argument count; a CALL right before RETURN, reusing the caller's frame
+    CLASS,          // u16 name constant
+    INHERIT,        // [class, superclass] -> class
+    METHOD,         // u16 name constant; [class, function] -> class
+    GET_PROPERTY,   // u16 name constant, u16 inline cache
+    SET_PROPERTY,   // u16 name constant, u16 inline cache; [instance, value] -> value
+    INVOKE,         // u16 name constant, u16 inline cache, u8 argument count
+    GET_SUPER,      // u16 name constant; [this] -> bound method
+    SUPER_INVOKE,   // u16 name constant, u8 argument count
+    YIELD,          // [value] -> ; suspends the generator, handing value to its FOR_ITER
+    // Emitted only by the optimizer
+    INC_LOCAL,      // u8 slot, i8 delta
+    INC_GLOBAL,     // u16 global slot, i8 delta
+    JUMP_UNLESS,    // u16 forward offset, u8 comparison opcode; pops both operands
+    // Superinstructions for the commonest pairs in loops
+    STORE_LOCAL,    // u8 slot; SET_LOCAL + POP
+    GET_LOCALS,     // u8 slot, u8 slot; two GET_LOCALs
+    LOCAL_OP_CONSTANT, // u16 constant index, u8 slot, u8 ADD/SUBTRACT/MULTIPLY/MODULO; GET_LOCAL + CONSTANT + op
+    RETURN,
+};
+
+constexpr int OPCODE_COUNT = static_cast<int>(OpCode::RETURN) + 1;
+
+// Every opcode in OpCode order, for tables indexed by opcode.
+#define AXIOM_OPCODES(X)                                                                                    \
+    X(CONSTANT) X(NONE) X(TRUE) X(FALSE) X(POP) X(DUP) X(DUP2) X(GET_LOCAL) X(SET_LOCAL) X(GET_GLOBAL)      \
+    X(SET_GLOBAL) X(GET_INDEX) X(SET_INDEX) X(EQUAL) X(NOT_EQUAL) X(GREATER) X(GREATER_EQUAL) X(LESS)       \
+    X(LESS_EQUAL) X(ADD) X(SUBTRACT) X(MULTIPLY) X(DIVIDE) X(MODULO) X(NOT) X(NEGATE) X(BUILD_STRING)       \
+    X(PRINT) X(INPUT) X(JUMP) X(JUMP_IF_FALSE) X(LOOP) X(FOR_ITER) X(BUILD_LIST) X(EXTEND_LIST)             \
+    X(BUILD_DICT) X(EXTEND_DICT) X(CALL) X(TAIL_CALL) X(CLASS) X(INHERIT) X(METHOD) X(GET_PROPERTY)         \
+    X(SET_PROPERTY) X(INVOKE) X(GET_SUPER) X(SUPER_INVOKE) X(YIELD) X(INC_LOCAL) X(INC_GLOBAL)              \
+    X(JUMP_UNLESS) X(STORE_LOCAL) X(GET_LOCALS) X(LOCAL_OP_CONSTANT) X(RETURN)
+
+constexpr bool opcodesListedInOrder() {
+#define AXIOM_OPCODE_VALUE(name) OpCode::name,
+    constexpr OpCode listed[] = {AXIOM_OPCODES(AXIOM_OPCODE_VALUE)};
+#undef AXIOM_OPCODE_VALUE
+    if (sizeof(listed) / sizeof(listed[0]) != OPCODE_COUNT) return false;
+    for (int i = 0; i < OPCODE_COUNT; i++) {
+        if (static_cast<int>(listed[i]) != i) return false;
+    }
+    return true;
+}
+static_assert(opcodesListedInOrder(), "AXIOM_OPCODES must list every opcode in OpCode order");
+
+inline const char* opcodeName(OpCode op) {
+#define AXIOM_OPCODE_NAME(name) #name,
+    static const char* const names[] = {AXIOM_OPCODES(AXIOM_OPCODE_NAME)};
+#undef AXIOM_OPCODE_NAME
+    return names[static_cast<int>(op)];
+}
+
+// Bump whenever opcodes or their encoding change; cached bytecode built by
+// another version is ignored.
+constexpr uint32_t BYTECODE_VERSION = 9;
+
+inline int operandBytes(OpCode op) {
+    switch (op) {
+        case OpCode::GET_LOCAL: case OpCode::SET_LOCAL: case OpCode::STORE_LOCAL:
+        case OpCode::PRINT: case OpCode::INPUT: case OpCode::CALL: case OpCode::TAIL_CALL:
+        case OpCode::BUILD_LIST: case OpCode::EXTEND_LIST: case OpCode::BUILD_DICT: case OpCode::EXTEND_DICT:
+        case OpCode::BUILD_STRING:
+            return 1;
+        case OpCode::INC_LOCAL: case OpCode::GET_LOCALS:
+            return 2;
+        case OpCode::CONSTANT: case OpCode::GET_GLOBAL: case OpCode::SET_GLOBAL:
+        case OpCode::JUMP: case OpCode::JUMP_IF_FALSE: case OpCode::LOOP:
+        case OpCode::CLASS: case OpCode::METHOD: case OpCode::GET_SUPER:
+            return 2;
+        case OpCode::FOR_ITER: case OpCode::INC_GLOBAL: case OpCode::JUMP_UNLESS: case OpCode::SUPER_INVOKE:
+            return 3;
+        case OpCode::GET_PROPERTY: case OpCode::SET_PROPERTY: case OpCode::LOCAL_OP_CONSTANT:
+            return 4;
+        case OpCode::INVOKE:
+            return 5;
+        default:
+            return 0;
+    }
+}
+
+// Instructions whose first operand is a u16 constant index.
+inline bool hasConstantOperand(OpCode op) {
+    switch (op) {
+        case OpCode::CONSTANT: case OpCode::CLASS: case OpCode::METHOD:
+        case OpCode::GET_PROPERTY: case OpCode::SET_PROPERTY: case OpCode::INVOKE:
+        case OpCode::GET_SUPER: case OpCode::SUPER_INVOKE: case OpCode::LOCAL_OP_CONSTANT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Instructions with a u16 inline cache index right after the name constant.
+inline bool hasCacheOperand(OpCode op) {
+    return op == OpCode::GET_PROPERTY || op == OpCode::SET_PROPERTY || op == OpCode::INVOKE;
+}
+
+// Bytecode for one function. Line numbers are run-length encoded: a run
+// starts at `offset` and lasts until the next run.
+class Chunk {
+public:
+    struct LineRun {
+        uint32_t offset;
+        int line;
+    };
+
+    std::vector<uint8_t> code;
+    std::vector<LineRun> lines;
+    std::vector<Value> constants;
+
+    void write(uint8_t byte, int line) {
+        if (lines.empty() || lines.back().line != line) lines.push_back({static_cast<uint32_t>(code.size()), line});
+        code.push_back(byte);
+    }
+
+    int lineAt(size_t offset) const {
+        size_t lo = 0, hi = lines.size();
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (lines[mid].offset <= offset) lo = mid;
+            else hi = mid;
+        }
+        return lines.empty() ? 0 : lines[lo].line;
+    }
+
+    int addConstant(Value value) {
+        constants.push_back(value);
+        return static_cast<int>(constants.size() - 1);
+    }
+};
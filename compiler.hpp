@@ -0,0 +1,908 @@
+#pragma once
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "scanner.hpp"
+#include "object.hpp"
+#include "globals.hpp"
+#include "optimizer.hpp"
+
+// Single-pass compiler: pulls tokens from a streaming Scanner and emits
+// bytecode straight away, with a Pratt parser for expressions.
+//
+// Names assigned inside a def are locals of that def, held in fixed frame
+// slots; everything at the top level is a global. Compound assignments and
+// ++/-- on a name that is not a local yet update the global of that name.
+//
+// Methods are defs in a class body. `this` is slot 0 of a method's frame;
+// a def nested inside a method is an ordinary function and cannot see it.
+//
+// With an optimizer, each function's bytecode goes through it once the
+// function is complete. Scan and compile errors go to the ErrorSink, if any.
+class Compiler {
+public:
+    Compiler(Heap& heap, Interner& symbols, Globals& globals, Optimizer* optimizer = nullptr,
+             ErrorSink* errors = nullptr)
+        : heap(heap), symbols(symbols), globals(globals), optimizer(optimizer), errors(errors) {}
+
+    // The script as a function of no arguments, or nullptr on any error.
+    ObjFunction* compile(std::string_view source) {
+        Heap::Tenured tenured(heap); // constants live as long as the code
+        Scanner script(source, 1, &symbols, errors);
+        scanner = &script;
+        FunctionState state {nullptr, heap.makeFunction(), FunctionType::SCRIPT};
+        function = &state;
+
+        advance();
+        while (!match(TokenType::EOF_)) statement();
+        emitReturn();
+
+        function = nullptr;
+        scanner = nullptr;
+        if (hadError || script.hadError()) return nullptr;
+        return endFunction(state);
+    }
+
+private:
+    enum class Precedence { NONE, ASSIGNMENT, OR, AND, EQUALITY, COMPARISON, TERM, FACTOR, UNARY, CALL, PRIMARY };
+    enum class FunctionType { SCRIPT, FUNCTION, METHOD, INITIALIZER };
+
+    using ParseFn = void (Compiler::*)(bool canAssign);
+    struct ParseRule {
+        ParseFn prefix;
+        ParseFn infix;
+        Precedence precedence;
+    };
+
+    struct FunctionState {
+        FunctionState(FunctionState* enclosing, ObjFunction* function, FunctionType type)
+            : enclosing(enclosing), function(function), type(type) {}
+
+        FunctionState* enclosing;
+        ObjFunction* function;
+        FunctionType type;
+        // Name of each frame slot by index; slot 0 (the callee) and hidden
+        // loop slots have none.
+        std::vector<SymbolId> slots {Interner::NONE};
+        std::vector<int> freeLoopSlots; // pairs left behind by finished for loops
+        size_t callEnd = 0;             // where the latest CALL ends, for spotting tail calls
+        std::unordered_map<uint64_t, int> numberConstants; // by Value bits, so 1 and 1.0 stay apart
+        std::unordered_map<std::string, int> stringConstants;
+    };
+
+    struct ClassState {
+        ClassState* enclosing;
+        bool hasSuperclass;
+    };
+
+    static constexpr int MAX_SLOTS = 256;
+    static constexpr int MAX_ARGS = 255;
+    static constexpr int LIST_BATCH = 64;
+    static constexpr int DICT_BATCH = LIST_BATCH / 2; // pairs
+    static constexpr int MAX_PIECES = 255; // per BUILD_STRING
+
+    Heap& heap;
+    Interner& symbols;
+    Globals& globals;
+    Optimizer* optimizer;
+    ErrorSink* errors; // may be null
+    Scanner* scanner = nullptr;
+    FunctionState* function = nullptr;
+    ClassState* currentClass = nullptr;
+    Token current {TokenType::EOF_, 0, 0, Token::NO_LITERAL, 0};
+    Token previous {TokenType::EOF_, 0, 0, Token::NO_LITERAL, 0};
+    bool hadError = false;
+    bool panicMode = false;
+
+    Chunk& chunk() { return function->function->chunk; }
+
+    // ---- tokens ------------------------------------------------------------
+
+    void advance() {
+        previous = current;
+        current = scanner->nextToken();
+    }
+
+    bool check(TokenType type) const { return current.type == type; }
+
+    bool match(TokenType type) {
+        if (!check(type)) return false;
+        advance();
+        return true;
+    }
+
+    void consume(TokenType type, const char* message) {
+        if (check(type)) advance();
+        else errorAt(current, message);
+    }
+
+    std::string_view lexeme(const Token& token) const { return scanner->lexeme(token); }
+
+    void errorAt(const Token& token, const std::string& message) {
+        if (panicMode) return;
+        panicMode = true;
+        hadError = true;
+        std::string where;
+        switch (token.type) {
+            case TokenType::EOF_: where = " at end"; break;
+            case TokenType::NEWLINE: where = " at end of line"; break;
+            case TokenType::INDENT: case TokenType::DEDENT: where = " at indentation"; break;
+            default: where = " at '" + std::string(lexeme(token)) + "'"; break;
+        }
+        if (errors) errors->compileError(token.line, where, message);
+    }
+
+    void error(const std::string& message) { errorAt(previous, message); }
+
+    // Skip to the next statement boundary after an error.
+    void synchronize() {
+        panicMode = false;
+        while (!check(TokenType::EOF_)) {
+            if (previous.type == TokenType::NEWLINE || previous.type == TokenType::SEMICOLON) return;
+            switch (current.type) {
+                case TokenType::CLASS: case TokenType::DEF: case TokenType::FOR: case TokenType::IF: case TokenType::WHILE:
+                case TokenType::PRINT: case TokenType::RETURN: case TokenType::YIELD: case TokenType::DEDENT:
+                    return;
+                default:
+                    advance();
+            }
+        }
+    }
+
+    // ---- emitting ----------------------------------------------------------
+
+    void emitByte(uint8_t byte) { chunk().write(byte, previous.line); }
+    void emitOp(OpCode op) { emitByte(static_cast<uint8_t>(op)); }
+    void emitOp(OpCode op, uint8_t operand) { emitOp(op); emitByte(operand); }
+    void emitShort(uint16_t value) {
+        emitByte(static_cast<uint8_t>(value >> 8));
+        emitByte(static_cast<uint8_t>(value & 0xff));
+    }
+    void emitReturn() {
+        if (function->type == FunctionType::INITIALIZER) emitOp(OpCode::GET_LOCAL, 0); // init returns this
+        else emitOp(OpCode::NONE);
+        emitOp(OpCode::RETURN);
+    }
+
+    int makeConstant(Value value) {
+        int index = chunk().addConstant(value);
+        if (index > UINT16_MAX) {
+            error("Too many constants in one function.");
+            return 0;
+        }
+        return index;
+    }
+
+    void emitConstant(int index) {
+        emitOp(OpCode::CONSTANT);
+        emitShort(static_cast<uint16_t>(index));
+    }
+
+    void emitNumber(Value value) {
+        auto [it, added] = function->numberConstants.try_emplace(value.raw(), 0);
+        if (added) it->second = makeConstant(value);
+        emitConstant(it->second);
+    }
+
+    int stringConstant(std::string_view text) {
+        auto [it, added] = function->stringConstants.try_emplace(std::string(text), 0);
+        if (added) it->second = makeConstant(Value::object(heap.makeString(text)));
+        return it->second;
+    }
+
+    void emitString(std::string_view text) { emitConstant(stringConstant(text)); }
+
+    // A property instruction: the name, then a fresh inline cache.
+    void emitProperty(OpCode op, std::string_view name) {
+        emitOp(op);
+        emitShort(static_cast<uint16_t>(stringConstant(name)));
+        std::vector<InlineCache>& caches = function->function->caches;
+        if (caches.size() > UINT16_MAX) error("Too many property accesses in one function.");
+        emitShort(static_cast<uint16_t>(caches.size()));
+        caches.emplace_back();
+    }
+
+    int emitJump(OpCode op) {
+        emitOp(op);
+        emitShort(0xffff);
+        return static_cast<int>(chunk().code.size()) - 2;
+    }
+
+    void patchJump(int offset) {
+        int jump = static_cast<int>(chunk().code.size()) - offset - 2;
+        if (jump > UINT16_MAX) error("Too much code to jump over.");
+        chunk().code[offset] = static_cast<uint8_t>((jump >> 8) & 0xff);
+        chunk().code[offset + 1] = static_cast<uint8_t>(jump & 0xff);
+    }
+
+    void emitLoop(int loopStart) {
+        emitOp(OpCode::LOOP);
+        int offset = static_cast<int>(chunk().code.size()) - loopStart + 2;
+        if (offset > UINT16_MAX) error("Loop body too large.");
+        emitShort(static_cast<uint16_t>(offset));
+    }
+
+    ObjFunction* endFunction(FunctionState& state) {
+        state.function->slotCount = static_cast<int>(state.slots.size());
+        if (optimizer && !hadError) optimizer->optimize(state.function);
+        return state.function;
+    }
+
+    // ---- statements --------------------------------------------------------
+
+    void statement() {
+        if (match(TokenType::PRINT)) printStatement();
+        else if (match(TokenType::IF)) ifStatement();
+        else if (match(TokenType::WHILE)) whileStatement();
+        else if (match(TokenType::FOR)) forStatement();
+        else if (match(TokenType::DEF)) defStatement();
+        else if (match(TokenType::CLASS)) classStatement();
+        else if (match(TokenType::RETURN)) returnStatement();
+        else if (match(TokenType::YIELD)) yieldStatement();
+        else if (match(TokenType::INDENT)) {
+            error("Unexpected indent.");
+        } else {
+            expression();
+            emitOp(OpCode::POP);
+            endStatement();
+        }
+        if (panicMode) synchronize();
+    }
+
+    // A simple statement ends at a newline or ';', or where its block or the
+    // file ends.
+    void endStatement() {
+        if (match(TokenType::SEMICOLON)) {
+            match(TokenType::NEWLINE);
+            return;
+        }
+        if (match(TokenType::NEWLINE) || check(TokenType::DEDENT) || check(TokenType::EOF_)) return;
+        errorAt(current, "Expect newline after statement.");
+    }
+
+    // The body after a ':' is either an indented block or one statement on
+    // the same line.
+    void block() {
+        consume(TokenType::COLON, "Expect ':' before block.");
+        if (!match(TokenType::NEWLINE)) {
+            statement();
+            return;
+        }
+        consume(TokenType::INDENT, "Expect an indented block.");
+        while (!check(TokenType::DEDENT) && !check(TokenType::EOF_)) statement();
+        match(TokenType::DEDENT);
+    }
+
+    void printStatement() {
+        int count = 0;
+        if (!check(TokenType::NEWLINE) && !check(TokenType::SEMICOLON) && !check(TokenType::EOF_) &&
+            !check(TokenType::DEDENT)) {
+            do {
+                expression();
+                if (++count > MAX_ARGS) error("Can't print more than 255 values.");
+            } while (match(TokenType::COMMA));
+        }
+        emitOp(OpCode::PRINT, static_cast<uint8_t>(count));
+        endStatement();
+    }
+
+    void ifStatement() {
+        expression();
+        int thenJump = emitJump(OpCode::JUMP_IF_FALSE);
+        emitOp(OpCode::POP);
+        block();
+        int elseJump = emitJump(OpCode::JUMP);
+        patchJump(thenJump);
+        emitOp(OpCode::POP);
+        if (match(TokenType::ELSE)) {
+            if (match(TokenType::IF)) ifStatement();
+            else block();
+        }
+        patchJump(elseJump);
+    }
+
+    void whileStatement() {
+        int loopStart = static_cast<int>(chunk().code.size());
+        expression();
+        int exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+        emitOp(OpCode::POP);
+        block();
+        emitLoop(loopStart);
+        patchJump(exitJump);
+        emitOp(OpCode::POP);
+    }
+
+    // for name in iterable: the iterable and the position live in two hidden
+    // slots that FOR_ITER reads and advances.
+    void forStatement() {
+        consume(TokenType::IDENTIFIER, "Expect loop variable name.");
+        SymbolId name = symbol(previous);
+        consume(TokenType::IN, "Expect 'in' after loop variable.");
+        expression();
+
+        int iterator;
+        if (!function->freeLoopSlots.empty()) {
+            iterator = function->freeLoopSlots.back();
+            function->freeLoopSlots.pop_back();
+        } else {
+            iterator = addSlot(Interner::NONE);
+            addSlot(Interner::NONE);
+        }
+        emitOp(OpCode::SET_LOCAL, static_cast<uint8_t>(iterator));
+        emitOp(OpCode::POP);
+        emitNumber(Value::integer(0));
+        emitOp(OpCode::SET_LOCAL, static_cast<uint8_t>(iterator + 1));
+        emitOp(OpCode::POP);
+
+        int loopStart = static_cast<int>(chunk().code.size());
+        emitOp(OpCode::FOR_ITER, static_cast<uint8_t>(iterator));
+        emitShort(0xffff);
+        int exitJump = static_cast<int>(chunk().code.size()) - 2;
+        storeVariable(name);
+        emitOp(OpCode::POP);
+        block();
+        emitLoop(loopStart);
+        patchJump(exitJump);
+
+        // Drop the reference so the iterable can be collected
+        emitOp(OpCode::NONE);
+        emitOp(OpCode::SET_LOCAL, static_cast<uint8_t>(iterator));
+        emitOp(OpCode::POP);
+        function->freeLoopSlots.push_back(iterator);
+    }
+
+    void defStatement() {
+        consume(TokenType::IDENTIFIER, "Expect function name.");
+        SymbolId name = symbol(previous);
+        functionBody(name, FunctionType::FUNCTION);
+        storeVariable(name);
+        emitOp(OpCode::POP);
+    }
+
+    // class Name: or class Name(Superclass): followed by a block of defs.
+    void classStatement() {
+        consume(TokenType::IDENTIFIER, "Expect class name.");
+        SymbolId name = symbol(previous);
+        emitOp(OpCode::CLASS);
+        emitShort(static_cast<uint16_t>(stringConstant(lexeme(previous))));
+
+        ClassState state {currentClass, false};
+        currentClass = &state;
+        if (match(TokenType::LEFT_PAREN)) {
+            if (check(TokenType::IDENTIFIER) && symbol(current) == name) errorAt(current, "A class can't inherit from itself.");
+            expression();
+            consume(TokenType::RIGHT_PAREN, "Expect ')' after superclass.");
+            emitOp(OpCode::INHERIT);
+            state.hasSuperclass = true;
+        }
+        consume(TokenType::COLON, "Expect ':' before class body.");
+        if (match(TokenType::NEWLINE)) {
+            consume(TokenType::INDENT, "Expect an indented class body.");
+            while (!check(TokenType::DEDENT) && !check(TokenType::EOF_)) method();
+            match(TokenType::DEDENT);
+        } else {
+            method();
+        }
+        currentClass = state.enclosing;
+        storeVariable(name);
+        emitOp(OpCode::POP);
+    }
+
+    void method() {
+        if (!match(TokenType::DEF)) {
+            errorAt(current, "Expect a method definition in class body.");
+            advance();
+            synchronize();
+            return;
+        }
+        consume(TokenType::IDENTIFIER, "Expect method name.");
+        std::string_view name = lexeme(previous);
+        int constant = stringConstant(name);
+        functionBody(symbol(previous), name == "init" ? FunctionType::INITIALIZER : FunctionType::METHOD);
+        emitOp(OpCode::METHOD);
+        emitShort(static_cast<uint16_t>(constant));
+        if (panicMode) synchronize();
+    }
+
+    void functionBody(SymbolId name, FunctionType type) {
+        FunctionState state {function, heap.makeFunction(), type};
+        state.function->name = heap.makeString(name == Interner::NONE ? "?" : symbols.name(name));
+        function = &state;
+
+        consume(TokenType::LEFT_PAREN, "Expect '(' after function name.");
+        if (!check(TokenType::RIGHT_PAREN)) {
+            do {
+                if (++state.function->arity > MAX_ARGS) errorAt(current, "Can't have more than 255 parameters.");
+                consume(TokenType::IDENTIFIER, "Expect parameter name.");
+                SymbolId param = symbol(previous);
+                if (param != Interner::NONE && findSlot(state, param) >= 0) error("Duplicate parameter name.");
+                addSlot(param);
+            } while (match(TokenType::COMMA));
+        }
+        consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
+        block();
+        emitReturn();
+
+        function = state.enclosing;
+        emitConstant(makeConstant(Value::object(endFunction(state))));
+    }
+
+    void returnStatement() {
+        if (function->type == FunctionType::SCRIPT) error("Can't return from top-level code.");
+        if (check(TokenType::NEWLINE) || check(TokenType::SEMICOLON) || check(TokenType::DEDENT) ||
+            check(TokenType::EOF_)) {
+            emitReturn();
+        } else {
+            if (function->type == FunctionType::INITIALIZER) error("Can't return a value from an initializer.");
+            expression();
+            // `return f(x)`: the callee can take over this frame. RETURN
+            // stays for the calls TAIL_CALL makes as an ordinary CALL.
+            std::vector<uint8_t>& code = chunk().code;
+            if (function->callEnd == code.size()) code[code.size() - 2] = static_cast<uint8_t>(OpCode::TAIL_CALL);
+            emitOp(OpCode::RETURN);
+        }
+        endStatement();
+    }
+
+    // Any yield makes the whole function a generator: calling it runs
+    // nothing and returns a generator for a for loop to drive.
+    void yieldStatement() {
+        if (function->type == FunctionType::SCRIPT) error("Can't yield from top-level code.");
+        else if (function->type == FunctionType::INITIALIZER) error("Can't yield from an initializer.");
+        function->function->generator = true;
+        expression();
+        emitOp(OpCode::YIELD);
+        endStatement();
+    }
+
+    // ---- variables ---------------------------------------------------------
+
+    // The symbol of an identifier token; NONE after a syntax error put
+    // something else there.
+    static SymbolId symbol(const Token& token) {
+        return token.type == TokenType::IDENTIFIER ? token.literal : Interner::NONE;
+    }
+
+    static int findSlot(const FunctionState& state, SymbolId name) {
+        for (int i = static_cast<int>(state.slots.size()) - 1; i > 0; i--) {
+            if (state.slots[i] == name) return i;
+        }
+        return -1;
+    }
+
+    int addSlot(SymbolId name) {
+        if (function->slots.size() == MAX_SLOTS) {
+            error("Too many local variables in function.");
+            return 0;
+        }
+        function->slots.push_back(name);
+        return static_cast<int>(function->slots.size() - 1);
+    }
+
+    int globalSlot(SymbolId name) {
+        if (name == Interner::NONE) return 0; // already reported
+        int slot = globals.slot(name);
+        if (slot < 0) {
+            error("Too many global variables.");
+            return 0;
+        }
+        return slot;
+    }
+
+    // Where a read of `name` goes: {local slot, -1} or {-1, global slot}.
+    std::pair<int, int> resolve(SymbolId name) {
+        if (name == Interner::NONE) return {-1, 0}; // already reported
+        int local = findSlot(*function, name);
+        if (local >= 0) return {local, -1};
+        for (FunctionState* outer = function->enclosing; outer; outer = outer->enclosing) {
+            if (findSlot(*outer, name) >= 0) {
+                error("Can't use a local of an enclosing function.");
+                break;
+            }
+        }
+        return {-1, globalSlot(name)};
+    }
+
+    void emitGet(std::pair<int, int> target) {
+        if (target.first >= 0) {
+            emitOp(OpCode::GET_LOCAL, static_cast<uint8_t>(target.first));
+        } else {
+            emitOp(OpCode::GET_GLOBAL);
+            emitShort(static_cast<uint16_t>(target.second));
+        }
+    }
+
+    void emitSet(std::pair<int, int> target) {
+        if (target.first >= 0) {
+            emitOp(OpCode::SET_LOCAL, static_cast<uint8_t>(target.first));
+        } else {
+            emitOp(OpCode::SET_GLOBAL);
+            emitShort(static_cast<uint16_t>(target.second));
+        }
+    }
+
+    // Plain assignment: a new local inside a def, a global at the top level.
+    void storeVariable(SymbolId name) {
+        if (function->type == FunctionType::SCRIPT || name == Interner::NONE) {
+            emitSet({-1, globalSlot(name)});
+            return;
+        }
+        int slot = findSlot(*function, name);
+        if (slot < 0) slot = addSlot(name);
+        emitSet({slot, -1});
+    }
+
+    static bool compoundOp(TokenType type, OpCode* op) {
+        switch (type) {
+            case TokenType::PLUS_EQUAL: *op = OpCode::ADD; return true;
+            case TokenType::MINUS_EQUAL: *op = OpCode::SUBTRACT; return true;
+            case TokenType::STAR_EQUAL: *op = OpCode::MULTIPLY; return true;
+            case TokenType::SLASH_EQUAL: *op = OpCode::DIVIDE; return true;
+            case TokenType::PERCENT_EQUAL: *op = OpCode::MODULO; return true;
+            default: return false;
+        }
+    }
+
+    void variable(bool canAssign) {
+        SymbolId name = symbol(previous);
+        OpCode op;
+        if (canAssign && match(TokenType::EQUAL)) {
+            expression();
+            storeVariable(name);
+        } else if (canAssign && compoundOp(current.type, &op)) {
+            advance();
+            auto target = resolve(name);
+            emitGet(target);
+            expression();
+            emitOp(op);
+            emitSet(target);
+        } else if (match(TokenType::PLUS_PLUS) || match(TokenType::MINUS_MINUS)) {
+            // Postfix: the expression is the old value
+            bool increment = previous.type == TokenType::PLUS_PLUS;
+            auto target = resolve(name);
+            emitGet(target);
+            emitOp(OpCode::DUP);
+            emitNumber(Value::integer(1));
+            emitOp(increment ? OpCode::ADD : OpCode::SUBTRACT);
+            emitSet(target);
+            emitOp(OpCode::POP);
+        } else {
+            emitGet(resolve(name));
+        }
+    }
+
+    void prefixIncrement(bool) {
+        bool increment = previous.type == TokenType::PLUS_PLUS;
+        consume(TokenType::IDENTIFIER, "Expect variable name after prefix operator.");
+        auto target = resolve(symbol(previous));
+        emitGet(target);
+        emitNumber(Value::integer(1));
+        emitOp(increment ? OpCode::ADD : OpCode::SUBTRACT);
+        emitSet(target);
+    }
+
+    // ---- expressions -------------------------------------------------------
+
+    void expression() { parsePrecedence(Precedence::ASSIGNMENT); }
+
+    void parsePrecedence(Precedence precedence) {
+        advance();
+        ParseFn prefix = getRule(previous.type).prefix;
+        if (!prefix) {
+            error("Expect expression.");
+            return;
+        }
+        bool canAssign = precedence <= Precedence::ASSIGNMENT;
+        (this->*prefix)(canAssign);
+
+        while (precedence <= getRule(current.type).precedence) {
+            advance();
+            (this->*getRule(previous.type).infix)(canAssign);
+        }
+        if (canAssign && (check(TokenType::EQUAL) || isCompound(current.type))) {
+            errorAt(current, "Invalid assignment target.");
+        }
+    }
+
+    static bool isCompound(TokenType type) {
+        OpCode op;
+        return compoundOp(type, &op);
+    }
+
+    void grouping(bool) {
+        expression();
+        consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
+    }
+
+    void number(bool) {
+        Value value = scanner->literal(previous);
+        // An int too wide to sit inline is boxed here, once the heap is at hand
+        emitNumber(value.isNone() ? heap.makeInteger(scanner->wideInteger(previous)) : value);
+    }
+
+    void literal(bool) {
+        switch (previous.type) {
+            case TokenType::TRUE: emitOp(OpCode::TRUE); break;
+            case TokenType::FALSE: emitOp(OpCode::FALSE); break;
+            default: emitOp(OpCode::NONE); break;
+        }
+    }
+
+    // Adjacent string literals and f-strings are one string. Literal text
+    // is joined here; each {expression} is pushed as it is, and a single
+    // BUILD_STRING formats and joins all the pieces at once.
+    void string(bool) {
+        std::string text; // literal text not pushed yet
+        int pieces = 0;
+        auto piece = [&] { // room for one more piece on the stack
+            if (pieces == MAX_PIECES) {
+                emitOp(OpCode::BUILD_STRING, static_cast<uint8_t>(pieces));
+                pieces = 1;
+            }
+            pieces++;
+        };
+        auto pushText = [&] {
+            if (text.empty()) return;
+            piece();
+            emitString(text);
+            text.clear();
+        };
+        for (;;) {
+            text += lexeme(previous);
+            if (previous.type == TokenType::FSTRING_START) {
+                for (;;) {
+                    pushText();
+                    piece();
+                    expression();
+                    if (!match(TokenType::FSTRING_PART)) break;
+                    text += lexeme(previous);
+                }
+                consume(TokenType::FSTRING_END, "Expect '}' after f-string expression.");
+                text += lexeme(previous);
+            }
+            if (!check(TokenType::STRING) && !check(TokenType::FSTRING_START)) break;
+            advance();
+        }
+        if (pieces == 0) {
+            emitString(text);
+            return;
+        }
+        pushText();
+        emitOp(OpCode::BUILD_STRING, static_cast<uint8_t>(pieces));
+    }
+
+    void list(bool) {
+        int count = 0;
+        bool first = true;
+        if (!check(TokenType::RIGHT_BRACE)) {
+            do {
+                if (check(TokenType::RIGHT_BRACE)) break; // trailing comma
+                expression();
+                if (++count == LIST_BATCH) {
+                    emitOp(first ? OpCode::BUILD_LIST : OpCode::EXTEND_LIST, static_cast<uint8_t>(count));
+                    first = false;
+                    count = 0;
+                }
+            } while (match(TokenType::COMMA));
+        }
+        consume(TokenType::RIGHT_BRACE, "Expect ']' after list elements.");
+        if (first || count) emitOp(first ? OpCode::BUILD_LIST : OpCode::EXTEND_LIST, static_cast<uint8_t>(count));
+    }
+
+    void dict(bool) {
+        int count = 0;
+        bool first = true;
+        if (!check(TokenType::RIGHT_SQUIGGLE)) {
+            do {
+                if (check(TokenType::RIGHT_SQUIGGLE)) break; // trailing comma
+                expression();
+                consume(TokenType::COLON, "Expect ':' after dict key.");
+                expression();
+                if (++count == DICT_BATCH) {
+                    emitOp(first ? OpCode::BUILD_DICT : OpCode::EXTEND_DICT, static_cast<uint8_t>(count));
+                    first = false;
+                    count = 0;
+                }
+            } while (match(TokenType::COMMA));
+        }
+        consume(TokenType::RIGHT_SQUIGGLE, "Expect '}' after dict entries.");
+        if (first || count) emitOp(first ? OpCode::BUILD_DICT : OpCode::EXTEND_DICT, static_cast<uint8_t>(count));
+    }
+
+    void input(bool) {
+        consume(TokenType::LEFT_PAREN, "Expect '(' after 'input'.");
+        bool hasPrompt = !check(TokenType::RIGHT_PAREN);
+        if (hasPrompt) expression();
+        consume(TokenType::RIGHT_PAREN, "Expect ')' after input prompt.");
+        emitOp(OpCode::INPUT, hasPrompt);
+    }
+
+    void unary(bool) {
+        TokenType op = previous.type;
+        parsePrecedence(Precedence::UNARY);
+        emitOp(op == TokenType::MINUS ? OpCode::NEGATE : OpCode::NOT);
+    }
+
+    void binary(bool) {
+        TokenType op = previous.type;
+        const ParseRule& rule = getRule(op);
+        parsePrecedence(static_cast<Precedence>(static_cast<int>(rule.precedence) + 1));
+        switch (op) {
+            case TokenType::EQUAL_EQUAL: emitOp(OpCode::EQUAL); break;
+            case TokenType::NOT_EQUAL: emitOp(OpCode::NOT_EQUAL); break;
+            case TokenType::GREATER: emitOp(OpCode::GREATER); break;
+            case TokenType::GREATER_EQUAL: emitOp(OpCode::GREATER_EQUAL); break;
+            case TokenType::LESS: emitOp(OpCode::LESS); break;
+            case TokenType::LESS_EQUAL: emitOp(OpCode::LESS_EQUAL); break;
+            case TokenType::PLUS: emitOp(OpCode::ADD); break;
+            case TokenType::MINUS: emitOp(OpCode::SUBTRACT); break;
+            case TokenType::STAR: emitOp(OpCode::MULTIPLY); break;
+            case TokenType::SLASH: emitOp(OpCode::DIVIDE); break;
+            case TokenType::PERCENT: emitOp(OpCode::MODULO); break;
+            default: return;
+        }
+    }
+
+    // and/or leave the deciding operand on the stack, like Python.
+    void and_(bool) {
+        int endJump = emitJump(OpCode::JUMP_IF_FALSE);
+        emitOp(OpCode::POP);
+        parsePrecedence(Precedence::AND);
+        patchJump(endJump);
+    }
+
+    void or_(bool) {
+        int elseJump = emitJump(OpCode::JUMP_IF_FALSE);
+        int endJump = emitJump(OpCode::JUMP);
+        patchJump(elseJump);
+        emitOp(OpCode::POP);
+        parsePrecedence(Precedence::OR);
+        patchJump(endJump);
+    }
+
+    uint8_t argumentList() {
+        int argCount = 0;
+        if (!check(TokenType::RIGHT_PAREN)) {
+            do {
+                expression();
+                if (++argCount > MAX_ARGS) error("Can't have more than 255 arguments.");
+            } while (match(TokenType::COMMA));
+        }
+        consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
+        return static_cast<uint8_t>(argCount);
+    }
+
+    void call(bool) {
+        int argCount = argumentList();
+        emitOp(OpCode::CALL, argCount);
+        function->callEnd = chunk().code.size();
+    }
+
+    // obj.name, obj.name = value, obj.name op= value and obj.name(args); a
+    // call goes straight to the method without a bound method in between.
+    void dot(bool canAssign) {
+        consume(TokenType::IDENTIFIER, "Expect property name after '.'.");
+        std::string_view name = lexeme(previous);
+        OpCode op;
+        if (canAssign && match(TokenType::EQUAL)) {
+            expression();
+            emitProperty(OpCode::SET_PROPERTY, name);
+        } else if (canAssign && compoundOp(current.type, &op)) {
+            advance();
+            emitOp(OpCode::DUP);
+            emitProperty(OpCode::GET_PROPERTY, name);
+            expression();
+            emitOp(op);
+            emitProperty(OpCode::SET_PROPERTY, name);
+        } else if (match(TokenType::LEFT_PAREN)) {
+            uint8_t argCount = argumentList();
+            emitProperty(OpCode::INVOKE, name);
+            emitByte(argCount);
+        } else {
+            emitProperty(OpCode::GET_PROPERTY, name);
+        }
+    }
+
+    bool inMethod() const {
+        return function->type == FunctionType::METHOD || function->type == FunctionType::INITIALIZER;
+    }
+
+    void this_(bool) {
+        if (!inMethod()) {
+            error("Can't use 'this' outside of a method.");
+            return;
+        }
+        emitOp(OpCode::GET_LOCAL, 0);
+    }
+
+    // super.name looks the method up starting above the class that defined
+    // the running method.
+    void super_(bool) {
+        if (!inMethod()) error("Can't use 'super' outside of a method.");
+        else if (!currentClass->hasSuperclass) error("Can't use 'super' in a class with no superclass.");
+        consume(TokenType::DOT, "Expect '.' after 'super'.");
+        consume(TokenType::IDENTIFIER, "Expect superclass method name.");
+        int name = stringConstant(lexeme(previous));
+        emitOp(OpCode::GET_LOCAL, 0);
+        if (match(TokenType::LEFT_PAREN)) {
+            uint8_t argCount = argumentList();
+            emitOp(OpCode::SUPER_INVOKE);
+            emitShort(static_cast<uint16_t>(name));
+            emitByte(argCount);
+        } else {
+            emitOp(OpCode::GET_SUPER);
+            emitShort(static_cast<uint16_t>(name));
+        }
+    }
+
+    void subscript(bool canAssign) {
+        expression();
+        consume(TokenType::RIGHT_BRACE, "Expect ']' after index.");
+        OpCode op;
+        if (canAssign && match(TokenType::EQUAL)) {
+            expression();
+            emitOp(OpCode::SET_INDEX);
+        } else if (canAssign && compoundOp(current.type, &op)) {
+            advance();
+            emitOp(OpCode::DUP2);
+            emitOp(OpCode::GET_INDEX);
+            expression();
+            emitOp(op);
+            emitOp(OpCode::SET_INDEX);
+        } else {
+            emitOp(OpCode::GET_INDEX);
+        }
+    }
+
+    static const ParseRule& getRule(TokenType type) {
+        static const ParseRule none {nullptr, nullptr, Precedence::NONE};
+        static const ParseRule rules[] = {
+            {&Compiler::grouping, &Compiler::call, Precedence::CALL},        // LEFT_PAREN
+            {&Compiler::list, &Compiler::subscript, Precedence::CALL},       // LEFT_BRACE
+            {&Compiler::unary, &Compiler::binary, Precedence::TERM},         // MINUS
+            {nullptr, &Compiler::binary, Precedence::TERM},                  // PLUS
+            {nullptr, &Compiler::binary, Precedence::FACTOR},                // SLASH, STAR, PERCENT
+            {&Compiler::unary, nullptr, Precedence::NONE},                   // NOT
+            {nullptr, &Compiler::binary, Precedence::EQUALITY},              // NOT_EQUAL, EQUAL_EQUAL
+            {nullptr, &Compiler::binary, Precedence::COMPARISON},            // < <= > >=
+            {&Compiler::variable, nullptr, Precedence::NONE},                // IDENTIFIER
+            {&Compiler::string, nullptr, Precedence::NONE},                  // STRING, FSTRING_START
+            {&Compiler::number, nullptr, Precedence::NONE},                  // NUMBER
+            {nullptr, &Compiler::and_, Precedence::AND},                     // AND
+            {nullptr, &Compiler::or_, Precedence::OR},                       // OR
+            {&Compiler::literal, nullptr, Precedence::NONE},                 // TRUE, FALSE, NONE
+            {&Compiler::input, nullptr, Precedence::NONE},                   // INPUT
+            {&Compiler::prefixIncrement, nullptr, Precedence::NONE},         // PLUS_PLUS, MINUS_MINUS
+            {nullptr, &Compiler::dot, Precedence::CALL},                     // DOT
+            {&Compiler::this_, nullptr, Precedence::NONE},                   // THIS
+            {&Compiler::super_, nullptr, Precedence::NONE},                  // SUPER
+            {&Compiler::dict, nullptr, Precedence::NONE},                    // LEFT_SQUIGGLE
+        };
+        switch (type) {
+            case TokenType::LEFT_PAREN: return rules[0];
+            case TokenType::LEFT_BRACE: return rules[1];
+            case TokenType::MINUS: return rules[2];
+            case TokenType::PLUS: return rules[3];
+            case TokenType::SLASH: case TokenType::STAR: case TokenType::PERCENT: return rules[4];
+            case TokenType::NOT: return rules[5];
+            case TokenType::NOT_EQUAL: case TokenType::EQUAL_EQUAL: return rules[6];
+            case TokenType::GREATER: case TokenType::GREATER_EQUAL:
+            case TokenType::LESS: case TokenType::LESS_EQUAL: return rules[7];
+            case TokenType::IDENTIFIER: return rules[8];
+            case TokenType::STRING: case TokenType::FSTRING_START: return rules[9];
+            case TokenType::NUMBER: return rules[10];
+            case TokenType::AND: return rules[11];
+            case TokenType::OR: return rules[12];
+            case TokenType::TRUE: case TokenType::FALSE: case TokenType::NONE: return rules[13];
+            case TokenType::INPUT: return rules[14];
+            case TokenType::PLUS_PLUS: case TokenType::MINUS_MINUS: return rules[15];
+            case TokenType::DOT: return rules[16];
+            case TokenType::THIS: return rules[17];
+            case TokenType::SUPER: return rules[18];
+            case TokenType::LEFT_SQUIGGLE: return rules[19];
+            default: return none;
+        }
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "value.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define AXIOM_DICT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// A dict's storage, Swiss-table style. Entries sit in a dense array in
+// insertion order, which is also iteration order, each keeping its key's
+// hash. The index is an open-addressed table of entry numbers with one
+// control byte per slot: EMPTY, or the low 7 bits of the hash of the key
+// stored there. A lookup matches a whole 16-byte group of control bytes
+// against those 7 bits at once and only compares the keys of the hits.
+//
+// The caller hashes and compares keys, so the table knows nothing about
+// objects. Entries are never removed.
+class DictTable {
+public:
+    struct Entry {
+        Value key;
+        Value value;
+        uint64_t hash;
+    };
+
+    DictTable() = default;
+    DictTable(DictTable&&) = default;
+    DictTable& operator=(DictTable&&) = default;
+
+    size_t size() const { return entries.size(); }
+    Entry* begin() { return entries.data(); }
+    Entry* end() { return entries.data() + entries.size(); }
+    const Entry* begin() const { return entries.data(); }
+    const Entry* end() const { return entries.data() + entries.size(); }
+    const Entry& operator[](size_t i) const { return entries[i]; }
+
+    // The entry whose key `equal(key)` accepts, or nullptr.
+    template <class Equal>
+    Entry* find(uint64_t hash, const Equal& equal) {
+        if (capacity == 0) return nullptr;
+        uint8_t tag = tagOf(hash);
+        size_t mask = capacity - 1;
+        for (size_t position = hash >> 7, step = 0;; step += GROUP, position += step) {
+            position &= mask;
+            const uint8_t* group = control.get() + position;
+            for (uint32_t hits = match(group, tag); hits; hits &= hits - 1) {
+                Entry& entry = entries[slots[(position + lowestBit(hits)) & mask]];
+                if (entry.hash == hash && equal(entry.key)) return &entry;
+            }
+            if (emptyIn(group)) return nullptr;
+        }
+    }
+
+    // Adds a key that find() did not.
+    void insert(uint64_t hash, Value key, Value value) {
+        if ((entries.size() + 1) * 8 > capacity * 7) rehash(capacity ? capacity * 2 : GROUP);
+        entries.push_back({key, value, hash});
+        place(hash, static_cast<uint32_t>(entries.size() - 1));
+    }
+
+private:
+    static constexpr size_t GROUP = 16;
+    static constexpr uint8_t EMPTY = 0x80;
+
+    std::vector<Entry> entries;
+    // capacity + GROUP bytes; the last GROUP mirror the first, so a group
+    // can be loaded at any position without wrapping
+    std::unique_ptr<uint8_t[]> control;
+    std::unique_ptr<uint32_t[]> slots; // entry numbers
+    size_t capacity = 0;               // a power of two, at least GROUP
+
+    static uint8_t tagOf(uint64_t hash) { return static_cast<uint8_t>(hash & 0x7f); }
+
+    static int lowestBit(uint32_t bits) {
+#if defined(__GNUC__)
+        return __builtin_ctz(bits);
+#else
+        int i = 0;
+        while (!(bits & 1)) bits >>= 1, i++;
+        return i;
+#endif
+    }
+
+    // Bit i set where group[i] == tag.
+    static uint32_t match(const uint8_t* group, uint8_t tag) {
+#ifdef AXIOM_DICT_SSE2
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(tag)))));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < GROUP; i++) bits |= static_cast<uint32_t>(group[i] == tag) << i;
+        return bits;
+#endif
+    }
+
+    // Bit i set where group[i] is EMPTY, the only control byte with its top bit set.
+    static uint32_t emptyIn(const uint8_t* group) {
+#ifdef AXIOM_DICT_SSE2
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group))));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < GROUP; i++) bits |= static_cast<uint32_t>(group[i] >> 7) << i;
+        return bits;
+#endif
+    }
+
+    void place(uint64_t hash, uint32_t entry) {
+        size_t mask = capacity - 1;
+        for (size_t position = hash >> 7, step = 0;; step += GROUP, position += step) {
+            position &= mask;
+            if (uint32_t empty = emptyIn(control.get() + position)) {
+                size_t slot = (position + lowestBit(empty)) & mask;
+                control[slot] = tagOf(hash);
+                if (slot < GROUP) control[capacity + slot] = tagOf(hash);
+                slots[slot] = entry;
+                return;
+            }
+        }
+    }
+
+    void rehash(size_t bigger) {
+        capacity = bigger;
+        control.reset(new uint8_t[capacity + GROUP]);
+        std::memset(control.get(), EMPTY, capacity + GROUP);
+        slots.reset(new uint32_t[capacity]);
+        for (size_t i = 0; i < entries.size(); i++) place(entries[i].hash, static_cast<uint32_t>(i));
+    }
+};
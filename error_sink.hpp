@@ -0,0 +1,35 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Where the scanner, compiler and VM report errors. Each interpreter has its
+// own, so interpreters on different threads never share one.
+class ErrorSink {
+public:
+    virtual ~ErrorSink() = default;
+
+    // `source[start, current)` is the text being scanned when it failed.
+    virtual void scanError(int line, const std::string& message, std::string_view source, int start, int current) = 0;
+    // `where` locates the offending token: " at 'x'", " at end", ...
+    virtual void compileError(int line, const std::string& where, const std::string& message) = 0;
+    // The message, then the call stack innermost first, one line each.
+    virtual void runtimeError(const std::string& report) = 0;
+};
+
+// Writes errors to a stream in the format the command line prints.
+class StreamErrorSink : public ErrorSink {
+public:
+    explicit StreamErrorSink(std::ostream& out) : out(out) {}
+
+    void scanError(int line, const std::string& message, std::string_view, int, int) override {
+        out << "[line " << line << "] Error: " << message << "\n";
+    }
+    void compileError(int line, const std::string& where, const std::string& message) override {
+        out << "[line " << line << "] Error" << where << ": " << message << "\n";
+    }
+    void runtimeError(const std::string& report) override { out << report; }
+
+private:
+    std::ostream& out;
+};
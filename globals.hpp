@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "interner.hpp"
+#include "value.hpp"
+
+// Top-level variables. The compiler resolves each name's symbol to a fixed
+// slot so the VM indexes a vector instead of hashing; a slot holds EMPTY
+// until the script assigns it.
+class Globals {
+public:
+    static constexpr size_t MAX = UINT16_MAX + 1;
+
+    // Slot for `symbol`, adding one if needed; -1 when the table is full.
+    int slot(SymbolId symbol) {
+        if (symbol >= index.size()) index.resize(symbol + 1, -1);
+        if (index[symbol] >= 0) return index[symbol];
+        if (values.size() == MAX) return -1;
+        index[symbol] = static_cast<int>(values.size());
+        symbols.push_back(symbol);
+        values.push_back(Value::empty());
+        return index[symbol];
+    }
+
+    std::vector<Value> values;
+    std::vector<SymbolId> symbols; // the name of each slot
+
+private:
+    std::vector<int> index; // slot by symbol, -1 if none
+};
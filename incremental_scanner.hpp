@@ -0,0 +1,382 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "scanner.hpp"
+
+// Keeps a token stream in sync with a text buffer that is edited in place,
+// for the REPL and editor tooling.
+//
+// Every line start reached outside a string records the scanner state there
+// (offset, line, token count and indent stack). An edit restarts the scanner
+// from the last line start at or before the edit and stops as soon as it
+// reaches a line start past the edit that existed before with the same indent
+// stack: from there on the old tokens are still right once their offsets and
+// line numbers are shifted.
+//
+// The buffer is kept in blocks of about BLOCK_LINES lines that begin at such
+// line starts. Offsets, lines and token indexes inside a block are relative
+// to it, so an edit rebuilds the blocks it touches and shifts the bases of
+// the blocks after them instead of every token that follows.
+class IncrementalScanner {
+public:
+    static constexpr size_t BLOCK_LINES = 128;
+
+    // Tokens [firstToken, firstToken + insertedTokens) of the new stream
+    // replaced [firstToken, firstToken + removedTokens) of the old one.
+    struct Relex {
+        size_t firstToken;
+        size_t removedTokens;
+        size_t insertedTokens;
+        size_t scannedBytes;
+    };
+
+    explicit IncrementalScanner(std::string_view source) {
+        Block whole;
+        whole.text = source;
+        Scanner scanner(whole.text);
+        scanner.lineStarts = &whole.starts;
+        scanner.indentStacks = &stacks;
+        scanner.recordLineStart();
+        finish(scanner, whole.tokens, whole.literals);
+        textSize = whole.text.size();
+        tokenCount = whole.tokens.size();
+        split(std::move(whole), {0, 0, 0}, blocks, bases);
+    }
+
+    // Token access, with offsets and lines for the whole buffer. A token's
+    // literal index is only meaningful to literal() and lexeme().
+    size_t size() const { return tokenCount; }
+
+    Token operator[](size_t index) const {
+        size_t b = blockOfToken(index);
+        Token token = blocks[b].tokens[index - bases[b].token];
+        token.offset = static_cast<uint32_t>(token.offset + bases[b].offset);
+        token.line += bases[b].line;
+        return token;
+    }
+
+    Value literal(size_t index) const {
+        size_t b = blockOfToken(index);
+        const Token& token = blocks[b].tokens[index - bases[b].token];
+        return token.hasLiteral() ? blocks[b].literals[token.literal].value : Value::none();
+    }
+
+    std::string_view lexeme(size_t index) const {
+        size_t b = blockOfToken(index);
+        const Token& token = blocks[b].tokens[index - bases[b].token];
+        if (token.hasText()) return blocks[b].literals[token.literal].text;
+        return std::string_view(blocks[b].text).substr(token.offset, token.length);
+    }
+
+    // A copy of the whole buffer.
+    std::string source() const {
+        std::string text;
+        text.reserve(textSize);
+        for (const Block& block : blocks) text += block.text;
+        return text;
+    }
+
+    Relex edit(size_t offset, size_t removed, std::string_view inserted) {
+        int64_t delta = static_cast<int64_t>(inserted.size()) - static_cast<int64_t>(removed);
+
+        // Restart from the last line start whose state is known
+        size_t first = blockAt(offset);
+        const Base base = bases[first];
+        const Block& restartBlock = blocks[first];
+        size_t local = offset - base.offset;
+        size_t insertedEnd = local + inserted.size();
+        size_t keepStarts = std::upper_bound(restartBlock.starts.begin(), restartBlock.starts.end(), local,
+            [](size_t value, const Scanner::LineStart& s) { return value < s.offset; }) - restartBlock.starts.begin();
+        const Scanner::LineStart restart = restartBlock.starts[keepStarts - 1];
+
+        // Scan a window of whole blocks from the restart block on, with the
+        // edit applied. If it runs out before the old tokens line up again,
+        // scan again over twice as many blocks.
+        size_t last = std::min(blocks.size(), blockAt(offset + removed) + 1);
+        for (;;) {
+            std::string window;
+            for (size_t b = first; b < last; b++) window += blocks[b].text;
+            window.replace(local, removed, inserted);
+            bool whole = last == blocks.size();
+
+            Scanner scanner(window);
+            scanner.current = static_cast<int>(restart.offset);
+            scanner.line = restart.line;
+            scanner.indentLevels = stacks[restart.stack];
+            scanner.stackId = restart.stack;
+            scanner.indentChanged = false;
+            scanner.chunkTokens = restart.token;
+            std::vector<Scanner::LineStart> fresh;
+            scanner.lineStarts = &fresh;
+            scanner.indentStacks = &stacks;
+
+            std::vector<Token> scanned;
+            std::vector<Literal> literals;
+            size_t checked = 0;
+            size_t syncBlock = blocks.size();
+            size_t syncStart = 0;
+            while (syncBlock == blocks.size() && (!scanner.fStrings.empty() || !scanner.isAtEnd())) {
+                scanner.scanStep(scanned, literals);
+                for (; checked < fresh.size(); checked++) {
+                    const Scanner::LineStart& now = fresh[checked];
+                    if (now.offset < insertedEnd) continue;
+                    // A line start at the end of a partial window may have
+                    // been cut short by it.
+                    if (!whole && now.offset >= window.size()) break;
+                    size_t oldOffset = base.offset + static_cast<size_t>(now.offset - delta);
+                    size_t b = blockAt(oldOffset);
+                    const std::vector<Scanner::LineStart>& starts = blocks[b].starts;
+                    size_t within = oldOffset - bases[b].offset;
+                    auto old = std::lower_bound(starts.begin(), starts.end(), within,
+                        [](const Scanner::LineStart& s, size_t value) { return s.offset < value; });
+                    if (old != starts.end() && old->offset == within && stacks[old->stack] == stacks[now.stack]) {
+                        syncBlock = b;
+                        syncStart = old - starts.begin();
+                        break;
+                    }
+                }
+            }
+            if (syncBlock == blocks.size() && !whole) {
+                last = std::min(blocks.size(), first + 2 * (last - first));
+                continue;
+            }
+
+            // How far everything after the rescanned stretch moves
+            Base shift {static_cast<size_t>(delta), 0, 0};
+            size_t oldEnd = tokenCount;
+            if (syncBlock != blocks.size()) {
+                const Scanner::LineStart& sync = blocks[syncBlock].starts[syncStart];
+                oldEnd = bases[syncBlock].token + sync.token;
+                shift.token = base.token + fresh[checked].token - oldEnd;
+                shift.line = (base.line + fresh[checked].line) - (bases[syncBlock].line + sync.line);
+            } else {
+                finish(scanner, scanned, literals);
+            }
+            Relex relex {base.token + restart.token, oldEnd - base.token - restart.token, scanned.size(),
+                         scanner.current - restart.offset};
+
+            if (syncBlock == first) {
+                // Patch the block in place, shifting only the rest of it
+                Block& block = blocks[first];
+                block.text.replace(local, removed, inserted);
+                uint32_t syncToken = block.starts[syncStart].token;
+                for (uint32_t i = restart.token; i < syncToken; i++) block.garbage += block.tokens[i].hasLiteral();
+                for (Token& token : scanned) {
+                    if (!token.hasLiteral()) continue;
+                    block.literals.push_back(std::move(literals[token.literal]));
+                    token.literal = static_cast<uint32_t>(block.literals.size() - 1);
+                }
+                splice(block.tokens, restart.token, syncToken, scanned.begin(), scanned.end());
+                for (size_t i = restart.token + scanned.size(); i < block.tokens.size(); i++) {
+                    block.tokens[i].offset = static_cast<uint32_t>(block.tokens[i].offset + delta);
+                    block.tokens[i].line += shift.line;
+                }
+                // After an insertion ending in a newline the old lines can
+                // pick up again at the restart line start itself, which then
+                // stays and is added once more at its new place.
+                size_t kept = std::max(syncStart, keepStarts);
+                size_t added = checked + kept - syncStart;
+                splice(block.starts, keepStarts, kept, fresh.begin(), fresh.begin() + added);
+                for (size_t i = keepStarts + added; i < block.starts.size(); i++) {
+                    block.starts[i].offset = static_cast<uint32_t>(block.starts[i].offset + delta);
+                    block.starts[i].token = static_cast<uint32_t>(block.starts[i].token + shift.token);
+                    block.starts[i].line += shift.line;
+                }
+                if (block.literals.size() > 2 * (block.literals.size() - block.garbage) + 64) compact(block);
+            } else {
+                // The rebuilt stretch: the restart block up to the restart
+                // point, the new tokens, and the rest of the sync block moved
+                // into place.
+                Block piece;
+                piece.text = syncBlock != blocks.size() ? window.substr(0, fresh[checked].offset) : std::move(window);
+                for (uint32_t i = 0; i < restart.token; i++) take(piece, restartBlock.tokens[i], restartBlock.literals);
+                piece.starts.assign(restartBlock.starts.begin(), restartBlock.starts.begin() + keepStarts);
+                for (const Token& token : scanned) take(piece, token, literals);
+                piece.starts.insert(piece.starts.end(), fresh.begin(), fresh.begin() + checked);
+                size_t end = blocks.size();
+                if (syncBlock != blocks.size()) {
+                    appendFrom(piece, blocks[syncBlock], syncStart, fresh[checked]);
+                    end = syncBlock + 1;
+                }
+                std::vector<Block> rebuilt;
+                std::vector<Base> rebuiltBases;
+                split(std::move(piece), base, rebuilt, rebuiltBases);
+                replace(blocks, first, end, rebuilt);
+                replace(bases, first, end, rebuiltBases);
+                first += rebuilt.size() - 1;
+            }
+            for (size_t b = first + 1; b < bases.size(); b++) {
+                bases[b].offset += shift.offset;
+                bases[b].token += shift.token;
+                bases[b].line += shift.line;
+            }
+            textSize += shift.offset;
+            tokenCount = bases.back().token + blocks.back().tokens.size();
+            settle(first);
+            return relex;
+        }
+    }
+
+private:
+    // A run of whole lines beginning at a line start outside any string.
+    // Token and line start offsets index `text`, literal indexes `literals`.
+    struct Block {
+        std::string text;
+        std::vector<Token> tokens;
+        std::vector<Literal> literals;
+        std::vector<Scanner::LineStart> starts;
+        size_t garbage = 0; // literals no token refers to any more
+    };
+
+    // Where a block begins in the whole buffer. Its tokens and line starts
+    // add these to their own offset, index and line.
+    struct Base {
+        size_t offset;
+        size_t token;
+        int line;
+    };
+
+    std::vector<Block> blocks;
+    std::vector<Base> bases;
+    std::vector<std::vector<int>> stacks;
+    size_t textSize = 0;
+    size_t tokenCount = 0;
+
+    void finish(Scanner& scanner, std::vector<Token>& out, std::vector<Literal>& literals) {
+        scanner.scanChunk(static_cast<int>(scanner.source.size()), out, literals);
+        for (;;) {
+            Token token = scanner.nextToken();
+            out.push_back(token);
+            if (token.type == TokenType::EOF_) return;
+        }
+    }
+
+    // The block holding `offset`; the end of the buffer belongs to the last.
+    size_t blockAt(size_t offset) const {
+        return std::upper_bound(bases.begin(), bases.end(), offset,
+            [](size_t value, const Base& b) { return value < b.offset; }) - bases.begin() - 1;
+    }
+
+    size_t blockOfToken(size_t index) const {
+        return std::upper_bound(bases.begin(), bases.end(), index,
+            [](size_t value, const Base& b) { return value < b.token; }) - bases.begin() - 1;
+    }
+
+    // Append a token to `block`, copying its literal along.
+    static void take(Block& block, Token token, const std::vector<Literal>& literals) {
+        if (token.hasLiteral()) {
+            block.literals.push_back(literals[token.literal]);
+            token.literal = static_cast<uint32_t>(block.literals.size() - 1);
+        }
+        block.tokens.push_back(token);
+    }
+
+    // Append `from`'s text, tokens and line starts from line start `index`
+    // on, placed so that line start lands on `at`.
+    static void appendFrom(Block& piece, const Block& from, size_t index, const Scanner::LineStart& at) {
+        const Scanner::LineStart& s = from.starts[index];
+        piece.text.append(from.text, s.offset, std::string::npos);
+        for (size_t i = s.token; i < from.tokens.size(); i++) {
+            Token token = from.tokens[i];
+            token.offset = token.offset - s.offset + at.offset;
+            token.line = token.line - s.line + at.line;
+            take(piece, token, from.literals);
+        }
+        for (size_t i = index; i < from.starts.size(); i++) {
+            Scanner::LineStart moved = from.starts[i];
+            moved.offset = moved.offset - s.offset + at.offset;
+            moved.token = moved.token - s.token + at.token;
+            moved.line = moved.line - s.line + at.line;
+            piece.starts.push_back(moved);
+        }
+    }
+
+    // Cut `piece`, which begins at `base`, into blocks of about BLOCK_LINES
+    // line starts each.
+    static void split(Block piece, Base base, std::vector<Block>& out, std::vector<Base>& outBases) {
+        size_t count = piece.starts.size();
+        if (count < 2 * BLOCK_LINES) {
+            out.push_back(std::move(piece));
+            outBases.push_back(base);
+            return;
+        }
+        for (size_t a = 0, b; a < count; a = b) {
+            b = count - a < 2 * BLOCK_LINES ? count : a + BLOCK_LINES;
+            const Scanner::LineStart s = piece.starts[a];
+            size_t textEnd = b < count ? piece.starts[b].offset : piece.text.size();
+            size_t tokenEnd = b < count ? piece.starts[b].token : piece.tokens.size();
+            Block block;
+            block.text = piece.text.substr(s.offset, textEnd - s.offset);
+            for (size_t i = s.token; i < tokenEnd; i++) {
+                Token token = piece.tokens[i];
+                token.offset -= s.offset;
+                token.line -= s.line;
+                take(block, token, piece.literals);
+            }
+            for (size_t i = a; i < b; i++) {
+                Scanner::LineStart moved = piece.starts[i];
+                moved.offset -= s.offset;
+                moved.token -= s.token;
+                moved.line -= s.line;
+                block.starts.push_back(moved);
+            }
+            out.push_back(std::move(block));
+            outBases.push_back({base.offset + s.offset, base.token + s.token, base.line + s.line});
+        }
+    }
+
+    // Keep blocks near BLOCK_LINES line starts: split one that grew too
+    // big, fold one that shrank into the block after it.
+    void settle(size_t b) {
+        size_t end = b + 1;
+        if (blocks[b].starts.size() < BLOCK_LINES / 4 && end < blocks.size()) {
+            const Block& next = blocks[end];
+            Scanner::LineStart at = next.starts[0];
+            at.offset = static_cast<uint32_t>(blocks[b].text.size());
+            at.token = static_cast<uint32_t>(blocks[b].tokens.size());
+            at.line = bases[end].line + next.starts[0].line - bases[b].line;
+            appendFrom(blocks[b], next, 0, at);
+            end++;
+        } else if (blocks[b].starts.size() < 2 * BLOCK_LINES) {
+            return;
+        }
+        std::vector<Block> rebuilt;
+        std::vector<Base> rebuiltBases;
+        split(std::move(blocks[b]), bases[b], rebuilt, rebuiltBases);
+        replace(blocks, b, end, rebuilt);
+        replace(bases, b, end, rebuiltBases);
+    }
+
+    static void compact(Block& block) {
+        std::vector<Literal> live;
+        live.reserve(block.literals.size() - block.garbage);
+        for (Token& token : block.tokens) {
+            if (!token.hasLiteral()) continue;
+            live.push_back(std::move(block.literals[token.literal]));
+            token.literal = static_cast<uint32_t>(live.size() - 1);
+        }
+        block.literals = std::move(live);
+        block.garbage = 0;
+    }
+
+    // Replace v[first, end) with [from, to), moving the tail only once.
+    template <class T, class It>
+    static void splice(std::vector<T>& v, size_t first, size_t end, It from, It to) {
+        size_t count = static_cast<size_t>(to - from);
+        size_t removed = end - first;
+        if (count > removed) {
+            std::copy(from, from + removed, v.begin() + first);
+            v.insert(v.begin() + end, from + removed, to);
+        } else {
+            std::copy(from, to, v.begin() + first);
+            v.erase(v.begin() + first + count, v.begin() + end);
+        }
+    }
+
+    template <class T>
+    static void replace(std::vector<T>& v, size_t first, size_t end, std::vector<T>& with) {
+        splice(v, first, end, std::make_move_iterator(with.begin()), std::make_move_iterator(with.end()));
+    }
+};
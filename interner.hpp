@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+inline uint32_t hashString(std::string_view text) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (char c : text) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+using SymbolId = uint32_t;
+
+// Maps names to dense ids, one per distinct spelling, so later stages compare
+// and index by integer. The bytes are copied once into fixed-size arena
+// blocks that never move, so name() views stay valid for the interner's
+// lifetime.
+class Interner {
+public:
+    static constexpr SymbolId NONE = UINT32_MAX;
+
+    Interner() : table(64, NONE) {}
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    SymbolId intern(std::string_view text) {
+        uint32_t hash = hashString(text);
+        size_t i = probe(text, hash);
+        if (table[i] != NONE) return table[i];
+
+        SymbolId id = static_cast<SymbolId>(names.size());
+        names.push_back(store(text));
+        hashes.push_back(hash);
+        table[i] = id;
+        if (names.size() * 2 > table.size()) grow();
+        return id;
+    }
+
+    // The id of an already interned name, or NONE.
+    SymbolId find(std::string_view text) const { return table[probe(text, hashString(text))]; }
+
+    std::string_view name(SymbolId id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<SymbolId> table; // open addressing, linear probing
+    std::vector<std::string_view> names;
+    std::vector<uint32_t> hashes;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* blockNext = nullptr;
+    size_t blockLeft = 0;
+
+    size_t probe(std::string_view text, uint32_t hash) const {
+        size_t mask = table.size() - 1;
+        size_t i = hash & mask;
+        while (table[i] != NONE && (hashes[table[i]] != hash || names[table[i]] != text)) i = (i + 1) & mask;
+        return i;
+    }
+
+    void grow() {
+        std::vector<SymbolId> bigger(table.size() * 2, NONE);
+        size_t mask = bigger.size() - 1;
+        for (SymbolId id = 0; id < names.size(); id++) {
+            size_t i = hashes[id] & mask;
+            while (bigger[i] != NONE) i = (i + 1) & mask;
+            bigger[i] = id;
+        }
+        table = std::move(bigger);
+    }
+
+    std::string_view store(std::string_view text) {
+        if (text.size() > blockLeft) {
+            size_t size = text.size() > BLOCK_SIZE ? text.size() : BLOCK_SIZE;
+            blocks.emplace_back(new char[size]);
+            blockNext = blocks.back().get();
+            blockLeft = size;
+        }
+        if (!text.empty()) std::memcpy(blockNext, text.data(), text.size());
+        std::string_view stored(blockNext, text.size());
+        blockNext += text.size();
+        blockLeft -= text.size();
+        return stored;
+    }
+};
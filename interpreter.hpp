@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "vm.hpp"
+
+// The embedding API. An Interpreter is one isolated VM: its own heap,
+// symbols, globals and error sink, with what scripts print captured instead
+// of going to the process's streams. An instance is not thread-safe, but
+// instances share nothing, so any number can run at once on as many threads.
+//
+// InterpreterPool runs many independent scripts on a fixed set of worker
+// threads, each script in a fresh Interpreter:
+//
+//     InterpreterPool pool;
+//     std::future<ScriptResult> result = pool.submit("print 6 * 7\n");
+//     std::cout << result.get().output; // "42\n"
+//
+// Native modules are not installed; untrusted scripts should not be able to
+// load native code. Call NativeModules::install(interpreter.vm()) to allow it.
+
+struct ScriptResult {
+    InterpretResult status = InterpretResult::OK;
+    std::string output; // what the script printed
+    std::string errors; // compile or runtime errors, formatted as the command line prints them
+};
+
+class Interpreter {
+public:
+    explicit Interpreter(HeapConfig heapConfig = HeapConfig()) : machine(out, in, err, heapConfig) {}
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
+
+    // Runs `source` against this interpreter's globals, which persist from
+    // earlier runs. `input` is what the script's input() calls read.
+    ScriptResult run(std::string_view source, std::string_view input = {}) {
+        out.str("");
+        err.str("");
+        in.str(std::string(input));
+        in.clear();
+        ScriptResult result;
+        result.status = machine.interpret(source);
+        result.output = out.str();
+        result.errors = err.str();
+        return result;
+    }
+
+    VM& vm() { return machine; }
+
+private:
+    std::ostringstream out;
+    std::ostringstream err;
+    std::istringstream in;
+    VM machine;
+};
+
+class InterpreterPool {
+public:
+    explicit InterpreterPool(unsigned threads = std::thread::hardware_concurrency(),
+                             HeapConfig heapConfig = HeapConfig())
+        : heapConfig(heapConfig) {
+        threads = std::max(1u, threads);
+        for (unsigned i = 0; i < threads; i++) workers.emplace_back([this] { work(); });
+    }
+
+    // Finishes every script already submitted, then stops the workers.
+    ~InterpreterPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    InterpreterPool(const InterpreterPool&) = delete;
+    InterpreterPool& operator=(const InterpreterPool&) = delete;
+
+    std::future<ScriptResult> submit(std::string source, std::string input = "") {
+        Job job {std::move(source), std::move(input), {}};
+        std::future<ScriptResult> result = job.result.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(job));
+        }
+        ready.notify_one();
+        return result;
+    }
+
+    size_t threads() const { return workers.size(); }
+
+private:
+    struct Job {
+        std::string source;
+        std::string input;
+        std::promise<ScriptResult> result;
+    };
+
+    HeapConfig heapConfig;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> queue;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void work() {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            // A fresh interpreter per script, so no script sees another's globals
+            Interpreter interpreter(heapConfig);
+            job.result.set_value(interpreter.run(job.source, job.input));
+        }
+    }
+};
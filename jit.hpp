@@ -0,0 +1,638 @@
+#pragma once
+#include <sys/mman.h>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "chunk.hpp"
+#include "object.hpp"
+#include "value.hpp"
+
+// A baseline JIT for x86-64 Linux, built in with -DAXIOM_JIT. Once a
+// function has been called or has looped VM::jitThreshold times, its
+// bytecode is translated one instruction at a time into machine code that
+// works on the interpreter's own slots and operand stack. Ints, bools,
+// locals, globals, jumps, list iteration and a function's tail calls to
+// itself run natively. Each instruction guards the types it handles inline;
+// anything else leaves the machine code at that instruction, with the stack
+// as the interpreter expects it, and the interpreter carries on from there.
+// The interpreter enters machine code at function starts and loop heads.
+//
+// Machine code never allocates, so the collector cannot run while it does.
+
+struct JitStats {
+    size_t compiled = 0; // functions translated
+    size_t rejected = 0; // functions that could not be
+    size_t codeBytes = 0;
+    size_t entries = 0;  // times the interpreter ran machine code
+};
+
+// One function's machine code, in its own executable mapping.
+class JitCode {
+public:
+    JitCode(const std::vector<uint8_t>& bytes, std::vector<uint32_t> entries) : entries(std::move(entries)) {
+        size = (bytes.size() + 4095) & ~size_t(4095);
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) return;
+        std::memcpy(mapped, bytes.data(), bytes.size());
+        if (mprotect(mapped, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(mapped, size);
+            return;
+        }
+        memory = static_cast<uint8_t*>(mapped);
+    }
+    ~JitCode() {
+        if (memory) munmap(memory, size);
+    }
+    JitCode(const JitCode&) = delete;
+    JitCode& operator=(const JitCode&) = delete;
+
+    bool ok() const { return memory != nullptr; }
+
+    // True if `offset` starts an instruction the code can be entered at.
+    bool canEnter(size_t offset) const { return offset < entries.size() && entries[offset] != NO_ENTRY; }
+
+    // Runs from bytecode `offset` with the frame's slots and the operand
+    // stack at *stackTop. Returns the offset of the instruction to interpret
+    // next, with *stackTop moved to match.
+    uint32_t run(size_t offset, Value* slots, Value** stackTop, Value* globals) const {
+        auto native = reinterpret_cast<uint32_t (*)(Value*, Value**, Value*, const uint8_t*)>(memory);
+        return native(slots, stackTop, globals, memory + entries[offset]);
+    }
+
+    static constexpr uint32_t NO_ENTRY = UINT32_MAX;
+
+private:
+    uint8_t* memory = nullptr;
+    size_t size;
+    std::vector<uint32_t> entries; // code offset by bytecode offset
+};
+
+// Just the x86-64 encodings the JIT emits: 64-bit moves and arithmetic
+// between registers and [base + displacement], shifts, and rel32 jumps
+// patched once their targets are known.
+class X64 {
+public:
+    enum Reg : uint8_t { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+    enum Cond : uint8_t { O = 0x0, B = 0x2, E = 0x4, NE = 0x5, L = 0xc, GE = 0xd, LE = 0xe, G = 0xf };
+
+    std::vector<uint8_t> code;
+
+    size_t here() const { return code.size(); }
+
+    void load(Reg dst, Reg base, int32_t disp) { withMemory(0x8b, dst, base, disp); }
+    void store(Reg base, int32_t disp, Reg src) { withMemory(0x89, src, base, disp); }
+    void lea(Reg dst, Reg base, int32_t disp) { withMemory(0x8d, dst, base, disp); }
+
+    void mov(Reg dst, Reg src) { withRegister(0x89, src, dst); }
+    void add(Reg dst, Reg src) { withRegister(0x01, src, dst); }
+    void sub(Reg dst, Reg src) { withRegister(0x29, src, dst); }
+    void or_(Reg dst, Reg src) { withRegister(0x09, src, dst); }
+    void xor_(Reg dst, Reg src) { withRegister(0x31, src, dst); }
+    void cmp(Reg a, Reg b) { withRegister(0x39, b, a); }
+    void test(Reg a, Reg b) { withRegister(0x85, b, a); }
+    void imul(Reg dst, Reg src) {
+        rex(dst, src);
+        emit(0x0f, 0xaf);
+        modrm(3, dst, src);
+    }
+
+    void movImm(Reg dst, uint64_t value) {
+        rex(RAX, dst);
+        emit(0xb8 + (dst & 7));
+        emit64(value);
+    }
+    void addImm(Reg dst, int32_t value) { withImmediate(0, dst, value); }
+    // Compares the low 32 bits.
+    void cmpImm32(Reg a, int32_t value) {
+        if (a >= R8) emit(0x41);
+        emit(0x81);
+        modrm(3, 7, a);
+        emit32(static_cast<uint32_t>(value));
+    }
+    void shl(Reg r, uint8_t bits) { shift(4, r, bits); }
+    void shr(Reg r, uint8_t bits) { shift(5, r, bits); }
+    void sar(Reg r, uint8_t bits) { shift(7, r, bits); }
+    void neg(Reg r) { unary(3, r); }
+    void idiv(Reg r) { unary(7, r); }
+    void cqo() { emit(0x48, 0x99); }
+    // al = condition, zero-extended into eax
+    void setAl(Cond cond) {
+        emit(0x0f, 0x90 + cond, 0xc0);
+        emit(0x0f, 0xb6, 0xc0);
+    }
+
+    void push(Reg r) {
+        if (r >= R8) emit(0x41);
+        emit(0x50 + (r & 7));
+    }
+    void pop(Reg r) {
+        if (r >= R8) emit(0x41);
+        emit(0x58 + (r & 7));
+    }
+    void call(Reg r) {
+        if (r >= R8) emit(0x41);
+        emit(0xff);
+        modrm(3, 2, r);
+    }
+    void jumpTo(Reg r) {
+        if (r >= R8) emit(0x41);
+        emit(0xff);
+        modrm(3, 4, r);
+    }
+    void ret() { emit(0xc3); }
+    void movEax(uint32_t value) {
+        emit(0xb8);
+        emit32(value);
+    }
+
+    // Jumps with a rel32 to fill in later; each returns where it goes.
+    size_t jump() {
+        emit(0xe9);
+        return placeholder();
+    }
+    size_t jumpIf(Cond cond) {
+        emit(0x0f, 0x80 + cond);
+        return placeholder();
+    }
+    void patch(size_t at, size_t target) {
+        uint32_t rel = static_cast<uint32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+        std::memcpy(&code[at], &rel, 4);
+    }
+    void patchHere(size_t at) { patch(at, here()); }
+
+    static Cond negate(Cond cond) { return static_cast<Cond>(cond ^ 1); }
+
+private:
+    template <class... Bytes>
+    void emit(Bytes... bytes) {
+        (code.push_back(static_cast<uint8_t>(bytes)), ...);
+    }
+    void emit32(uint32_t value) {
+        for (int i = 0; i < 4; i++) emit(value >> (8 * i));
+    }
+    void emit64(uint64_t value) {
+        for (int i = 0; i < 8; i++) emit(value >> (8 * i));
+    }
+    size_t placeholder() {
+        emit32(0);
+        return here() - 4;
+    }
+
+    void rex(int reg, int rm) { emit(0x48 | (reg >= R8 ? 4 : 0) | (rm >= R8 ? 1 : 0)); }
+    void modrm(int mod, int reg, int rm) { emit((mod << 6) | ((reg & 7) << 3) | (rm & 7)); }
+
+    void withRegister(uint8_t opcode, Reg reg, Reg rm) {
+        rex(reg, rm);
+        emit(opcode);
+        modrm(3, reg, rm);
+    }
+    // Always with a displacement, so rbp and r13 need no special case;
+    // rsp and r12 need a SIB byte.
+    void withMemory(uint8_t opcode, Reg reg, Reg base, int32_t disp) {
+        rex(reg, base);
+        emit(opcode);
+        bool small = disp >= -128 && disp <= 127;
+        modrm(small ? 1 : 2, reg, base);
+        if ((base & 7) == RSP) emit(0x24);
+        if (small) emit(disp);
+        else emit32(static_cast<uint32_t>(disp));
+    }
+    void withImmediate(int extension, Reg r, int32_t value) {
+        rex(RAX, r);
+        bool small = value >= -128 && value <= 127;
+        emit(small ? 0x83 : 0x81);
+        modrm(3, extension, r);
+        if (small) emit(value);
+        else emit32(static_cast<uint32_t>(value));
+    }
+    void shift(int extension, Reg r, uint8_t bits) {
+        rex(RAX, r);
+        emit(0xc1);
+        modrm(3, extension, r);
+        emit(bits);
+    }
+    void unary(int extension, Reg r) {
+        rex(RAX, r);
+        emit(0xf7);
+        modrm(3, extension, r);
+    }
+};
+
+// Translates one function. The generated code keeps its state in
+// callee-saved registers:
+//   rbx  the frame's slots          r15  the operand stack top
+//   r14  the globals                r13  where to store r15 on the way out
+//   r12  the bits of the inline int 0, or'd in to tag a result
+// and everything else is scratch. Each instruction that can bail out gets
+// a stub, placed after the body, that returns its offset.
+class JitCompiler {
+public:
+    explicit JitCompiler(JitStats& stats) : stats(stats) {}
+
+    std::unique_ptr<JitCode> compile(const ObjFunction* function) {
+        this->function = function;
+        const Chunk& chunk = function->chunk;
+        std::unique_ptr<JitCode> code;
+        if (translate(chunk)) {
+            code = std::make_unique<JitCode>(x.code, std::move(labels));
+            if (!code->ok()) code.reset();
+        }
+        if (!code) {
+            stats.rejected++;
+            return nullptr;
+        }
+        stats.compiled++;
+        stats.codeBytes += x.code.size();
+        return code;
+    }
+
+private:
+    using Reg = X64::Reg;
+    using Cond = X64::Cond;
+
+    struct Fixup {
+        size_t at;       // rel32 to patch
+        uint32_t target; // bytecode offset, or the offset whose exit stub it jumps to
+    };
+
+    JitStats& stats;
+    const ObjFunction* function = nullptr; // being translated
+    X64 x;
+    std::vector<uint32_t> labels; // code offset by bytecode offset
+    std::vector<Fixup> jumps;
+    std::vector<Fixup> exits;
+    uint32_t offset = 0; // of the instruction being translated
+
+    static constexpr int INT_TOP = static_cast<int>(0x7ffd); // the top 16 bits of every inline int
+
+    static uint64_t raw(Value value) { return value.raw(); }
+
+    bool translate(const Chunk& chunk) {
+        const std::vector<uint8_t>& code = chunk.code;
+        labels.assign(code.size(), JitCode::NO_ENTRY);
+
+        x.push(X64::RBX);
+        x.push(X64::R12);
+        x.push(X64::R13);
+        x.push(X64::R14);
+        x.push(X64::R15);
+        x.mov(X64::RBX, X64::RDI);
+        x.mov(X64::R13, X64::RSI);
+        x.load(X64::R15, X64::RSI, 0);
+        x.mov(X64::R14, X64::RDX);
+        x.movImm(X64::R12, raw(Value::integer(0)));
+        x.jumpTo(X64::RCX);
+
+        for (size_t ip = 0; ip < code.size();) {
+            OpCode op = static_cast<OpCode>(code[ip]);
+            size_t next = ip + 1 + operandBytes(op);
+            if (next > code.size()) return false;
+            offset = static_cast<uint32_t>(ip);
+            labels[ip] = static_cast<uint32_t>(x.here());
+            instruction(chunk, op, &code[ip + 1], next);
+            ip = next;
+        }
+
+        // Exit stubs, then the shared way out
+        std::vector<size_t> stubs(code.size(), SIZE_MAX);
+        std::vector<size_t> epilogueJumps;
+        for (const Fixup& fixup : exits) {
+            if (stubs[fixup.target] == SIZE_MAX) {
+                stubs[fixup.target] = x.here();
+                x.movEax(fixup.target);
+                epilogueJumps.push_back(x.jump());
+            }
+            x.patch(fixup.at, stubs[fixup.target]);
+        }
+        for (size_t at : epilogueJumps) x.patchHere(at);
+        x.store(X64::R13, 0, X64::R15);
+        x.pop(X64::R15);
+        x.pop(X64::R14);
+        x.pop(X64::R13);
+        x.pop(X64::R12);
+        x.pop(X64::RBX);
+        x.ret();
+
+        for (const Fixup& fixup : jumps) {
+            if (fixup.target >= labels.size() || labels[fixup.target] == JitCode::NO_ENTRY) return false;
+            x.patch(fixup.at, labels[fixup.target]);
+        }
+        return true;
+    }
+
+    // ---- pieces of templates -----------------------------------------------
+
+    // Leaves for the interpreter at the current instruction.
+    void bail() { exits.push_back({x.jump(), offset}); }
+    void bailIf(Cond cond) { exits.push_back({x.jumpIf(cond), offset}); }
+    void jumpTo(size_t target) { jumps.push_back({x.jump(), static_cast<uint32_t>(target)}); }
+    void jumpIf(Cond cond, size_t target) { jumps.push_back({x.jumpIf(cond), static_cast<uint32_t>(target)}); }
+
+    void push(Reg r) {
+        x.store(X64::R15, 0, r);
+        x.addImm(X64::R15, 8);
+    }
+
+    // Bails unless `r` holds an inline int, then leaves the int itself.
+    void untagInt(Reg r) {
+        x.mov(X64::RDX, r);
+        x.shr(X64::RDX, 48);
+        x.cmpImm32(X64::RDX, INT_TOP);
+        bailIf(X64::NE);
+        x.shl(r, 16);
+        x.sar(r, 16);
+    }
+
+    // Bails unless the int in `r` fits inline, then tags it.
+    void tagInt(Reg r) {
+        x.mov(X64::RDX, r);
+        x.shl(X64::RDX, 16);
+        x.sar(X64::RDX, 16);
+        x.cmp(X64::RDX, r);
+        bailIf(X64::NE);
+        x.shl(r, 16);
+        x.shr(r, 16);
+        x.or_(r, X64::R12);
+    }
+
+    // rax op= rcx for ADD, SUBTRACT, MULTIPLY or MODULO on untagged ints,
+    // bailing on overflow and modulo by zero. Uses rdx.
+    void arithmetic(OpCode op) {
+        switch (op) {
+            case OpCode::ADD: x.add(X64::RAX, X64::RCX); break;
+            case OpCode::SUBTRACT: x.sub(X64::RAX, X64::RCX); break;
+            case OpCode::MULTIPLY:
+                x.imul(X64::RAX, X64::RCX);
+                bailIf(X64::O);
+                break;
+            default: {
+                // The remainder takes the divisor's sign, as in moduloInt
+                x.test(X64::RCX, X64::RCX);
+                bailIf(X64::E);
+                x.cqo();
+                x.idiv(X64::RCX);
+                x.mov(X64::RAX, X64::RDX);
+                x.test(X64::RDX, X64::RDX);
+                size_t exact = x.jumpIf(X64::E);
+                x.xor_(X64::RDX, X64::RCX);
+                size_t sameSign = x.jumpIf(X64::GE);
+                x.add(X64::RAX, X64::RCX);
+                x.patchHere(exact);
+                x.patchHere(sameSign);
+                break;
+            }
+        }
+    }
+
+    // Loads the top two values into rax and rcx as ints, or bails.
+    void intOperands() {
+        x.load(X64::RAX, X64::R15, -16);
+        x.load(X64::RCX, X64::R15, -8);
+        untagInt(X64::RAX);
+        untagInt(X64::RCX);
+    }
+
+    static Cond condition(OpCode comparison) {
+        switch (comparison) {
+            case OpCode::EQUAL: return X64::E;
+            case OpCode::NOT_EQUAL: return X64::NE;
+            case OpCode::GREATER: return X64::G;
+            case OpCode::GREATER_EQUAL: return X64::GE;
+            case OpCode::LESS: return X64::L;
+            default: return X64::LE;
+        }
+    }
+
+    // Jumps to `falsey` for false, none and int 0, falls through for true
+    // and other ints, and bails for anything else. Clobbers `r`.
+    void branchIfFalsey(Reg r, std::vector<size_t>& falsey) {
+        x.movImm(X64::RCX, raw(Value::boolean(false)));
+        x.cmp(r, X64::RCX);
+        falsey.push_back(x.jumpIf(X64::E));
+        x.movImm(X64::RCX, raw(Value::none()));
+        x.cmp(r, X64::RCX);
+        falsey.push_back(x.jumpIf(X64::E));
+        x.movImm(X64::RCX, raw(Value::boolean(true)));
+        x.cmp(r, X64::RCX);
+        size_t truthy = x.jumpIf(X64::E);
+        untagInt(r);
+        x.test(r, r);
+        falsey.push_back(x.jumpIf(X64::E));
+        x.patchHere(truthy);
+    }
+
+    // FOR_ITER over a range, a list or a dict, which never allocates: 2 with
+    // the next item stored at `top`, 1 when the loop is over, 0 for the
+    // interpreter.
+    static uint32_t forIter(Value* iterator, Value* top) {
+        Value iterable = iterator[0];
+        size_t position = static_cast<size_t>(iterator[1].asInt());
+        if (isRange(iterable)) {
+            ObjRange* range = asRange(iterable);
+            if (position >= range->count) return 1;
+            int64_t i = range->at(position);
+            if (!Value::fitsInt(i)) return 0; // would need a boxed int
+            *top = Value::integer(i);
+        } else if (isList(iterable)) {
+            ObjList* list = asList(iterable);
+            if (position >= list->items.size()) return 1;
+            *top = list->items[position];
+        } else if (isDict(iterable)) {
+            ObjDict* dict = asDict(iterable);
+            if (position >= dict->table.size()) return 1;
+            *top = dict->table[position].key;
+        } else {
+            return 0;
+        }
+        iterator[1] = Value::integer(static_cast<int64_t>(position + 1));
+        return 2;
+    }
+
+    // ---- instructions ------------------------------------------------------
+
+    void instruction(const Chunk& chunk, OpCode op, const uint8_t* operand, size_t next) {
+        uint16_t u16 = operandBytes(op) >= 2 ? static_cast<uint16_t>((operand[0] << 8) | operand[1]) : 0;
+        switch (op) {
+            case OpCode::CONSTANT: {
+                const Value& constant = chunk.constants[u16];
+                // Objects are read from the constant table, where the
+                // collector updates them when it moves them
+                if (constant.isObj()) {
+                    x.movImm(X64::RAX, reinterpret_cast<uintptr_t>(&constant));
+                    x.load(X64::RAX, X64::RAX, 0);
+                } else {
+                    x.movImm(X64::RAX, raw(constant));
+                }
+                push(X64::RAX);
+                break;
+            }
+            case OpCode::NONE: case OpCode::TRUE: case OpCode::FALSE:
+                x.movImm(X64::RAX, raw(op == OpCode::NONE ? Value::none() : Value::boolean(op == OpCode::TRUE)));
+                push(X64::RAX);
+                break;
+            case OpCode::POP:
+                x.addImm(X64::R15, -8);
+                break;
+            case OpCode::DUP:
+                x.load(X64::RAX, X64::R15, -8);
+                push(X64::RAX);
+                break;
+            case OpCode::DUP2:
+                x.load(X64::RAX, X64::R15, -16);
+                x.load(X64::RCX, X64::R15, -8);
+                x.store(X64::R15, 0, X64::RAX);
+                x.store(X64::R15, 8, X64::RCX);
+                x.addImm(X64::R15, 16);
+                break;
+            case OpCode::GET_LOCAL:
+                x.load(X64::RAX, X64::RBX, 8 * operand[0]);
+                push(X64::RAX);
+                break;
+            case OpCode::GET_LOCALS:
+                x.load(X64::RAX, X64::RBX, 8 * operand[0]);
+                x.load(X64::RCX, X64::RBX, 8 * operand[1]);
+                x.store(X64::R15, 0, X64::RAX);
+                x.store(X64::R15, 8, X64::RCX);
+                x.addImm(X64::R15, 16);
+                break;
+            case OpCode::SET_LOCAL: case OpCode::STORE_LOCAL:
+                x.load(X64::RAX, X64::R15, -8);
+                x.store(X64::RBX, 8 * operand[0], X64::RAX);
+                if (op == OpCode::STORE_LOCAL) x.addImm(X64::R15, -8);
+                break;
+            case OpCode::GET_GLOBAL:
+                x.load(X64::RAX, X64::R14, 8 * u16);
+                x.movImm(X64::RCX, raw(Value::empty()));
+                x.cmp(X64::RAX, X64::RCX);
+                bailIf(X64::E); // undefined: the interpreter reports it
+                push(X64::RAX);
+                break;
+            case OpCode::SET_GLOBAL:
+                x.load(X64::RAX, X64::R15, -8);
+                x.store(X64::R14, 8 * u16, X64::RAX);
+                break;
+            case OpCode::INC_LOCAL: case OpCode::INC_GLOBAL: {
+                bool local = op == OpCode::INC_LOCAL;
+                Reg base = local ? X64::RBX : X64::R14;
+                int32_t disp = local ? 8 * operand[0] : 8 * u16;
+                x.load(X64::RAX, base, disp);
+                untagInt(X64::RAX);
+                x.addImm(X64::RAX, static_cast<int8_t>(operand[local ? 1 : 2]));
+                tagInt(X64::RAX);
+                x.store(base, disp, X64::RAX);
+                break;
+            }
+            case OpCode::ADD: case OpCode::SUBTRACT: case OpCode::MULTIPLY: case OpCode::MODULO:
+                intOperands();
+                arithmetic(op);
+                tagInt(X64::RAX);
+                x.store(X64::R15, -16, X64::RAX);
+                x.addImm(X64::R15, -8);
+                break;
+            case OpCode::LOCAL_OP_CONSTANT: {
+                Value constant = chunk.constants[u16];
+                if (!constant.isInt()) {
+                    bail();
+                    break;
+                }
+                x.load(X64::RAX, X64::RBX, 8 * operand[2]);
+                untagInt(X64::RAX);
+                x.movImm(X64::RCX, static_cast<uint64_t>(constant.asInt()));
+                arithmetic(static_cast<OpCode>(operand[3]));
+                tagInt(X64::RAX);
+                push(X64::RAX);
+                break;
+            }
+            case OpCode::EQUAL: case OpCode::NOT_EQUAL: case OpCode::GREATER: case OpCode::GREATER_EQUAL:
+            case OpCode::LESS: case OpCode::LESS_EQUAL:
+                intOperands();
+                x.cmp(X64::RAX, X64::RCX);
+                x.setAl(condition(op));
+                x.movImm(X64::RCX, raw(Value::boolean(false)));
+                x.or_(X64::RAX, X64::RCX); // false | 1 is true
+                x.store(X64::R15, -16, X64::RAX);
+                x.addImm(X64::R15, -8);
+                break;
+            case OpCode::NOT: {
+                std::vector<size_t> falsey;
+                x.load(X64::RAX, X64::R15, -8);
+                branchIfFalsey(X64::RAX, falsey);
+                x.movImm(X64::RAX, raw(Value::boolean(false)));
+                size_t done = x.jump();
+                for (size_t at : falsey) x.patchHere(at);
+                x.movImm(X64::RAX, raw(Value::boolean(true)));
+                x.patchHere(done);
+                x.store(X64::R15, -8, X64::RAX);
+                break;
+            }
+            case OpCode::NEGATE:
+                x.load(X64::RAX, X64::R15, -8);
+                untagInt(X64::RAX);
+                x.neg(X64::RAX);
+                tagInt(X64::RAX);
+                x.store(X64::R15, -8, X64::RAX);
+                break;
+            case OpCode::JUMP:
+                jumpTo(next + u16);
+                break;
+            case OpCode::LOOP:
+                jumpTo(next - u16);
+                break;
+            case OpCode::JUMP_IF_FALSE: {
+                std::vector<size_t> falsey;
+                x.load(X64::RAX, X64::R15, -8);
+                branchIfFalsey(X64::RAX, falsey);
+                for (size_t at : falsey) jumps.push_back({at, static_cast<uint32_t>(next + u16)});
+                break;
+            }
+            case OpCode::JUMP_UNLESS:
+                intOperands();
+                x.addImm(X64::R15, -16);
+                x.cmp(X64::RAX, X64::RCX);
+                jumpIf(X64::negate(condition(static_cast<OpCode>(operand[2]))), next + u16);
+                break;
+            case OpCode::FOR_ITER: {
+                uint16_t exit = static_cast<uint16_t>((operand[1] << 8) | operand[2]);
+                x.lea(X64::RDI, X64::RBX, 8 * operand[0]);
+                x.mov(X64::RSI, X64::R15);
+                x.movImm(X64::RAX, reinterpret_cast<uintptr_t>(&forIter));
+                x.call(X64::RAX);
+                x.cmpImm32(X64::RAX, 1);
+                bailIf(X64::B);
+                jumpIf(X64::E, next + exit);
+                x.addImm(X64::R15, 8);
+                break;
+            }
+            case OpCode::TAIL_CALL: {
+                // This function calling itself is a jump back to its start,
+                // with the arguments moved over the parameters and the other
+                // locals reset. Functions never move, so the guard can
+                // compare against the Value's bits.
+                int argCount = operand[0];
+                if (argCount != function->arity || function->generator) {
+                    bail();
+                    break;
+                }
+                x.load(X64::RAX, X64::R15, -8 * (argCount + 1));
+                x.movImm(X64::RCX, raw(Value::object(const_cast<ObjFunction*>(function))));
+                x.cmp(X64::RAX, X64::RCX);
+                bailIf(X64::NE);
+                x.store(X64::RBX, 0, X64::RCX);
+                for (int i = 1; i <= argCount; i++) {
+                    x.load(X64::RAX, X64::R15, -8 * (argCount + 1 - i));
+                    x.store(X64::RBX, 8 * i, X64::RAX);
+                }
+                x.movImm(X64::RAX, raw(Value::none()));
+                for (int i = argCount + 1; i < function->slotCount; i++) x.store(X64::RBX, 8 * i, X64::RAX);
+                x.lea(X64::R15, X64::RBX, 8 * function->slotCount);
+                jumpTo(0);
+                break;
+            }
+            default:
+                // Calls, returns, objects, strings, doubles: all interpreted
+                bail();
+                break;
+        }
+    }
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <string_view>
+#include "token_type.hpp"
+
+// Keyword recognition without allocation or runtime hashing. The keyword set
+// is fixed, so a perfect hash over (first byte, last byte, length) is searched
+// for at compile time; a lookup is one table load plus a short compare.
+
+struct KeywordEntry {
+    std::string_view text;
+    TokenType type = TokenType::IDENTIFIER;
+};
+
+inline constexpr KeywordEntry KEYWORDS[] = {
+    {"and", TokenType::AND}, {"class", TokenType::CLASS}, {"def", TokenType::DEF},
+    {"else", TokenType::ELSE}, {"false", TokenType::FALSE}, {"for", TokenType::FOR},
+    {"if", TokenType::IF}, {"in", TokenType::IN}, {"input", TokenType::INPUT},
+    {"none", TokenType::NONE}, {"or", TokenType::OR}, {"print", TokenType::PRINT},
+    {"return", TokenType::RETURN}, {"super", TokenType::SUPER}, {"this", TokenType::THIS},
+    {"true", TokenType::TRUE}, {"while", TokenType::WHILE}, {"yield", TokenType::YIELD}
+};
+
+struct KeywordTable {
+    static constexpr unsigned SIZE = 64;
+    static constexpr size_t MIN_LENGTH = 2;
+    static constexpr size_t MAX_LENGTH = 6;
+
+    unsigned a = 0, b = 0; // a == 0 means no perfect hash was found
+    KeywordEntry slots[SIZE] {};
+
+    static constexpr unsigned hash(std::string_view text, unsigned a, unsigned b) {
+        return (static_cast<unsigned char>(text.front()) * a +
+                static_cast<unsigned char>(text.back()) * b +
+                static_cast<unsigned>(text.size())) % SIZE;
+    }
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    for (unsigned a = 1; a < 2 * KeywordTable::SIZE; a++) {
+        for (unsigned b = 0; b < 2 * KeywordTable::SIZE; b++) {
+            KeywordTable table;
+            table.a = a;
+            table.b = b;
+            bool perfect = true;
+            for (const KeywordEntry& keyword : KEYWORDS) {
+                KeywordEntry& slot = table.slots[KeywordTable::hash(keyword.text, a, b)];
+                if (!slot.text.empty()) { perfect = false; break; }
+                slot = keyword;
+            }
+            if (perfect) return table;
+        }
+    }
+    return KeywordTable {};
+}
+
+inline constexpr KeywordTable KEYWORD_TABLE = buildKeywordTable();
+static_assert(KEYWORD_TABLE.a != 0, "no perfect hash found for the keyword set");
+
+// Returns the keyword's token type, or IDENTIFIER for any other name.
+constexpr TokenType keywordType(std::string_view text) {
+    if (text.size() < KeywordTable::MIN_LENGTH || text.size() > KeywordTable::MAX_LENGTH) return TokenType::IDENTIFIER;
+    const KeywordEntry& slot = KEYWORD_TABLE.slots[KeywordTable::hash(text, KEYWORD_TABLE.a, KEYWORD_TABLE.b)];
+    return slot.text == text ? slot.type : TokenType::IDENTIFIER;
+}
+
+static_assert(keywordType("while") == TokenType::WHILE && keywordType("yield") == TokenType::YIELD);
+static_assert(keywordType("in") == TokenType::IN && keywordType("if") == TokenType::IF);
+static_assert(keywordType("inputs") == TokenType::IDENTIFIER);
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#include "vm.hpp"
+
+// Native modules are shared libraries built against these headers. A module
+// defines its natives with the ordinary NativeFn signature, registers them
+// in an init function and exports it with AXIOM_MODULE:
+//
+//     #include "native_module.hpp"
+//
+//     static bool sum(VM& vm, int argCount, Value* args, Value* result) { ... }
+//     static void init(ModuleRegistry& registry) { registry.add("sum", sum, 1, 1); }
+//     AXIOM_MODULE(init)
+//
+// built with `g++ -std=c++17 -O2 -shared -fPIC -o sum.so sum.cpp` and loaded
+// from a script with `load("./sum.so")`, which defines its natives as
+// globals. A module is loaded once per process and never unloaded.
+//
+// A native's arguments are the caller's own stack slots, passed as a pointer
+// and a count; nothing is boxed or copied on the way in. The collector only
+// runs between instructions, never during a native call, so the views below
+// stay valid until the native returns. There is no interpreter lock to
+// release: a long-running native ties up its own thread and nothing else.
+// Copy out anything kept past the call.
+
+// A borrowed run of values: a list's items, or a native's arguments.
+struct ValueSpan {
+    const Value* data = nullptr;
+    size_t size = 0;
+
+    const Value* begin() const { return data; }
+    const Value* end() const { return data + size; }
+    const Value& operator[](size_t i) const { return data[i]; }
+};
+
+// `value` must be a string or a list respectively.
+inline std::string_view borrowString(Value value) { return asString(value)->view(); }
+inline ValueSpan borrowList(Value value) {
+    const ValueList& items = asList(value)->items;
+    return {items.data(), items.size()};
+}
+inline ValueSpan borrowArgs(int argCount, const Value* args) { return {args, static_cast<size_t>(argCount)}; }
+
+class ModuleRegistry {
+public:
+    explicit ModuleRegistry(VM& vm) : vm(vm) {}
+
+    void add(std::string_view name, NativeFn function, int minArity, int maxArity) {
+        vm.defineNative(name, function, minArity, maxArity);
+    }
+
+    VM& vm;
+};
+
+#ifdef _WIN32
+#define AXIOM_EXPORT extern "C" __declspec(dllexport)
+#else
+#define AXIOM_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+#define AXIOM_MODULE(init)                                                          \
+    AXIOM_EXPORT int axiomModuleAbi() { return NativeModules::BUILD_ABI; }          \
+    AXIOM_EXPORT void axiomModuleInit(ModuleRegistry* registry) { init(*registry); }
+
+class NativeModules {
+public:
+    // Natives share Value, the object layouts and VM with the interpreter,
+    // so a module only loads into the ABI version it was built for. Bump it
+    // whenever any of those change. -DAXIOM_JIT adds fields to ObjFunction
+    // and VM, so JIT builds report a number of their own.
+    static constexpr int ABI = 3;
+#ifdef AXIOM_JIT
+    static constexpr int BUILD_ABI = 1000 + ABI;
+#else
+    static constexpr int BUILD_ABI = ABI;
+#endif
+
+    // Defines `load(path)` in `vm`.
+    static void install(VM& vm) { vm.defineNative("load", loadNative, 1, 1); }
+
+private:
+    using AbiFn = int (*)();
+    using InitFn = void (*)(ModuleRegistry*);
+
+    static bool loadNative(VM& vm, int, Value* args, Value* result) {
+        if (!isString(args[0])) return vm.runtimeError("load() takes a path.");
+        std::string path(borrowString(args[0]));
+#ifdef _WIN32
+        HMODULE handle = LoadLibraryA(path.c_str());
+        if (!handle) return vm.runtimeError("Could not load module '" + path + "'.");
+        auto abi = reinterpret_cast<AbiFn>(GetProcAddress(handle, "axiomModuleAbi"));
+        auto init = reinterpret_cast<InitFn>(GetProcAddress(handle, "axiomModuleInit"));
+#else
+        void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) return vm.runtimeError("Could not load module '" + path + "': " + dlerror());
+        auto abi = reinterpret_cast<AbiFn>(dlsym(handle, "axiomModuleAbi"));
+        auto init = reinterpret_cast<InitFn>(dlsym(handle, "axiomModuleInit"));
+#endif
+        if (!abi || !init) return vm.runtimeError("'" + path + "' is not an Axiom module.");
+        if (abi() != BUILD_ABI) {
+            return vm.runtimeError("Module '" + path + "' was built for ABI " + std::to_string(abi()) +
+                                   ", not " + std::to_string(BUILD_ABI) + ".");
+        }
+        ModuleRegistry registry(vm);
+        init(&registry);
+        *result = Value::none();
+        return true;
+    }
+};
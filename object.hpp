@@ -0,0 +1,864 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "chunk.hpp"
+#include "dict_table.hpp"
+#include "interner.hpp"
+#include "shape.hpp"
+#include "value.hpp"
+#include "value_list.hpp"
+
+enum class ObjType : uint8_t { STRING, FUNCTION, NATIVE, LIST, CLASS, INSTANCE, BOUND_METHOD, INTEGER, DICT, RANGE, GENERATOR };
+
+struct Obj {
+    ObjType type;
+    uint8_t flags = 0;   // generation and collector state, see Heap
+    Obj* next = nullptr; // the old generation's list, or a promoted object's copy
+
+    explicit Obj(ObjType type) : type(type) {}
+};
+
+// Characters are stored inline right after the header, NUL terminated.
+struct ObjString : Obj {
+    uint32_t length;
+    uint32_t hash;
+
+    ObjString(uint32_t length, uint32_t hash) : Obj(ObjType::STRING), length(length), hash(hash) {}
+    char* chars() { return reinterpret_cast<char*>(this + 1); }
+    const char* chars() const { return reinterpret_cast<const char*>(this + 1); }
+    std::string_view view() const { return std::string_view(chars(), length); }
+};
+
+// An int too wide for the 48 bits an inline Value holds. Heap::makeInteger
+// boxes only those, so an ObjInteger never holds a value that fits inline.
+struct ObjInteger : Obj {
+    int64_t value;
+
+    explicit ObjInteger(int64_t value) : Obj(ObjType::INTEGER), value(value) {}
+};
+
+struct ObjClass;
+class JitCode;
+
+struct ObjFunction : Obj {
+    int arity = 0;
+    int slotCount = 1; // slot 0 holds the callee (the receiver in a method), then parameters and locals
+    Chunk chunk;
+    ObjString* name = nullptr;
+    std::vector<InlineCache> caches; // one per property site in the chunk
+    ObjClass* owner = nullptr;       // for methods, the class that last defined it; `super` starts above it
+    bool generator = false;          // has a yield: calling it makes an ObjGenerator instead of running it
+#ifdef AXIOM_JIT
+    const JitCode* jitCode = nullptr; // machine code once hot, owned by the VM
+    uint32_t hotness = 0;             // calls and back-edges so far, or JIT_NEVER
+    static constexpr uint32_t JIT_NEVER = UINT32_MAX; // could not be compiled
+#endif
+
+    ObjFunction() : Obj(ObjType::FUNCTION) {}
+};
+
+class VM;
+// Natives report failures through VM::runtimeError() and return false.
+using NativeFn = bool (*)(VM& vm, int argCount, Value* args, Value* result);
+
+struct ObjNative : Obj {
+    NativeFn function;
+    int minArity;
+    int maxArity;
+    ObjString* name;
+
+    ObjNative(NativeFn function, int minArity, int maxArity, ObjString* name)
+        : Obj(ObjType::NATIVE), function(function), minArity(minArity), maxArity(maxArity), name(name) {}
+};
+
+struct ObjList : Obj {
+    ValueList items;
+
+    ObjList() : Obj(ObjType::LIST) {}
+};
+
+// Keys are none, bools, numbers and strings: values whose hash never
+// changes, even when the collector moves them. See dictGet and dictSet.
+struct ObjDict : Obj {
+    DictTable table;
+
+    ObjDict() : Obj(ObjType::DICT) {}
+};
+
+// Methods are copied down from the superclass when the class is created, so
+// a lookup never walks the chain.
+struct ObjClass : Obj {
+    ObjString* name;
+    ObjClass* superclass = nullptr;
+    Shape* root; // shape of a new instance
+    std::unordered_map<SymbolId, ObjFunction*> methods;
+    ObjFunction* initializer = nullptr; // the `init` method, if any
+
+    ObjClass(ObjString* name, Shape* root) : Obj(ObjType::CLASS), name(name), root(root) {}
+};
+
+// Fields live in a slot array laid out by the shape.
+struct ObjInstance : Obj {
+    ObjClass* klass;
+    Shape* shape;
+    std::vector<Value> fields;
+
+    explicit ObjInstance(ObjClass* klass) : Obj(ObjType::INSTANCE), klass(klass), shape(klass->root) {}
+};
+
+struct ObjBoundMethod : Obj {
+    Value receiver;
+    ObjFunction* method;
+
+    ObjBoundMethod(Value receiver, ObjFunction* method) : Obj(ObjType::BOUND_METHOD), receiver(receiver), method(method) {}
+};
+
+// range(start, stop, step) counts without storing its ints; FOR_ITER,
+// len() and indexing compute each one from the position.
+struct ObjRange : Obj {
+    int64_t start;
+    int64_t stop;
+    int64_t step;   // never 0
+    uint64_t count; // how many ints it yields
+
+    ObjRange(int64_t start, int64_t stop, int64_t step) : Obj(ObjType::RANGE), start(start), stop(stop), step(step) {
+        // Unsigned, so spans wider than INT64_MAX still count right
+        uint64_t span = step > 0 ? uint64_t(stop) - uint64_t(start) : uint64_t(start) - uint64_t(stop);
+        uint64_t stride = step > 0 ? uint64_t(step) : 0 - uint64_t(step);
+        bool empty = step > 0 ? start >= stop : start <= stop;
+        count = empty ? 0 : (span - 1) / stride + 1;
+    }
+    int64_t at(uint64_t position) const { return static_cast<int64_t>(uint64_t(start) + position * uint64_t(step)); }
+};
+
+// A call to a generator function, suspended. `saved` holds its frame's slots
+// between a yield and the next FOR_ITER that resumes it, and is empty while
+// it runs. Generators are born old, like functions, so a frame running one
+// can point at it across collections.
+struct ObjGenerator : Obj {
+    enum class State : uint8_t { SUSPENDED, RUNNING, DONE };
+
+    ObjFunction* function;
+    std::vector<Value> saved;
+    uint32_t resume = 0; // code offset to continue from
+    State state = State::SUSPENDED;
+
+    explicit ObjGenerator(ObjFunction* function) : Obj(ObjType::GENERATOR), function(function) {}
+};
+
+inline bool isObjType(Value value, ObjType type) { return value.isObj() && value.asObj()->type == type; }
+inline bool isString(Value value) { return isObjType(value, ObjType::STRING); }
+inline bool isList(Value value) { return isObjType(value, ObjType::LIST); }
+inline ObjString* asString(Value value) { return static_cast<ObjString*>(value.asObj()); }
+inline ObjFunction* asFunction(Value value) { return static_cast<ObjFunction*>(value.asObj()); }
+inline ObjNative* asNative(Value value) { return static_cast<ObjNative*>(value.asObj()); }
+inline ObjList* asList(Value value) { return static_cast<ObjList*>(value.asObj()); }
+inline bool isDict(Value value) { return isObjType(value, ObjType::DICT); }
+inline ObjDict* asDict(Value value) { return static_cast<ObjDict*>(value.asObj()); }
+inline bool isInstance(Value value) { return isObjType(value, ObjType::INSTANCE); }
+inline ObjClass* asClass(Value value) { return static_cast<ObjClass*>(value.asObj()); }
+inline ObjInstance* asInstance(Value value) { return static_cast<ObjInstance*>(value.asObj()); }
+inline ObjBoundMethod* asBoundMethod(Value value) { return static_cast<ObjBoundMethod*>(value.asObj()); }
+inline bool isRange(Value value) { return isObjType(value, ObjType::RANGE); }
+inline ObjRange* asRange(Value value) { return static_cast<ObjRange*>(value.asObj()); }
+inline bool isGenerator(Value value) { return isObjType(value, ObjType::GENERATOR); }
+inline ObjGenerator* asGenerator(Value value) { return static_cast<ObjGenerator*>(value.asObj()); }
+
+// Ints are 64-bit: inline, or boxed past 48 bits. Use these rather than
+// Value::isInt() and Value::isNumber() wherever a boxed int may turn up.
+inline bool isInteger(Value value) { return value.isInt() || isObjType(value, ObjType::INTEGER); }
+inline int64_t asInteger(Value value) {
+    return value.isInt() ? value.asInt() : static_cast<ObjInteger*>(value.asObj())->value;
+}
+inline bool isNumeric(Value value) { return value.isNumber() || isObjType(value, ObjType::INTEGER); }
+inline double toDouble(Value value) {
+    return value.isObj() ? static_cast<double>(asInteger(value)) : value.asNumber();
+}
+
+// Heap sizes, in bytes.
+struct HeapConfig {
+    size_t nurseryBytes = size_t(1) << 20; // new objects are bump-allocated here
+    size_t heapBytes = size_t(32) << 20;   // old generation size that triggers the first major collection
+};
+
+struct GcStats {
+    uint64_t minorCollections = 0;
+    uint64_t majorCollections = 0;
+    uint64_t promotedBytes = 0; // copied out of the nursery
+    uint64_t freedBytes = 0;    // swept from the old generation
+    size_t oldBytes = 0;        // in the old generation now
+    std::chrono::nanoseconds minorPause {0}; // totals
+    std::chrono::nanoseconds majorPause {0};
+    std::chrono::nanoseconds maxPause {0};
+};
+
+// Owns every heap object. New objects are bump-allocated in a nursery; a
+// minor collection copies the ones still reachable into the old
+// generation, which a major collection marks and sweeps. Old objects never
+// move.
+//
+// Collections only run when the VM asks at a safepoint, where every live
+// reference sits in a root it can rewrite, so code between safepoints may
+// hold raw pointers freely. Storing a reference into an object that may
+// already be old needs writeBarrier().
+//
+// Functions, natives and classes are born old, as is everything made
+// inside a Tenured scope (the compiler and the bytecode cache), so call
+// frames and instruction pointers never see an object move.
+class Heap {
+public:
+    explicit Heap(HeapConfig config = HeapConfig()) : config(config) {
+        this->config.nurseryBytes = std::max<size_t>(align(config.nurseryBytes), 1024);
+        nursery.reset(new char[this->config.nurseryBytes]);
+        nurseryTop = nursery.get();
+        nurseryEnd = nurseryTop + this->config.nurseryBytes;
+        nurseryTrigger = nurseryEnd - this->config.nurseryBytes / 8;
+        largeBytes = this->config.nurseryBytes / 4;
+        majorThreshold = config.heapBytes;
+    }
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    ~Heap() {
+        for (Obj* object : finalizable) destroy(object);
+        while (objects) {
+            Obj* next = objects->next;
+            destroy(objects);
+            objects = next;
+        }
+    }
+
+    // Sends every allocation to the old generation while it lives.
+    class Tenured {
+    public:
+        explicit Tenured(Heap& heap) : heap(heap) { heap.tenuring++; }
+        ~Tenured() { heap.tenuring--; }
+        Tenured(const Tenured&) = delete;
+        Tenured& operator=(const Tenured&) = delete;
+
+    private:
+        Heap& heap;
+    };
+
+    ObjString* makeString(std::string_view text) {
+        ObjString* string = allocateString(static_cast<uint32_t>(text.size()));
+        std::memcpy(string->chars(), text.data(), text.size());
+        string->hash = hashString(text);
+        return string;
+    }
+
+    ObjString* concat(const ObjString* a, const ObjString* b) {
+        ObjString* string = allocateString(a->length + b->length);
+        std::memcpy(string->chars(), a->chars(), a->length);
+        std::memcpy(string->chars() + a->length, b->chars(), b->length);
+        string->hash = hashString(string->view());
+        return string;
+    }
+
+    // A string of `length` bytes that fill(char*) writes in place, so one
+    // built from pieces is allocated once at its final size.
+    template <class Fill>
+    ObjString* buildString(uint32_t length, Fill fill) {
+        ObjString* string = allocateString(length);
+        fill(string->chars());
+        string->hash = hashString(string->view());
+        return string;
+    }
+
+    // `i` inline when it fits, boxed otherwise.
+    Value makeInteger(int64_t i) {
+        if (Value::fitsInt(i)) return Value::integer(i);
+        return Value::object(allocate<ObjInteger>(sizeof(ObjInteger), i));
+    }
+
+    ObjFunction* makeFunction() { return allocateOld<ObjFunction>(sizeof(ObjFunction)); }
+    // Same code, constants and name; its own inline caches, and no owner yet.
+    ObjFunction* copyFunction(const ObjFunction* function) {
+        ObjFunction* copy = makeFunction();
+        copy->arity = function->arity;
+        copy->slotCount = function->slotCount;
+        copy->chunk = function->chunk;
+        copy->name = function->name;
+        copy->caches.resize(function->caches.size());
+        copy->generator = function->generator;
+        return copy;
+    }
+    ObjList* makeList() { return allocate<ObjList>(sizeof(ObjList)); }
+    ObjDict* makeDict() { return allocate<ObjDict>(sizeof(ObjDict)); }
+    ObjNative* makeNative(NativeFn function, int minArity, int maxArity, ObjString* name) {
+        return allocateOld<ObjNative>(sizeof(ObjNative), function, minArity, maxArity, name);
+    }
+    ObjClass* makeClass(ObjString* name) {
+        return allocateOld<ObjClass>(sizeof(ObjClass), name, makeShape(nullptr, Interner::NONE));
+    }
+    ObjInstance* makeInstance(ObjClass* klass) { return allocate<ObjInstance>(sizeof(ObjInstance), klass); }
+    ObjBoundMethod* makeBoundMethod(Value receiver, ObjFunction* method) {
+        return allocate<ObjBoundMethod>(sizeof(ObjBoundMethod), receiver, method);
+    }
+    ObjRange* makeRange(int64_t start, int64_t stop, int64_t step) {
+        return allocate<ObjRange>(sizeof(ObjRange), start, stop, step);
+    }
+    ObjGenerator* makeGenerator(ObjFunction* function) {
+        return allocateOld<ObjGenerator>(sizeof(ObjGenerator), function);
+    }
+
+    // The shape after adding `name` to `shape`, shared with every instance
+    // that took the same step.
+    Shape* addField(Shape* shape, SymbolId name) {
+        return shape->withField(name, [this](const Shape* parent, SymbolId field) { return makeShape(parent, field); });
+    }
+
+    // Call after storing `value` into `owner`. An old object that now points
+    // into the nursery is remembered, and the next minor collection treats
+    // it as a root.
+    void writeBarrier(Obj* owner, Value value) {
+        if ((owner->flags & (OLD | REMEMBERED)) == OLD && value.isObj() && !(value.asObj()->flags & OLD)) remember(owner);
+    }
+    // The same after storing any number of values.
+    void writeBarrier(Obj* owner) {
+        if ((owner->flags & (OLD | REMEMBERED)) == OLD) remember(owner);
+    }
+
+    // True when the VM should collect at its next safepoint.
+    bool needsCollection() const { return nurseryTop >= nurseryTrigger || stats.oldBytes >= majorThreshold; }
+
+    // Empties the nursery, then marks and sweeps the old generation if it
+    // has outgrown its threshold or `major` is set. `roots(visit)` must call
+    // visit on every Value& and object pointer reference outside the heap;
+    // the pointers are rewritten to wherever their objects moved.
+    template <class Roots>
+    void collect(Roots roots, bool major = false) {
+        auto start = std::chrono::steady_clock::now();
+        minorCollection(roots);
+        auto end = std::chrono::steady_clock::now();
+        stats.minorCollections++;
+        stats.minorPause += end - start;
+        stats.maxPause = std::max<std::chrono::nanoseconds>(stats.maxPause, end - start);
+        if (!major && stats.oldBytes < majorThreshold) return;
+
+        start = end;
+        majorCollection(roots);
+        end = std::chrono::steady_clock::now();
+        stats.majorCollections++;
+        stats.majorPause += end - start;
+        stats.maxPause = std::max<std::chrono::nanoseconds>(stats.maxPause, end - start);
+    }
+
+    const GcStats& gcStats() const { return stats; }
+    size_t nurseryUsed() const { return static_cast<size_t>(nurseryTop - nursery.get()); }
+
+private:
+    static constexpr uint8_t OLD = 1;
+    static constexpr uint8_t MARKED = 2;
+    static constexpr uint8_t REMEMBERED = 4;
+    static constexpr uint8_t FORWARDED = 8; // a promoted nursery object; `next` is the copy
+
+    // Calls `update` on every object a slot refers to and stores back what
+    // it returns, so one walk over references serves copying and marking.
+    template <class Update>
+    struct Slots {
+        Update& update;
+
+        void operator()(Value& value) const {
+            if (value.isObj()) value = Value::object(update(value.asObj()));
+        }
+        template <class T>
+        void operator()(T*& object) const {
+            if (object) object = static_cast<T*>(update(object));
+        }
+    };
+
+    HeapConfig config;
+    GcStats stats;
+    std::unique_ptr<char[]> nursery;
+    char* nurseryTop;
+    char* nurseryEnd;
+    char* nurseryTrigger; // past this, needsCollection()
+    size_t largeBytes;    // bigger objects go straight to the old generation
+    size_t majorThreshold;
+    int tenuring = 0;
+    Obj* objects = nullptr;           // the old generation
+    std::vector<Obj*> finalizable;    // nursery objects that own memory of their own
+    std::vector<Obj*> remembered;     // old objects that may point into the nursery
+    std::vector<Obj*> gray;           // promoted or marked, references not yet visited
+    std::vector<std::unique_ptr<Shape>> shapes;
+
+    static size_t align(size_t size) { return (size + 7) & ~size_t(7); }
+
+    Shape* makeShape(const Shape* parent, SymbolId name) {
+        shapes.push_back(std::make_unique<Shape>(parent, name));
+        return shapes.back().get();
+    }
+
+    // The common case is a pointer increment.
+    template <class T, class... Args>
+    T* allocate(size_t size, Args&&... args) {
+        size = align(size);
+        char* memory = nurseryTop;
+        if (tenuring || size > largeBytes || size > static_cast<size_t>(nurseryEnd - memory)) {
+            return allocateOld<T>(size, std::forward<Args>(args)...);
+        }
+        nurseryTop = memory + size;
+        T* object = new (memory) T(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>) finalizable.push_back(object);
+        return object;
+    }
+
+    template <class T, class... Args>
+    T* allocateOld(size_t size, Args&&... args) {
+        T* object = placeOld<T>(align(size), std::forward<Args>(args)...);
+        // Outside a Tenured scope its fields may soon point into the nursery
+        if constexpr (!std::is_same_v<T, ObjString>) {
+            if (!tenuring) remember(object);
+        }
+        return object;
+    }
+
+    template <class T, class... Args>
+    T* placeOld(size_t size, Args&&... args) {
+        T* object = new (::operator new(size)) T(std::forward<Args>(args)...);
+        object->flags = OLD;
+        object->next = objects;
+        objects = object;
+        stats.oldBytes += size;
+        return object;
+    }
+
+    ObjString* allocateString(uint32_t length) {
+        ObjString* string = allocate<ObjString>(sizeof(ObjString) + length + 1, length, 0u);
+        string->chars()[length] = '\0';
+        return string;
+    }
+
+    void remember(Obj* object) {
+        object->flags |= REMEMBERED;
+        remembered.push_back(object);
+    }
+
+    static size_t sizeOf(const Obj* object) {
+        switch (object->type) {
+            case ObjType::STRING: return align(sizeof(ObjString) + static_cast<const ObjString*>(object)->length + 1);
+            case ObjType::FUNCTION: return align(sizeof(ObjFunction));
+            case ObjType::NATIVE: return align(sizeof(ObjNative));
+            case ObjType::LIST: return align(sizeof(ObjList));
+            case ObjType::CLASS: return align(sizeof(ObjClass));
+            case ObjType::INSTANCE: return align(sizeof(ObjInstance));
+            case ObjType::BOUND_METHOD: return align(sizeof(ObjBoundMethod));
+            case ObjType::INTEGER: return align(sizeof(ObjInteger));
+            case ObjType::DICT: return align(sizeof(ObjDict));
+            case ObjType::RANGE: return align(sizeof(ObjRange));
+            case ObjType::GENERATOR: return align(sizeof(ObjGenerator));
+        }
+        return 0;
+    }
+
+    template <class Visit>
+    static void eachReference(Obj* object, const Visit& visit) {
+        switch (object->type) {
+            case ObjType::STRING:
+            case ObjType::INTEGER:
+            case ObjType::RANGE: break;
+            case ObjType::FUNCTION: {
+                auto* function = static_cast<ObjFunction*>(object);
+                visit(function->name);
+                for (Value& constant : function->chunk.constants) visit(constant);
+                visit(function->owner);
+                for (InlineCache& cache : function->caches) {
+                    for (int i = 0; i < cache.used; i++) visit(cache.entries[i].method);
+                }
+                break;
+            }
+            case ObjType::NATIVE: visit(static_cast<ObjNative*>(object)->name); break;
+            case ObjType::LIST:
+                for (Value& item : static_cast<ObjList*>(object)->items) visit(item);
+                break;
+            case ObjType::DICT:
+                for (DictTable::Entry& entry : static_cast<ObjDict*>(object)->table) {
+                    visit(entry.key);
+                    visit(entry.value);
+                }
+                break;
+            case ObjType::CLASS: {
+                auto* klass = static_cast<ObjClass*>(object);
+                visit(klass->name);
+                visit(klass->superclass);
+                for (auto& method : klass->methods) visit(method.second);
+                visit(klass->initializer);
+                break;
+            }
+            case ObjType::INSTANCE: {
+                auto* instance = static_cast<ObjInstance*>(object);
+                visit(instance->klass);
+                for (Value& field : instance->fields) visit(field);
+                break;
+            }
+            case ObjType::BOUND_METHOD: {
+                auto* bound = static_cast<ObjBoundMethod*>(object);
+                visit(bound->receiver);
+                visit(bound->method);
+                break;
+            }
+            case ObjType::GENERATOR: {
+                auto* generator = static_cast<ObjGenerator*>(object);
+                visit(generator->function);
+                for (Value& value : generator->saved) visit(value);
+                break;
+            }
+        }
+    }
+
+    // Copies everything reachable from the roots and the remembered set out
+    // of the nursery, then resets it.
+    template <class Roots>
+    void minorCollection(Roots& roots) {
+        auto evacuate = [this](Obj* object) -> Obj* {
+            if (object->flags & OLD) return object;
+            if (object->flags & FORWARDED) return object->next;
+            Obj* copy = promote(object);
+            object->flags |= FORWARDED;
+            object->next = copy;
+            gray.push_back(copy);
+            return copy;
+        };
+        Slots<decltype(evacuate)> slots {evacuate};
+        roots(slots);
+        for (Obj* object : remembered) {
+            object->flags &= ~REMEMBERED;
+            eachReference(object, slots);
+        }
+        remembered.clear();
+        while (!gray.empty()) {
+            Obj* object = gray.back();
+            gray.pop_back();
+            eachReference(object, slots);
+        }
+        // The dead, and the moved-from originals of the survivors
+        for (Obj* object : finalizable) destroy(object);
+        finalizable.clear();
+        nurseryTop = nursery.get();
+    }
+
+    Obj* promote(Obj* object) {
+        size_t size = sizeOf(object);
+        stats.promotedBytes += size;
+        switch (object->type) {
+            case ObjType::STRING: {
+                auto* string = static_cast<ObjString*>(object);
+                ObjString* copy = placeOld<ObjString>(size, string->length, string->hash);
+                std::memcpy(copy->chars(), string->chars(), string->length + 1);
+                return copy;
+            }
+            case ObjType::LIST: return placeOld<ObjList>(size, std::move(*static_cast<ObjList*>(object)));
+            case ObjType::DICT: return placeOld<ObjDict>(size, std::move(*static_cast<ObjDict*>(object)));
+            case ObjType::INSTANCE: return placeOld<ObjInstance>(size, std::move(*static_cast<ObjInstance*>(object)));
+            case ObjType::BOUND_METHOD: return placeOld<ObjBoundMethod>(size, *static_cast<ObjBoundMethod*>(object));
+            case ObjType::INTEGER: return placeOld<ObjInteger>(size, static_cast<ObjInteger*>(object)->value);
+            case ObjType::RANGE: return placeOld<ObjRange>(size, *static_cast<ObjRange*>(object));
+            default: return object; // the other types are born old
+        }
+    }
+
+    // Runs straight after a minor collection, so every object is old.
+    template <class Roots>
+    void majorCollection(Roots& roots) {
+        auto mark = [this](Obj* object) -> Obj* {
+            if (!(object->flags & MARKED)) {
+                object->flags |= MARKED;
+                gray.push_back(object);
+            }
+            return object;
+        };
+        Slots<decltype(mark)> slots {mark};
+        roots(slots);
+        while (!gray.empty()) {
+            Obj* object = gray.back();
+            gray.pop_back();
+            eachReference(object, slots);
+        }
+
+        for (Obj** link = &objects; *link;) {
+            Obj* object = *link;
+            if (object->flags & MARKED) {
+                object->flags &= ~MARKED;
+                link = &object->next;
+                continue;
+            }
+            *link = object->next;
+            size_t size = sizeOf(object);
+            stats.oldBytes -= size;
+            stats.freedBytes += size;
+            destroy(object);
+        }
+        majorThreshold = std::max(config.heapBytes, stats.oldBytes * 2);
+    }
+
+    static void destroy(Obj* object) {
+        bool old = object->flags & OLD;
+        switch (object->type) {
+            case ObjType::STRING: static_cast<ObjString*>(object)->~ObjString(); break;
+            case ObjType::FUNCTION: static_cast<ObjFunction*>(object)->~ObjFunction(); break;
+            case ObjType::NATIVE: static_cast<ObjNative*>(object)->~ObjNative(); break;
+            case ObjType::LIST: static_cast<ObjList*>(object)->~ObjList(); break;
+            case ObjType::CLASS: static_cast<ObjClass*>(object)->~ObjClass(); break;
+            case ObjType::INSTANCE: static_cast<ObjInstance*>(object)->~ObjInstance(); break;
+            case ObjType::BOUND_METHOD: static_cast<ObjBoundMethod*>(object)->~ObjBoundMethod(); break;
+            case ObjType::INTEGER: break;
+            case ObjType::DICT: static_cast<ObjDict*>(object)->~ObjDict(); break;
+            case ObjType::RANGE: break;
+            case ObjType::GENERATOR: static_cast<ObjGenerator*>(object)->~ObjGenerator(); break;
+        }
+        if (old) ::operator delete(object);
+    }
+};
+
+// Python-style truthiness: none, false, 0, "", [], {} and empty ranges are false. A boxed int
+// is never 0.
+inline bool isFalsey(Value value) {
+    if (value.isNone()) return true;
+    if (value.isBool()) return !value.asBool();
+    if (value.isInt()) return value.asInt() == 0;
+    if (value.isDouble()) return value.asDouble() == 0;
+    if (isString(value)) return asString(value)->length == 0;
+    if (isList(value)) return asList(value)->items.empty();
+    if (isDict(value)) return asDict(value)->table.size() == 0;
+    if (isRange(value)) return asRange(value)->count == 0;
+    return false;
+}
+
+inline bool valuesEqual(Value a, Value b) {
+    if (a.isInt() && b.isInt()) return a.asInt() == b.asInt();
+    if (isInteger(a) && isInteger(b)) return asInteger(a) == asInteger(b);
+    if (isNumeric(a) && isNumeric(b)) return toDouble(a) == toDouble(b); // 1 == 1.0
+    if (isString(a) && isString(b)) return asString(a)->view() == asString(b)->view();
+    return a.same(b);
+}
+
+// ---- dicts --------------------------------------------------------------
+
+inline uint64_t mixHash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return x;
+}
+
+// A key's hash, consistent with valuesEqual: 1 and 1.0 hash alike. Returns
+// false for a key that cannot be hashed. Strings reuse the hash cached in
+// the object.
+inline bool hashValue(Value key, uint64_t* hash) {
+    if (isString(key)) *hash = mixHash(asString(key)->hash);
+    else if (isInteger(key)) *hash = mixHash(static_cast<uint64_t>(asInteger(key)));
+    else if (key.isDouble()) {
+        double d = key.asDouble();
+        if (d == std::trunc(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0) {
+            *hash = mixHash(static_cast<uint64_t>(static_cast<int64_t>(d)));
+        } else {
+            uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            *hash = mixHash(bits);
+        }
+    } else if (key.isNone() || key.isBool()) *hash = mixHash(key.raw());
+    else return false;
+    return true;
+}
+
+// Looks `key` up, storing what it maps to in `value`. Returns false if the
+// key is missing or unhashable.
+inline bool dictGet(ObjDict* dict, Value key, Value* value) {
+    uint64_t hash;
+    if (!hashValue(key, &hash)) return false;
+    DictTable::Entry* entry = dict->table.find(hash, [key](Value other) { return valuesEqual(key, other); });
+    if (!entry) return false;
+    *value = entry->value;
+    return true;
+}
+
+// Maps `key` to `value`; false if the key is unhashable. The caller runs
+// the write barrier.
+inline bool dictSet(ObjDict* dict, Value key, Value value) {
+    uint64_t hash;
+    if (!hashValue(key, &hash)) return false;
+    DictTable::Entry* entry = dict->table.find(hash, [key](Value other) { return valuesEqual(key, other); });
+    if (entry) entry->value = value;
+    else dict->table.insert(hash, key, value);
+    return true;
+}
+
+// ---- arithmetic ---------------------------------------------------------
+// Shared by the VM and the constant folder, so folding at compile time gives
+// exactly what running would.
+
+// 64-bit integer arithmetic. These return false on overflow, and the
+// operation is redone in doubles.
+inline bool addInt(int64_t a, int64_t b, int64_t* result) {
+    if (b > 0 ? a > INT64_MAX - b : a < INT64_MIN - b) return false;
+    *result = a + b;
+    return true;
+}
+inline bool subtractInt(int64_t a, int64_t b, int64_t* result) {
+    if (b < 0 ? a > INT64_MAX + b : a < INT64_MIN + b) return false;
+    *result = a - b;
+    return true;
+}
+inline bool multiplyInt(int64_t a, int64_t b, int64_t* result) {
+    bool overflow = a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a)
+                          : (b > 0 ? a < INT64_MIN / b : a != 0 && b < INT64_MAX / a);
+    if (overflow) return false;
+    *result = a * b;
+    return true;
+}
+
+// ADD, SUBTRACT, MULTIPLY, DIVIDE or MODULO on two numbers. Returns false if
+// an operand is not a number or the divisor is zero. / is always true
+// division and the sign of % follows the divisor, as in Python. An int
+// result too wide to sit inline is boxed on `heap`.
+inline bool numericOp(Heap& heap, OpCode op, Value a, Value b, Value* result) {
+    if (!isNumeric(a) || !isNumeric(b)) return false;
+    bool ints = isInteger(a) && isInteger(b);
+    int64_t x = ints ? asInteger(a) : 0, y = ints ? asInteger(b) : 0, i;
+    switch (op) {
+        case OpCode::ADD:
+            *result = ints && addInt(x, y, &i) ? heap.makeInteger(i) : Value::number(toDouble(a) + toDouble(b));
+            return true;
+        case OpCode::SUBTRACT:
+            *result = ints && subtractInt(x, y, &i) ? heap.makeInteger(i) : Value::number(toDouble(a) - toDouble(b));
+            return true;
+        case OpCode::MULTIPLY:
+            *result = ints && multiplyInt(x, y, &i) ? heap.makeInteger(i) : Value::number(toDouble(a) * toDouble(b));
+            return true;
+        case OpCode::DIVIDE:
+            if (toDouble(b) == 0) return false;
+            *result = Value::number(toDouble(a) / toDouble(b));
+            return true;
+        case OpCode::MODULO:
+            if (toDouble(b) == 0) return false;
+            if (ints) {
+                i = y == -1 ? 0 : x % y; // INT64_MIN % -1 overflows
+                if (i != 0 && (i < 0) != (y < 0)) i += y;
+                *result = heap.makeInteger(i);
+            } else {
+                double d = std::fmod(toDouble(a), toDouble(b));
+                if (d != 0 && (d < 0) != (toDouble(b) < 0)) d += toDouble(b);
+                *result = Value::number(d);
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Unary minus. Returns false if `a` is not a number.
+inline bool negateValue(Heap& heap, Value a, Value* result) {
+    if (isInteger(a) && asInteger(a) != INT64_MIN) *result = heap.makeInteger(-asInteger(a));
+    else if (isNumeric(a)) *result = Value::number(-toDouble(a));
+    else return false;
+    return true;
+}
+
+// EQUAL and NOT_EQUAL on anything; the orderings on two numbers or two
+// strings. Returns false if the operands cannot be ordered.
+inline bool compareValues(OpCode op, Value a, Value b, bool* result) {
+    if (op == OpCode::EQUAL || op == OpCode::NOT_EQUAL) {
+        *result = valuesEqual(a, b) == (op == OpCode::EQUAL);
+        return true;
+    }
+    int order;
+    if (isInteger(a) && isInteger(b)) order = asInteger(a) < asInteger(b) ? -1 : asInteger(a) > asInteger(b);
+    else if (isNumeric(a) && isNumeric(b)) {
+        double x = toDouble(a), y = toDouble(b);
+        if (x != x || y != y) { // NaN is unordered
+            *result = false;
+            return true;
+        }
+        order = x < y ? -1 : x > y;
+    } else if (isString(a) && isString(b)) {
+        int c = asString(a)->view().compare(asString(b)->view());
+        order = c < 0 ? -1 : c > 0;
+    } else {
+        return false;
+    }
+    switch (op) {
+        case OpCode::LESS: *result = order < 0; return true;
+        case OpCode::LESS_EQUAL: *result = order <= 0; return true;
+        case OpCode::GREATER: *result = order > 0; return true;
+        case OpCode::GREATER_EQUAL: *result = order >= 0; return true;
+        default: return false;
+    }
+}
+
+// Integral values print without a fraction; others use the shortest form
+// that reads back to the same double.
+inline std::string formatNumber(double number) {
+    if (std::isnan(number)) return "nan";
+    if (std::isinf(number)) return number < 0 ? "-inf" : "inf";
+    char buffer[32];
+    if (number == std::trunc(number) && std::fabs(number) < 1e16) {
+        std::snprintf(buffer, sizeof(buffer), "%.0f", number);
+        return buffer;
+    }
+    for (int precision = 15; precision <= 17; precision++) {
+        std::snprintf(buffer, sizeof(buffer), "%.*g", precision, number);
+        if (std::strtod(buffer, nullptr) == number) break;
+    }
+    return buffer;
+}
+
+inline std::string valueToString(Value value) {
+    if (value.isNone()) return "none";
+    if (value.isBool()) return value.asBool() ? "true" : "false";
+    if (value.isInt()) return std::to_string(value.asInt());
+    if (value.isDouble()) return formatNumber(value.asDouble());
+    if (value.isEmpty()) return "<empty>";
+
+    switch (value.asObj()->type) {
+        case ObjType::STRING: return std::string(asString(value)->view());
+        case ObjType::FUNCTION: {
+            ObjString* name = asFunction(value)->name;
+            return name ? "<def " + std::string(name->view()) + ">" : "<script>";
+        }
+        case ObjType::NATIVE: return "<native " + std::string(asNative(value)->name->view()) + ">";
+        case ObjType::LIST: {
+            std::string out = "[";
+            const auto& items = asList(value)->items;
+            for (size_t i = 0; i < items.size(); i++) {
+                if (i) out += ", ";
+                out += isString(items[i]) ? "\"" + valueToString(items[i]) + "\"" : valueToString(items[i]);
+            }
+            return out + "]";
+        }
+        case ObjType::CLASS: return "<class " + std::string(asClass(value)->name->view()) + ">";
+        case ObjType::INSTANCE: return "<" + std::string(asInstance(value)->klass->name->view()) + " instance>";
+        case ObjType::BOUND_METHOD: return "<def " + std::string(asBoundMethod(value)->method->name->view()) + ">";
+        case ObjType::INTEGER: return std::to_string(asInteger(value));
+        case ObjType::DICT: {
+            std::string out = "{";
+            for (const DictTable::Entry& entry : asDict(value)->table) {
+                if (out.size() > 1) out += ", ";
+                out += isString(entry.key) ? "\"" + valueToString(entry.key) + "\"" : valueToString(entry.key);
+                out += ": ";
+                out += isString(entry.value) ? "\"" + valueToString(entry.value) + "\"" : valueToString(entry.value);
+            }
+            return out + "}";
+        }
+        case ObjType::RANGE: {
+            const ObjRange* range = asRange(value);
+            std::string out = "range(" + std::to_string(range->start) + ", " + std::to_string(range->stop);
+            return range->step == 1 ? out + ")" : out + ", " + std::to_string(range->step) + ")";
+        }
+        case ObjType::GENERATOR: return "<generator " + std::string(asGenerator(value)->function->name->view()) + ">";
+    }
+    return "<?>";
+}
@@ -0,0 +1,578 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "chunk.hpp"
+#include "object.hpp"
+
+// Instruction counts across every function the optimizer has seen.
+struct OptimizerStats {
+    size_t before = 0;
+    size_t after = 0;
+    size_t folded = 0;            // constant expressions evaluated at compile time
+    size_t deadBranches = 0;      // conditional jumps on a constant
+    size_t removed = 0;           // unreachable or no-op instructions dropped
+    size_t increments = 0;        // x += k rewritten to INC_LOCAL / INC_GLOBAL
+    size_t fusedJumps = 0;        // compare + JUMP_IF_FALSE rewritten to JUMP_UNLESS
+    size_t superinstructions = 0; // common sequences merged into one instruction
+};
+
+// Rewrites a compiled function's bytecode in place. The code is decoded into
+// a list of instructions whose jumps point at instruction indexes, rewritten
+// until nothing changes, and encoded again.
+//
+// Rewrites are peepholes: instructions are copied to an output list one at a
+// time, and whenever the tail of that list matches a pattern it is replaced
+// with something shorter that leaves the stack the same. A tail is never
+// rewritten if anything jumps into the middle of it, so every path sees
+// either all of the old code or all of the new. Anything that would fail at
+// runtime is left for the VM to report.
+class Optimizer {
+public:
+    Optimizer(Heap& heap, OptimizerStats& stats) : heap(heap), stats(stats) {}
+
+    void optimize(ObjFunction* function) {
+        Chunk& chunk = function->chunk;
+        if (!decode(chunk)) return;
+        size_t before = code.size();
+
+        // A rewrite pass reaches its own fixed point, but dropping dead code
+        // can line up new patterns.
+        rewrite(chunk, &Optimizer::simplify);
+        while (removeUnreachable() && rewrite(chunk, &Optimizer::simplify)) {}
+        // Last, since the rewrites look for the instructions these replace
+        rewrite(chunk, &Optimizer::superinstruction);
+
+        if (!encode(chunk)) return; // keep the original if the rewrite no longer fits
+        stats.before += before;
+        stats.after += code.size();
+    }
+
+private:
+    struct Instruction {
+        OpCode op;
+        int8_t extra = 0;      // INC_* delta
+        bool entered = false;  // something jumps here
+        uint8_t rest[3] = {};  // operand bytes after a constant index, copied as they are
+        int operand = 0;       // constant index, slot, count or comparison
+        int target = -1;       // jump destination as an instruction index
+        int line = 0;
+        int origin = 0;        // index before the current rewrite
+    };
+
+    Heap& heap;
+    OptimizerStats& stats;
+    std::vector<Instruction> code;
+    std::vector<Instruction> rewritten; // what a pass builds, then swapped with code
+    bool enteredNext = false;           // a removed jump target hands its mark to the next instruction
+
+    static bool isJump(OpCode op) {
+        return op == OpCode::JUMP || op == OpCode::JUMP_IF_FALSE || op == OpCode::JUMP_UNLESS ||
+               op == OpCode::LOOP || op == OpCode::FOR_ITER;
+    }
+
+    static bool isComparison(OpCode op) {
+        return op >= OpCode::EQUAL && op <= OpCode::LESS_EQUAL;
+    }
+
+    // ---- decoding and encoding ---------------------------------------------
+
+    bool decode(const Chunk& chunk) {
+        code.clear();
+        code.reserve(chunk.code.size() / 2);
+        std::vector<int> indexAt(chunk.code.size(), -1);
+        size_t run = 0;
+        for (size_t ip = 0; ip < chunk.code.size();) {
+            while (run + 1 < chunk.lines.size() && chunk.lines[run + 1].offset <= ip) run++;
+            OpCode op = static_cast<OpCode>(chunk.code[ip]);
+            const uint8_t* operand = chunk.code.data() + ip + 1;
+            size_t next = ip + 1 + operandBytes(op);
+            indexAt[ip] = static_cast<int>(code.size());
+            Instruction instruction;
+            instruction.op = op;
+            instruction.line = chunk.lines.empty() ? 0 : chunk.lines[run].line;
+            long target = -1; // a byte offset until every index is known
+            if (hasConstantOperand(op)) {
+                instruction.operand = (operand[0] << 8) | operand[1];
+                std::memcpy(instruction.rest, operand + 2, operandBytes(op) - 2);
+            }
+            switch (op) {
+                case OpCode::GET_GLOBAL: case OpCode::SET_GLOBAL:
+                    instruction.operand = (operand[0] << 8) | operand[1];
+                    break;
+                case OpCode::INC_GLOBAL:
+                    instruction.operand = (operand[0] << 8) | operand[1];
+                    instruction.extra = static_cast<int8_t>(operand[2]);
+                    break;
+                case OpCode::INC_LOCAL:
+                    instruction.operand = operand[0];
+                    instruction.extra = static_cast<int8_t>(operand[1]);
+                    break;
+                case OpCode::GET_LOCALS:
+                    instruction.operand = operand[0];
+                    instruction.rest[0] = operand[1];
+                    break;
+                case OpCode::JUMP: case OpCode::JUMP_IF_FALSE:
+                    target = static_cast<long>(next) + ((operand[0] << 8) | operand[1]);
+                    break;
+                case OpCode::JUMP_UNLESS:
+                    target = static_cast<long>(next) + ((operand[0] << 8) | operand[1]);
+                    instruction.operand = operand[2];
+                    break;
+                case OpCode::LOOP:
+                    target = static_cast<long>(next) - ((operand[0] << 8) | operand[1]);
+                    break;
+                case OpCode::FOR_ITER:
+                    instruction.operand = operand[0];
+                    target = static_cast<long>(next) + ((operand[1] << 8) | operand[2]);
+                    break;
+                default:
+                    if (operandBytes(op) == 1) instruction.operand = operand[0];
+                    break;
+            }
+            if (target >= static_cast<long>(chunk.code.size()) || (isJump(op) && target < 0)) return false;
+            instruction.target = static_cast<int>(target);
+            code.push_back(instruction);
+            ip = next;
+        }
+        for (Instruction& instruction : code) {
+            if (instruction.target < 0) continue;
+            if (indexAt[instruction.target] < 0) return false;
+            instruction.target = indexAt[instruction.target];
+        }
+        return !code.empty() && code.back().op == OpCode::RETURN;
+    }
+
+    bool encode(Chunk& chunk) {
+        std::vector<size_t> offsets(code.size());
+        size_t size = 0;
+        for (size_t i = 0; i < code.size(); i++) {
+            offsets[i] = size;
+            size += 1 + operandBytes(code[i].op);
+        }
+
+        // Keep only the constants still referenced, shared by value
+        std::vector<Value> constants;
+        std::unordered_map<uint64_t, int> byValue;
+        std::unordered_map<std::string_view, int> byText;
+        for (Instruction& instruction : code) {
+            if (!hasConstantOperand(instruction.op)) continue;
+            Value value = chunk.constants[instruction.operand];
+            int next = static_cast<int>(constants.size());
+            int index = isString(value) ? byText.try_emplace(asString(value)->view(), next).first->second
+                                        : byValue.try_emplace(value.raw(), next).first->second;
+            if (index == next) constants.push_back(value);
+            instruction.operand = index;
+        }
+        if (constants.size() > UINT16_MAX + 1) return false;
+
+        std::vector<uint8_t> bytes;
+        std::vector<Chunk::LineRun> lines;
+        bytes.reserve(size);
+        for (size_t i = 0; i < code.size(); i++) {
+            const Instruction& instruction = code[i];
+            if (lines.empty() || lines.back().line != instruction.line) {
+                lines.push_back({static_cast<uint32_t>(bytes.size()), instruction.line});
+            }
+            long next = static_cast<long>(offsets[i] + 1 + operandBytes(instruction.op));
+            long jump = 0;
+            if (isJump(instruction.op)) {
+                long target = static_cast<long>(offsets[instruction.target]);
+                jump = instruction.op == OpCode::LOOP ? next - target : target - next;
+                if (jump < 0 || jump > UINT16_MAX) return false;
+            }
+            bytes.push_back(static_cast<uint8_t>(instruction.op));
+            if (hasConstantOperand(instruction.op)) {
+                putShort(bytes, instruction.operand);
+                bytes.insert(bytes.end(), instruction.rest, instruction.rest + operandBytes(instruction.op) - 2);
+                continue;
+            }
+            switch (instruction.op) {
+                case OpCode::GET_GLOBAL: case OpCode::SET_GLOBAL:
+                    putShort(bytes, instruction.operand);
+                    break;
+                case OpCode::INC_GLOBAL:
+                    putShort(bytes, instruction.operand);
+                    bytes.push_back(static_cast<uint8_t>(instruction.extra));
+                    break;
+                case OpCode::INC_LOCAL:
+                    bytes.push_back(static_cast<uint8_t>(instruction.operand));
+                    bytes.push_back(static_cast<uint8_t>(instruction.extra));
+                    break;
+                case OpCode::GET_LOCALS:
+                    bytes.push_back(static_cast<uint8_t>(instruction.operand));
+                    bytes.push_back(instruction.rest[0]);
+                    break;
+                case OpCode::JUMP: case OpCode::JUMP_IF_FALSE: case OpCode::LOOP:
+                    putShort(bytes, static_cast<int>(jump));
+                    break;
+                case OpCode::JUMP_UNLESS:
+                    putShort(bytes, static_cast<int>(jump));
+                    bytes.push_back(static_cast<uint8_t>(instruction.operand));
+                    break;
+                case OpCode::FOR_ITER:
+                    bytes.push_back(static_cast<uint8_t>(instruction.operand));
+                    putShort(bytes, static_cast<int>(jump));
+                    break;
+                default:
+                    if (operandBytes(instruction.op) == 1) bytes.push_back(static_cast<uint8_t>(instruction.operand));
+                    break;
+            }
+        }
+        chunk.code = std::move(bytes);
+        chunk.lines = std::move(lines);
+        chunk.constants = std::move(constants);
+        return true;
+    }
+
+    static void putShort(std::vector<uint8_t>& bytes, int value) {
+        bytes.push_back(static_cast<uint8_t>(value >> 8));
+        bytes.push_back(static_cast<uint8_t>(value & 0xff));
+    }
+
+    // Makes `rewritten` the code. Each instruction there remembers the index it
+    // came from; a jump to an instruction that is gone moves on to the next
+    // one kept, which is where execution would have continued anyway.
+    void replaceCode() {
+        std::vector<Instruction>& kept = rewritten;
+        std::vector<int> newIndex(code.size(), -1);
+        for (size_t i = 0; i < kept.size(); i++) newIndex[kept[i].origin] = static_cast<int>(i);
+        int next = static_cast<int>(kept.size());
+        for (size_t i = code.size(); i-- > 0;) {
+            if (newIndex[i] >= 0) next = newIndex[i];
+            else newIndex[i] = next;
+        }
+        for (Instruction& instruction : kept) {
+            if (instruction.target >= 0) instruction.target = newIndex[instruction.target];
+        }
+        code.swap(kept);
+    }
+
+    // ---- peephole rewriting ------------------------------------------------
+
+    using Step = bool (Optimizer::*)(Chunk&, std::vector<Instruction>&);
+
+    bool rewrite(Chunk& chunk, Step step) {
+        std::vector<char> entered(code.size(), false);
+        for (const Instruction& instruction : code) {
+            if (instruction.target >= 0) entered[instruction.target] = true;
+        }
+        std::vector<Instruction>& out = rewritten;
+        out.clear();
+        bool changed = false;
+        enteredNext = false;
+        for (size_t i = 0; i < code.size(); i++) {
+            out.push_back(code[i]);
+            out.back().origin = static_cast<int>(i);
+            out.back().entered = entered[i] || enteredNext;
+            enteredNext = false;
+            while ((this->*step)(chunk, out)) changed = true;
+        }
+        replaceCode();
+        return changed;
+    }
+
+    // True if the last n instructions exist and nothing jumps into them past
+    // the first, so they can be replaced as a whole.
+    static bool tail(const std::vector<Instruction>& out, size_t n) {
+        if (out.size() < n) return false;
+        for (size_t i = out.size() - n + 1; i < out.size(); i++) {
+            if (out[i].entered) return false;
+        }
+        return true;
+    }
+
+    // Replaces the last n instructions with `replacement`, which takes over
+    // the first one's place so jumps to it still land.
+    static void replaceTail(std::vector<Instruction>& out, size_t n, Instruction replacement) {
+        Instruction& first = out[out.size() - n];
+        replacement.origin = first.origin;
+        replacement.entered = first.entered;
+        out.resize(out.size() - n);
+        out.push_back(replacement);
+    }
+
+    bool simplify(Chunk& chunk, std::vector<Instruction>& out) {
+        // Dropping a pushed value and its POP can empty the output.
+        if (out.empty()) return false;
+        size_t n = out.size();
+        const Instruction& last = out.back();
+        Value a, b, result;
+
+        // Constant expressions: operands that are all constants are
+        // evaluated now, so chains like 60 * 60 * 24 collapse one by one.
+        if (tail(out, 2) && constant(chunk, out[n - 2], &a) && evaluate(last.op, a, &result)) {
+            replaceTail(out, 2, load(chunk, result, last.line));
+            stats.folded++;
+            return true;
+        }
+        if (tail(out, 3) && constant(chunk, out[n - 3], &a) && constant(chunk, out[n - 2], &b) &&
+            evaluate(last.op, a, b, &result)) {
+            replaceTail(out, 3, load(chunk, result, last.line));
+            stats.folded++;
+            return true;
+        }
+
+        if (last.op == OpCode::BUILD_STRING && joinConstants(chunk, out)) {
+            stats.folded++;
+            return true;
+        }
+
+        // A constant before JUMP_IF_FALSE decides the branch now. The
+        // condition stays on the stack, and if the jump lands on the POP that
+        // drops it both the constant and that POP can go.
+        if (last.op == OpCode::JUMP_IF_FALSE && tail(out, 2) && constant(chunk, out[n - 2], &a)) {
+            Instruction jump = last;
+            if (!isFalsey(a)) {
+                out.pop_back();
+            } else if (code[jump.target].op == OpCode::POP) {
+                jump.op = OpCode::JUMP;
+                jump.target++;
+                replaceTail(out, 2, jump);
+            } else {
+                out.back().op = OpCode::JUMP;
+            }
+            stats.deadBranches++;
+            return true;
+        }
+
+        // Values pushed only to be popped
+        if (last.op == OpCode::POP && tail(out, 2)) {
+            OpCode op = out[n - 2].op;
+            if (op == OpCode::CONSTANT || op == OpCode::NONE || op == OpCode::TRUE || op == OpCode::FALSE ||
+                op == OpCode::GET_LOCAL || op == OpCode::DUP) {
+                // Jumps to the removed pair now land on whatever follows
+                if (out[n - 2].entered) enteredNext = true;
+                out.resize(n - 2);
+                stats.removed += 2;
+                return true;
+            }
+        }
+
+        // x = ...; x  ->  the value is still on the stack
+        if (last.op == OpCode::GET_LOCAL && tail(out, 3) && out[n - 2].op == OpCode::POP &&
+            out[n - 3].op == OpCode::SET_LOCAL && out[n - 3].operand == last.operand) {
+            out.resize(n - 2);
+            stats.removed += 2;
+            return true;
+        }
+
+        if (last.op == OpCode::POP && increment(chunk, out)) return true;
+
+        // compare; JUMP_IF_FALSE L; POP ... L: POP  ->  JUMP_UNLESS compare, L+1
+        if (last.op == OpCode::POP && tail(out, 3) && isComparison(out[n - 3].op) &&
+            out[n - 2].op == OpCode::JUMP_IF_FALSE && code[out[n - 2].target].op == OpCode::POP) {
+            Instruction fused = out[n - 2];
+            fused.op = OpCode::JUMP_UNLESS;
+            fused.operand = static_cast<int>(out[n - 3].op);
+            fused.target++;
+            fused.line = out[n - 3].line;
+            replaceTail(out, 3, fused);
+            stats.fusedJumps++;
+            return true;
+        }
+        return false;
+    }
+
+    // Merges the sequences that run most often into one instruction each, to
+    // save their dispatches:
+    //   SET_LOCAL x; POP                  ->  STORE_LOCAL x
+    //   GET_LOCAL x; GET_LOCAL y          ->  GET_LOCALS x y
+    //   GET_LOCAL x; CONSTANT k; op       ->  LOCAL_OP_CONSTANT k x op
+    // for op one of + - * %. A GET_LOCALS already merged gives up its second
+    // local for the last, which saves more.
+    bool superinstruction(Chunk& chunk, std::vector<Instruction>& out) {
+        size_t n = out.size();
+        const Instruction& last = out.back();
+        if (last.op == OpCode::POP && tail(out, 2) && out[n - 2].op == OpCode::SET_LOCAL) {
+            Instruction store = out[n - 2];
+            store.op = OpCode::STORE_LOCAL;
+            replaceTail(out, 2, store);
+            stats.superinstructions++;
+            return true;
+        }
+        if (last.op == OpCode::GET_LOCAL && tail(out, 2) && out[n - 2].op == OpCode::GET_LOCAL) {
+            Instruction pair = out[n - 2];
+            pair.op = OpCode::GET_LOCALS;
+            pair.rest[0] = static_cast<uint8_t>(last.operand);
+            replaceTail(out, 2, pair);
+            stats.superinstructions++;
+            return true;
+        }
+        if ((last.op == OpCode::ADD || last.op == OpCode::SUBTRACT || last.op == OpCode::MULTIPLY ||
+             last.op == OpCode::MODULO) &&
+            tail(out, 3) && out[n - 2].op == OpCode::CONSTANT && chunk.constants[out[n - 2].operand].isInt()) {
+            const Instruction& local = out[n - 3];
+            if (local.op != OpCode::GET_LOCAL && local.op != OpCode::GET_LOCALS) return false;
+            Instruction fused = out[n - 2];
+            fused.op = OpCode::LOCAL_OP_CONSTANT;
+            fused.rest[0] = static_cast<uint8_t>(local.op == OpCode::GET_LOCAL ? local.operand : local.rest[0]);
+            fused.rest[1] = static_cast<uint8_t>(last.op);
+            fused.line = last.line;
+            if (local.op == OpCode::GET_LOCAL) {
+                replaceTail(out, 3, fused);
+            } else {
+                // The fused instruction keeps the constant's place, which
+                // nothing jumps to
+                out.resize(n - 1);
+                out[n - 3].op = OpCode::GET_LOCAL;
+                out[n - 2] = fused;
+            }
+            stats.superinstructions++;
+            return true;
+        }
+        return false;
+    }
+
+    // x += k, x -= k, ++x and x++ as statements, for a small integer k:
+    //   GET x; CONSTANT k; ADD; SET x; POP
+    //   GET x; DUP; CONSTANT k; ADD; SET x; POP; POP
+    // The sign of the delta remembers ADD vs SUBTRACT for error messages.
+    bool increment(const Chunk& chunk, std::vector<Instruction>& out) {
+        size_t n = out.size();
+        bool postfix = n >= 2 && out[n - 2].op == OpCode::POP;
+        size_t length = postfix ? 7 : 5;
+        if (!tail(out, length)) return false;
+        const Instruction* run = &out[n - length];
+        OpCode get = run[0].op;
+        OpCode set = get == OpCode::GET_LOCAL ? OpCode::SET_LOCAL : OpCode::SET_GLOBAL;
+        size_t k = postfix ? 2 : 1;
+        if ((get != OpCode::GET_LOCAL && get != OpCode::GET_GLOBAL) || (postfix && run[1].op != OpCode::DUP) ||
+            run[k].op != OpCode::CONSTANT || run[k + 2].op != set || run[k + 2].operand != run[0].operand) {
+            return false;
+        }
+        OpCode op = run[k + 1].op;
+        Value amount = chunk.constants[run[k].operand];
+        if ((op != OpCode::ADD && op != OpCode::SUBTRACT) || !amount.isInt() || amount.asInt() < 1 ||
+            amount.asInt() > 127) {
+            return false;
+        }
+        Instruction replacement = run[0];
+        replacement.op = get == OpCode::GET_LOCAL ? OpCode::INC_LOCAL : OpCode::INC_GLOBAL;
+        replacement.extra = static_cast<int8_t>(op == OpCode::ADD ? amount.asInt() : -amount.asInt());
+        replacement.line = run[k + 1].line;
+        replaceTail(out, length, replacement);
+        stats.increments++;
+        return true;
+    }
+
+    // Constant pieces at the end of a BUILD_STRING are joined into one, and
+    // if every piece is constant the whole string is.
+    bool joinConstants(Chunk& chunk, std::vector<Instruction>& out) {
+        size_t n = out.size();
+        int count = out.back().operand;
+        int k = 0;
+        Value piece;
+        while (k < count && tail(out, k + 2) && constant(chunk, out[n - 2 - k], &piece)) k++;
+        if (k < 2 && k < count) return false;
+        std::string text;
+        for (size_t i = n - 1 - k; i < n - 1; i++) {
+            constant(chunk, out[i], &piece);
+            text += isString(piece) ? std::string(asString(piece)->view()) : valueToString(piece);
+        }
+        Instruction build = out.back();
+        replaceTail(out, k + 1, load(chunk, Value::object(heap.makeString(text)), build.line));
+        if (k < count) {
+            build.operand = count - k + 1;
+            out.push_back(build);
+        }
+        return true;
+    }
+
+    // ---- constants ---------------------------------------------------------
+
+    // The value an instruction pushes, if it is a constant that compares and
+    // prints the same at compile time as at runtime.
+    static bool constant(const Chunk& chunk, const Instruction& instruction, Value* value) {
+        switch (instruction.op) {
+            case OpCode::NONE: *value = Value::none(); return true;
+            case OpCode::TRUE: *value = Value::boolean(true); return true;
+            case OpCode::FALSE: *value = Value::boolean(false); return true;
+            case OpCode::CONSTANT:
+                *value = chunk.constants[instruction.operand];
+                return isNumeric(*value) || isString(*value);
+            default:
+                return false;
+        }
+    }
+
+    static Instruction load(Chunk& chunk, Value value, int line) {
+        Instruction instruction;
+        instruction.line = line;
+        if (value.isBool()) {
+            instruction.op = value.asBool() ? OpCode::TRUE : OpCode::FALSE;
+        } else if (value.isNone()) {
+            instruction.op = OpCode::NONE;
+        } else {
+            instruction.op = OpCode::CONSTANT;
+            instruction.operand = chunk.addConstant(value);
+        }
+        return instruction;
+    }
+
+    // Evaluates `op` on constant operands, or returns false to leave it for
+    // the VM (an error, or not something to evaluate).
+    bool evaluate(OpCode op, Value a, Value b, Value* result) {
+        if (isComparison(op)) {
+            bool outcome;
+            if (!compareValues(op, a, b, &outcome)) return false;
+            *result = Value::boolean(outcome);
+            return true;
+        }
+        if (op == OpCode::ADD && isString(a) && isString(b)) {
+            *result = Value::object(heap.concat(asString(a), asString(b)));
+            return true;
+        }
+        return numericOp(heap, op, a, b, result);
+    }
+
+    bool evaluate(OpCode op, Value a, Value* result) {
+        switch (op) {
+            case OpCode::NOT:
+                *result = Value::boolean(isFalsey(a));
+                return true;
+            case OpCode::NEGATE: return negateValue(heap, a, result);
+            default:
+                return false;
+        }
+    }
+
+    // ---- control flow ------------------------------------------------------
+
+    // Drops whatever no path reaches, and jumps to the very next
+    // instruction. The final RETURN always stays so the chunk still ends in
+    // one.
+    bool removeUnreachable() {
+        std::vector<bool> reached(code.size(), false);
+        std::vector<size_t> work {0};
+        while (!work.empty()) {
+            size_t i = work.back();
+            work.pop_back();
+            if (i >= code.size() || reached[i]) continue;
+            reached[i] = true;
+            OpCode op = code[i].op;
+            if (code[i].target >= 0) work.push_back(code[i].target);
+            if (op != OpCode::JUMP && op != OpCode::LOOP && op != OpCode::RETURN) work.push_back(i + 1);
+        }
+        reached.back() = true;
+
+        bool any = false;
+        for (size_t i = 0; i < code.size() && !any; i++) {
+            any = !reached[i] || (code[i].op == OpCode::JUMP && code[i].target == static_cast<int>(i + 1));
+        }
+        if (!any) return false;
+
+        std::vector<Instruction>& kept = rewritten;
+        kept.clear();
+        for (size_t i = 0; i < code.size(); i++) {
+            bool skip = code[i].op == OpCode::JUMP && code[i].target == static_cast<int>(i + 1);
+            if (!reached[i] || skip) continue;
+            kept.push_back(code[i]);
+            kept.back().origin = static_cast<int>(i);
+        }
+        stats.removed += code.size() - kept.size();
+        replaceCode();
+        return true;
+    }
+};
@@ -0,0 +1,199 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "scanner.hpp"
+
+// Lexes large sources on several threads and produces exactly the tokens the
+// sequential Scanner would.
+//
+// The source is cut into chunks just after a '\n'. Each chunk is scanned
+// speculatively as if it started at the beginning of a line outside any
+// string; its indentation is recorded as IndentMarks instead of being
+// resolved. The stitch pass then walks the chunks in order:
+//   - a chunk whose predecessor did not stop cleanly on its boundary (a
+//     multi-line string or an f-string ran across it) is discarded and the
+//     predecessor's scanner simply continues through it;
+//   - indent marks are replayed against the real indent stack, line numbers
+//     are rebased, and the INDENT/DEDENT tokens are spliced in.
+// Any scan error sends the whole file through the sequential scanner so
+// error reports come out exactly as before.
+class ParallelScanner {
+public:
+    static constexpr size_t DEFAULT_MIN_CHUNK = 1 << 20;
+
+    explicit ParallelScanner(std::string_view source,
+                             unsigned threads = std::thread::hardware_concurrency(),
+                             size_t minChunk = DEFAULT_MIN_CHUNK, ErrorSink* errors = nullptr)
+        : source(source), threads(std::max(1u, threads)), minChunk(std::max<size_t>(1, minChunk)), errors(errors) {}
+
+    TokenList scanTokens() {
+        if (threads < 2 || source.size() < 2 * minChunk) return Scanner(source, 1, nullptr, errors).scanTokens();
+
+        splitChunks();
+        runParallel([this](size_t i) { scanChunk(i); });
+
+        if (!resolveSpills() || !replayIndentation()) return Scanner(source, 1, nullptr, errors).scanTokens();
+
+        TokenList result;
+        result.source = source;
+        result.tokens.resize(totalTokens, Token(TokenType::EOF_, 0, 0, Token::NO_LITERAL, 0));
+        result.literals.resize(totalLiterals);
+        runParallel([this, &result](size_t i) { copyChunk(i, result); });
+
+        // Pop remaining indents, exactly as Scanner::nextToken() does at the end
+        uint32_t end = static_cast<uint32_t>(source.size());
+        for (size_t i = 1; i < indentLevels.size(); i++) {
+            result.tokens.emplace_back(TokenType::DEDENT, end, 0, Token::NO_LITERAL, finalLine);
+        }
+        result.tokens.emplace_back(TokenType::EOF_, end, 0, Token::NO_LITERAL, finalLine);
+        return result;
+    }
+
+private:
+    struct Chunk {
+        Chunk(int begin, int end) : begin(begin), end(end) {}
+
+        int begin;
+        int end;
+        std::unique_ptr<Scanner> scanner;
+        std::vector<Token> tokens;
+        std::vector<Literal> literals;
+        std::vector<Scanner::IndentMark> marks;
+        bool absorbed = false; // rescanned by an earlier chunk's scanner
+
+        // Filled in by the stitch pass
+        int lineBase = 0;              // added to chunk-relative line numbers
+        size_t tokenBase = 0;
+        size_t literalBase = 0;
+        std::vector<std::pair<uint32_t, Token>> indentTokens; // (insert before, token)
+    };
+
+    std::string_view source;
+    unsigned threads;
+    size_t minChunk;
+    ErrorSink* errors;
+    std::vector<Chunk> chunks;
+    std::vector<int> indentLevels {0};
+    size_t totalTokens = 0;
+    size_t totalLiterals = 0;
+    int finalLine = 1;
+
+    void splitChunks() {
+        size_t count = std::min<size_t>(threads * 4, source.size() / minChunk);
+        int begin = 0;
+        for (size_t i = 1; i <= count && begin < static_cast<int>(source.size()); i++) {
+            size_t target = (i == count) ? source.size() : source.size() * i / count;
+            int end = static_cast<int>(source.size());
+            if (target < source.size()) {
+                const void* nl = std::memchr(source.data() + target, '\n', source.size() - target);
+                if (nl) end = static_cast<int>(static_cast<const char*>(nl) - source.data()) + 1;
+            }
+            if (end <= begin) continue;
+            chunks.emplace_back(begin, end);
+            begin = end;
+        }
+    }
+
+    template <class F>
+    void runParallel(F&& body) {
+        std::atomic<size_t> next {0};
+        auto worker = [&] {
+            for (size_t i = next++; i < chunks.size(); i = next++) body(i);
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < std::min<size_t>(threads, chunks.size()); t++) pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool) thread.join();
+    }
+
+    void scanChunk(size_t i) {
+        Chunk& chunk = chunks[i];
+        chunk.scanner = std::make_unique<Scanner>(source);
+        Scanner& scanner = *chunk.scanner;
+        scanner.current = chunk.begin;
+        scanner.speculative = true;
+        scanner.indentMarks = &chunk.marks;
+        scanner.scanChunk(chunk.end, chunk.tokens, chunk.literals);
+    }
+
+    // The next chunk's speculative scan is valid only if this scanner stopped
+    // exactly on the boundary, at a line start, outside any f-string.
+    static bool stoppedClean(const Scanner& scanner, int boundary) {
+        return scanner.current == boundary && scanner.atLineStart && scanner.fStrings.empty();
+    }
+
+    bool resolveSpills() {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (chunks[i].absorbed) continue;
+            Chunk& chunk = chunks[i];
+            size_t next = i + 1;
+            while (next < chunks.size() && !stoppedClean(*chunk.scanner, chunks[next].begin)) {
+                // Keep going with this scanner and throw away the next chunk's guess
+                chunks[next].absorbed = true;
+                chunk.end = chunks[next].end;
+                chunk.scanner->scanChunk(chunk.end, chunk.tokens, chunk.literals);
+                next++;
+            }
+            if (chunk.scanner->failed) return false;
+        }
+        return true;
+    }
+
+    bool replayIndentation() {
+        int lineBase = 0;
+        for (Chunk& chunk : chunks) {
+            if (chunk.absorbed) continue;
+            chunk.lineBase = lineBase;
+            chunk.tokenBase = totalTokens;
+            chunk.literalBase = totalLiterals;
+
+            for (const Scanner::IndentMark& mark : chunk.marks) {
+                Token token(TokenType::INDENT, mark.offset, mark.length, Token::NO_LITERAL, mark.line + lineBase);
+                if (mark.indent > indentLevels.back()) {
+                    indentLevels.push_back(mark.indent);
+                    chunk.indentTokens.emplace_back(mark.token, token);
+                } else if (mark.indent < indentLevels.back()) {
+                    token.type = TokenType::DEDENT;
+                    while (indentLevels.size() > 1 && mark.indent < indentLevels.back()) {
+                        indentLevels.pop_back();
+                        chunk.indentTokens.emplace_back(mark.token, token);
+                    }
+                    if (mark.indent != indentLevels.back()) return false; // let the sequential scanner report it
+                }
+            }
+
+            totalTokens += chunk.tokens.size() + chunk.indentTokens.size();
+            totalLiterals += chunk.literals.size();
+            lineBase += chunk.scanner->line - 1;
+        }
+        finalLine = lineBase + 1;
+        return true;
+    }
+
+    void copyChunk(size_t i, TokenList& result) {
+        Chunk& chunk = chunks[i];
+        if (chunk.absorbed) return;
+
+        size_t out = chunk.tokenBase;
+        size_t pending = 0;
+        for (size_t t = 0; t <= chunk.tokens.size(); t++) {
+            while (pending < chunk.indentTokens.size() && chunk.indentTokens[pending].first == t) {
+                result.tokens[out++] = chunk.indentTokens[pending++].second;
+            }
+            if (t == chunk.tokens.size()) break;
+
+            Token token = chunk.tokens[t];
+            token.line += chunk.lineBase;
+            if (token.hasLiteral()) token.literal += static_cast<uint32_t>(chunk.literalBase);
+            result.tokens[out++] = token;
+        }
+        for (size_t l = 0; l < chunk.literals.size(); l++) {
+            result.literals[chunk.literalBase + l] = std::move(chunk.literals[l]);
+        }
+        chunk.scanner.reset();
+    }
+};
@@ -0,0 +1,197 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+#include "chunk.hpp"
+
+// Sampling profiler for VM::run. A CPU-time timer (SIGPROF) only raises a
+// flag, so nothing runs in the signal handler. The VM polls the flag and
+// hands over its call stack from an instruction boundary, so a sample sees
+// the exact line being run. The VM only polls when a profiler is attached,
+// through separate instantiations of its dispatch loop, so the ordinary loop
+// pays nothing. The timer is process-wide: run one Profiler at a time.
+class Profiler {
+public:
+    // One level of the VM's call stack, outermost first.
+    struct Frame {
+        std::string_view function; // empty for the top-level script
+        int line;
+    };
+
+    explicit Profiler(std::chrono::microseconds interval = std::chrono::microseconds(1000), bool countOpcodes = false)
+        : countOpcodes(countOpcodes), interval(interval) {}
+    ~Profiler() { stop(); }
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Starts the timer. False where sampling is unsupported; opcode counts
+    // are still kept.
+    bool start() {
+#ifdef _WIN32
+        return false;
+#else
+        if (running) return true;
+        struct sigaction action = {};
+        action.sa_handler = onTimer;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (sigaction(SIGPROF, &action, &previous) != 0) return false;
+        struct itimerval timer = {};
+        timer.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000000);
+        timer.it_interval.tv_usec = static_cast<suseconds_t>(interval.count() % 1000000);
+        timer.it_value = timer.it_interval;
+        if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+            sigaction(SIGPROF, &previous, nullptr);
+            return false;
+        }
+        running = true;
+        return true;
+#endif
+    }
+
+    void stop() {
+#ifndef _WIN32
+        if (!running) return;
+        struct itimerval off = {};
+        setitimer(ITIMER_PROF, &off, nullptr);
+        sigaction(SIGPROF, &previous, nullptr);
+        running = false;
+        pendingSample = 0;
+#endif
+    }
+
+    // True when the timer has fired since the last sample.
+    static bool due() { return pendingSample != 0; }
+
+    // How many instructions the VM runs past a poll before sampling:
+    // uniform in [0, 256), so samples spread over the code that follows
+    // the VM's poll points instead of piling up on them.
+    uint32_t stride() {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+        return static_cast<uint32_t>(random >> 56);
+    }
+
+    void sample(const Frame* frames, int count) {
+        pendingSample = 0;
+        if (count == 0) return;
+        samples++;
+        std::string stack;
+        for (int i = 0; i < count; i++) {
+            std::string label = labelOf(frames[i]);
+            if (i) stack += ';';
+            stack += label;
+            // Recursion counts once towards a function's total
+            bool outer = false;
+            for (int j = 0; j < i && !outer; j++) outer = frames[j].function == frames[i].function;
+            if (!outer) functions[nameOf(frames[i].function)].total++;
+            if (i == count - 1) {
+                functions[nameOf(frames[i].function)].self++;
+                lines[std::move(label)]++;
+            }
+        }
+        folded[std::move(stack)]++;
+    }
+
+    const bool countOpcodes;
+    uint64_t opcodeCounts[OPCODE_COUNT] = {};
+
+    uint64_t sampleCount() const { return samples; }
+
+    // Brendan Gregg's folded format, one "frame;frame;frame count" line per
+    // distinct stack, ready for flamegraph.pl or speedscope. Frames are
+    // "function:line".
+    void writeFolded(std::ostream& out) const {
+        for (const auto& [stack, count] : sorted(folded)) out << stack << ' ' << count << '\n';
+    }
+
+    // The hottest functions, lines and (if counted) opcodes.
+    void writeSummary(std::ostream& out, size_t top = 15) const {
+        char row[160];
+        std::snprintf(row, sizeof(row), "profile: %llu samples every %.3g ms\n",
+                      static_cast<unsigned long long>(samples), interval.count() / 1000.0);
+        out << row;
+        if (samples) {
+            std::vector<std::pair<std::string, Counts>> byFunction(functions.begin(), functions.end());
+            std::sort(byFunction.begin(), byFunction.end(), [](const auto& a, const auto& b) {
+                return a.second.self != b.second.self ? a.second.self > b.second.self : a.first < b.first;
+            });
+            out << "  function                          self     total\n";
+            for (size_t i = 0; i < byFunction.size() && i < top; i++) {
+                std::snprintf(row, sizeof(row), "  %-30s %6.1f%%  %6.1f%%\n", byFunction[i].first.c_str(),
+                              percent(byFunction[i].second.self), percent(byFunction[i].second.total));
+                out << row;
+            }
+            out << "  line                              self\n";
+            std::vector<std::pair<std::string, uint64_t>> byLine = sorted(lines);
+            for (size_t i = 0; i < byLine.size() && i < top; i++) {
+                std::snprintf(row, sizeof(row), "  %-30s %6.1f%%\n", byLine[i].first.c_str(), percent(byLine[i].second));
+                out << row;
+            }
+        }
+        if (countOpcodes) {
+            uint64_t executed = 0;
+            std::vector<std::pair<std::string, uint64_t>> byOpcode;
+            for (int op = 0; op < OPCODE_COUNT; op++) {
+                executed += opcodeCounts[op];
+                if (opcodeCounts[op]) byOpcode.emplace_back(opcodeName(static_cast<OpCode>(op)), opcodeCounts[op]);
+            }
+            std::sort(byOpcode.begin(), byOpcode.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+            std::snprintf(row, sizeof(row), "  opcode (%llu executed)\n", static_cast<unsigned long long>(executed));
+            out << row;
+            for (size_t i = 0; i < byOpcode.size() && i < top; i++) {
+                std::snprintf(row, sizeof(row), "  %-20s %14llu  %6.1f%%\n", byOpcode[i].first.c_str(),
+                              static_cast<unsigned long long>(byOpcode[i].second), 100.0 * byOpcode[i].second / executed);
+                out << row;
+            }
+        }
+    }
+
+private:
+    struct Counts {
+        uint64_t self = 0;  // samples in the function itself
+        uint64_t total = 0; // samples with the function anywhere on the stack
+    };
+
+    inline static volatile std::sig_atomic_t pendingSample = 0;
+    static void onTimer(int) { pendingSample = 1; }
+
+    std::chrono::microseconds interval;
+    bool running = false;
+#ifndef _WIN32
+    struct sigaction previous = {};
+#endif
+    uint64_t samples = 0;
+    uint64_t random = 0x9e3779b97f4a7c15; // xorshift state for stride()
+    std::unordered_map<std::string, uint64_t> folded;
+    std::unordered_map<std::string, Counts> functions;
+    std::unordered_map<std::string, uint64_t> lines; // self samples by "function:line"
+
+    static std::string nameOf(std::string_view function) {
+        return function.empty() ? "<script>" : std::string(function);
+    }
+    static std::string labelOf(const Frame& frame) { return nameOf(frame.function) + ":" + std::to_string(frame.line); }
+
+    double percent(uint64_t count) const { return 100.0 * count / samples; }
+
+    // Most samples first, ties by name, so output is stable.
+    static std::vector<std::pair<std::string, uint64_t>> sorted(const std::unordered_map<std::string, uint64_t>& counts) {
+        std::vector<std::pair<std::string, uint64_t>> rows(counts.begin(), counts.end());
+        std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        return rows;
+    }
+};
@@ -0,0 +1,200 @@
+#pragma once
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AXIOM_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Run-skipping kernels used by the scanner for stretches that need no
+// per-byte decisions. Each kernel returns the first byte in [p, end) that
+// stops the run, or end. Vector loops only load whole blocks that lie inside
+// the buffer, so a mapped file is never read past its last byte.
+struct ScanKernels {
+    const char* name;
+    const char* (*skipBlanks)(const char* p, const char* end);     // ' ', '\t', '\r'
+    const char* (*skipToNewline)(const char* p, const char* end);  // comment bodies
+    const char* (*skipStringBody)(const char* p, const char* end); // stops at '"', '\\', '\n'
+    const char* (*skipIdentifier)(const char* p, const char* end); // [A-Za-z0-9]
+    const char* (*skipDigits)(const char* p, const char* end);     // [0-9]
+};
+
+struct ScalarKernels {
+    static bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static bool isAlnum(char c) { return isDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z'); }
+    static bool isStringSpecial(char c) { return c == '"' || c == '\\' || c == '\n'; }
+
+    static const char* skipBlanks(const char* p, const char* end) {
+        while (p < end && isBlank(*p)) p++;
+        return p;
+    }
+    static const char* skipToNewline(const char* p, const char* end) {
+        const void* nl = std::memchr(p, '\n', end - p);
+        return nl ? static_cast<const char*>(nl) : end;
+    }
+    static const char* skipStringBody(const char* p, const char* end) {
+        while (p < end && !isStringSpecial(*p)) p++;
+        return p;
+    }
+    static const char* skipIdentifier(const char* p, const char* end) {
+        while (p < end && isAlnum(*p)) p++;
+        return p;
+    }
+    static const char* skipDigits(const char* p, const char* end) {
+        while (p < end && isDigit(*p)) p++;
+        return p;
+    }
+};
+
+#ifdef AXIOM_SCAN_X86
+enum class ScanRun { Blanks, Newline, StringBody, Identifier, Digits };
+
+// Bytes >= 0x80 compare as negative, so they always fall outside the ASCII
+// ranges tested below, matching the scalar predicates.
+struct Sse2Kernels {
+    static constexpr int WIDTH = 16;
+
+    __attribute__((target("sse2"))) static __m128i inRange(__m128i v, char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+    }
+    __attribute__((target("sse2"))) static __m128i eq(__m128i v, char c) {
+        return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+    }
+
+    // Bit i is set when byte i ends the run.
+    template <ScanRun R>
+    __attribute__((target("sse2"))) static unsigned stops(const char* p) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        if constexpr (R == ScanRun::Blanks)
+            return ~_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(eq(v, ' '), eq(v, '\t')), eq(v, '\r'))) & 0xFFFF;
+        else if constexpr (R == ScanRun::Newline)
+            return _mm_movemask_epi8(eq(v, '\n'));
+        else if constexpr (R == ScanRun::StringBody)
+            return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(eq(v, '"'), eq(v, '\\')), eq(v, '\n')));
+        else if constexpr (R == ScanRun::Identifier)
+            return ~_mm_movemask_epi8(_mm_or_si128(inRange(v, '0', '9'),
+                                                   inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'))) & 0xFFFF;
+        else
+            return ~_mm_movemask_epi8(inRange(v, '0', '9')) & 0xFFFF;
+    }
+
+    template <ScanRun R>
+    __attribute__((target("sse2"))) static const char* scan(const char* p, const char* end) {
+        const char* begin = p;
+        for (; end - p >= WIDTH; p += WIDTH) {
+            if (unsigned hit = stops<R>(p)) return p + __builtin_ctz(hit);
+        }
+        if (p == end) return end;
+        // Finish with one overlapping block ending at `end` instead of a
+        // byte loop, ignoring the lanes that were already checked.
+        if (end - begin >= WIDTH) {
+            const char* q = end - WIDTH;
+            unsigned hit = stops<R>(q) >> (p - q);
+            return hit ? p + __builtin_ctz(hit) : end;
+        }
+        return scalar<R>(p, end);
+    }
+
+    template <ScanRun R>
+    static const char* scalar(const char* p, const char* end) {
+        if constexpr (R == ScanRun::Blanks) return ScalarKernels::skipBlanks(p, end);
+        else if constexpr (R == ScanRun::Newline) return ScalarKernels::skipToNewline(p, end);
+        else if constexpr (R == ScanRun::StringBody) return ScalarKernels::skipStringBody(p, end);
+        else if constexpr (R == ScanRun::Identifier) return ScalarKernels::skipIdentifier(p, end);
+        else return ScalarKernels::skipDigits(p, end);
+    }
+
+    static const char* skipBlanks(const char* p, const char* end) { return scan<ScanRun::Blanks>(p, end); }
+    static const char* skipToNewline(const char* p, const char* end) { return scan<ScanRun::Newline>(p, end); }
+    static const char* skipStringBody(const char* p, const char* end) { return scan<ScanRun::StringBody>(p, end); }
+    static const char* skipIdentifier(const char* p, const char* end) { return scan<ScanRun::Identifier>(p, end); }
+    static const char* skipDigits(const char* p, const char* end) { return scan<ScanRun::Digits>(p, end); }
+};
+
+struct Avx2Kernels {
+    static constexpr int WIDTH = 32;
+
+    __attribute__((target("avx2"))) static __m256i inRange(__m256i v, char lo, char hi) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+    }
+    __attribute__((target("avx2"))) static __m256i eq(__m256i v, char c) {
+        return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+    }
+
+    template <ScanRun R>
+    __attribute__((target("avx2"))) static unsigned stops(const char* p) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        if constexpr (R == ScanRun::Blanks)
+            return ~_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(eq(v, ' '), eq(v, '\t')), eq(v, '\r')));
+        else if constexpr (R == ScanRun::Newline)
+            return _mm256_movemask_epi8(eq(v, '\n'));
+        else if constexpr (R == ScanRun::StringBody)
+            return _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(eq(v, '"'), eq(v, '\\')), eq(v, '\n')));
+        else if constexpr (R == ScanRun::Identifier)
+            return ~_mm256_movemask_epi8(_mm256_or_si256(inRange(v, '0', '9'),
+                                                         inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z')));
+        else
+            return ~_mm256_movemask_epi8(inRange(v, '0', '9'));
+    }
+
+    template <ScanRun R>
+    __attribute__((target("avx2"))) static const char* scan(const char* p, const char* end) {
+        const char* begin = p;
+        for (; end - p >= WIDTH; p += WIDTH) {
+            if (unsigned hit = stops<R>(p)) return p + __builtin_ctz(hit);
+        }
+        if (p == end) return end;
+        if (end - begin >= WIDTH) {
+            const char* q = end - WIDTH;
+            unsigned hit = stops<R>(q) >> (p - q);
+            return hit ? p + __builtin_ctz(hit) : end;
+        }
+        return Sse2Kernels::scan<R>(p, end);
+    }
+
+    static const char* skipBlanks(const char* p, const char* end) { return scan<ScanRun::Blanks>(p, end); }
+    static const char* skipToNewline(const char* p, const char* end) { return scan<ScanRun::Newline>(p, end); }
+    static const char* skipStringBody(const char* p, const char* end) { return scan<ScanRun::StringBody>(p, end); }
+    static const char* skipIdentifier(const char* p, const char* end) { return scan<ScanRun::Identifier>(p, end); }
+    static const char* skipDigits(const char* p, const char* end) { return scan<ScanRun::Digits>(p, end); }
+};
+#endif
+
+template <class K>
+constexpr ScanKernels makeScanKernels(const char* name) {
+    return {name, &K::skipBlanks, &K::skipToNewline, &K::skipStringBody, &K::skipIdentifier, &K::skipDigits};
+}
+
+// Every kernel set this CPU can run, best first. Setting AXIOM_SCAN_ISA to
+// one of the names (e.g. "scalar") pins the scanner to that set, which is
+// how the benchmark compares them end to end.
+inline int availableScanKernels(const ScanKernels** out) {
+    int count = 0;
+#ifdef AXIOM_SCAN_X86
+    static constexpr ScanKernels avx2 = makeScanKernels<Avx2Kernels>("avx2");
+    static constexpr ScanKernels sse2 = makeScanKernels<Sse2Kernels>("sse2");
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) out[count++] = &avx2;
+    if (__builtin_cpu_supports("sse2")) out[count++] = &sse2;
+#endif
+    static constexpr ScanKernels scalar = makeScanKernels<ScalarKernels>("scalar");
+    out[count++] = &scalar;
+    return count;
+}
+
+inline const ScanKernels& scanKernels() {
+    static const ScanKernels& selected = [] () -> const ScanKernels& {
+        const ScanKernels* all[3];
+        int count = availableScanKernels(all);
+        if (const char* isa = std::getenv("AXIOM_SCAN_ISA")) {
+            for (int i = 0; i < count; i++) {
+                if (std::strcmp(all[i]->name, isa) == 0) return *all[i];
+            }
+        }
+        return *all[0];
+    }();
+    return selected;
+}
@@ -1,54 +1,200 @@
 #pragma once
+#include <charconv>
+#include <cstdint>
+#include <iterator>
 #include <vector>
-#include <unordered_map>
 #include <string>
+#include <string_view>
 #include "token_type.hpp"
 #include "token.hpp"
-
-
-void error(int line, const std::string& message, const std::string& source, int start, int current);
+#include "scan_kernels.hpp"
+#include "keywords.hpp"
+#include "interner.hpp"
+#include "error_sink.hpp"
 
 class Scanner {
 public:
-    Scanner(const std::string& source) : source(source) {}
+    // Literals of streamed tokens live in a ring of this many slots, so a
+    // token's literal stays valid until this many further literal tokens
+    // have been pulled.
+    static constexpr uint32_t LITERAL_WINDOW = 16;
+
+    // The scanner does not copy the source; it must outlive the scanner and
+    // any TokenList it produces. With an interner, identifiers carry their
+    // SymbolId in Token::literal. Errors go to `errors` if given; they are
+    // counted either way.
+    Scanner(std::string_view source, int line = 1, Interner* symbols = nullptr, ErrorSink* errors = nullptr)
+        : source(source), line(line), symbols(symbols), errors(errors) {}
+
+    // Pull the next token. Memory stays bounded by the indentation depth
+    // rather than the file size; after EOF_ every call returns EOF_ again.
+    Token nextToken() {
+        while (windowHead == window.size()) {
+            window.clear();
+            windowHead = 0;
+            if (finished) return Token(TokenType::EOF_, current, 0, Token::NO_LITERAL, line);
 
-    std::vector<Token> scanTokens() {
-        while (!isAtEnd()) {
             start = current;   // reset start at beginning of each token
-            scanToken();
+            if (!isAtEnd() || !fStrings.empty()) {
+                scanToken();
+            } else {
+                // Pop remaining indents
+                while (indentLevels.size() > 1) {
+                    indentLevels.pop_back();
+                    addToken(TokenType::DEDENT);
+                }
+                addToken(TokenType::EOF_);
+                finished = true;
+            }
         }
+        return window[windowHead++];
+    }
 
-        // Pop remaining indents
-        while (indentLevels.size() > 1) {
-            indentLevels.pop_back();
-            addToken(TokenType::DEDENT);
+    TokenList scanTokens() {
+        TokenList tokens;
+        tokens.source = source;
+        for (;;) {
+            Token token = nextToken();
+            if (token.hasLiteral()) {
+                tokens.literals.push_back(std::move(literals[token.literal % LITERAL_WINDOW]));
+                token.literal = static_cast<uint32_t>(tokens.literals.size() - 1);
+            }
+            tokens.tokens.push_back(token);
+            if (token.type == TokenType::EOF_) return tokens;
         }
+    }
+
+    Value literal(const Token& token) const {
+        return token.hasLiteral() ? literals[token.literal % LITERAL_WINDOW].value : Value::none();
+    }
+
+    // The value of a NUMBER whose literal() is none: an integer too wide to
+    // sit inline.
+    int64_t wideInteger(const Token& token) const { return literals[token.literal % LITERAL_WINDOW].integer; }
 
-        tokens.emplace_back(TokenType::EOF_, "", nullptr, line);
-        return tokens;
+    std::string_view lexeme(const Token& token) const {
+        if (token.hasText()) return literals[token.literal % LITERAL_WINDOW].text;
+        return source.substr(token.offset, token.length);
     }
 
+    // Input iterator over the token stream, ending after EOF_.
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Token;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Token*;
+        using reference = const Token&;
+
+        iterator() : scanner(nullptr), token(TokenType::EOF_, 0, 0, Token::NO_LITERAL, 0) {}
+        explicit iterator(Scanner* scanner) : scanner(scanner), token(scanner->nextToken()) {}
+
+        const Token& operator*() const { return token; }
+        const Token* operator->() const { return &token; }
+        iterator& operator++() {
+            if (token.type == TokenType::EOF_) scanner = nullptr;
+            else token = scanner->nextToken();
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return scanner == other.scanner; }
+        bool operator!=(const iterator& other) const { return scanner != other.scanner; }
+
+    private:
+        Scanner* scanner;
+        Token token;
+    };
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+    bool hadError() const { return errorCount > 0; }
+
 private:
-    const std::string source;
-    std::vector<Token> tokens;
+    friend class ParallelScanner;
+    friend class IncrementalScanner;
+
+    // Indentation seen by a chunk scanner whose enclosing indent stack is
+    // not known yet; ParallelScanner replays these against the real stack.
+    struct IndentMark {
+        uint32_t token;   // index of the first token of the line within the chunk
+        int indent;
+        int offset;
+        int length;
+        int line;
+    };
+
+    // An f-string being scanned: in its text, or inside an {expression}
+    // with this many unclosed braces of its own.
+    struct FString {
+        static constexpr int IN_TEXT = -1;
+        int braces = IN_TEXT;
+        bool started = false; // FSTRING_START has been emitted
+    };
+
+    const std::string_view source;
+    int line = 1;
+    Interner* symbols = nullptr;
+    ErrorSink* errors = nullptr;
+    const ScanKernels& kernels = scanKernels();
+    std::vector<Token> window;  // tokens produced by the last scan step
+    size_t windowHead = 0;
+    Literal literals[LITERAL_WINDOW];
+    uint32_t literalCount = 0;
     std::vector<int> indentLevels {0};
     int start = 0;
     int current = 0;
-    int line = 1;
+    int errorCount = 0;
     bool atLineStart = true;
-
-    bool isAtEnd() const { return current >= source.size(); }
+    std::vector<FString> fStrings; // innermost last
+    bool finished = false;
+    std::vector<IndentMark>* indentMarks = nullptr; // set while scanning a chunk
+    uint32_t chunkTokens = 0;
+    bool speculative = false; // chunk scanners record failures instead of reporting
+    bool failed = false;
+
+    // Line-start checkpoints for IncrementalScanner: the scanner state at the
+    // start of each line is its offset, line number and indent stack.
+    struct LineStart {
+        uint32_t offset;
+        uint32_t token;   // tokens produced before this line
+        int line;
+        uint32_t stack;   // index into indentStacks
+    };
+    std::vector<LineStart>* lineStarts = nullptr;
+    std::vector<std::vector<int>>* indentStacks = nullptr;
+    uint32_t stackId = 0;
+    bool indentChanged = true;
+
+    bool isAtEnd() const { return static_cast<size_t>(current) >= source.size(); }
     char advance() { return source[current++]; }
     char peek() const { return isAtEnd() ? '\0' : source[current]; }
-    char peekNext() const { return (current + 1 >= source.size()) ? '\0' : source[current + 1]; }
+    char peekNext() const { return (static_cast<size_t>(current) + 1 >= source.size()) ? '\0' : source[current + 1]; }
     bool match(char expected) { if (peek() != expected) return false; current++; return true; }
 
+    // Advance over a run accepted by one of the vectorized kernels.
+    void skip(const char* (*kernel)(const char*, const char*)) {
+        const char* base = source.data();
+        current = static_cast<int>(kernel(base + current, base + source.size()) - base);
+    }
+
     void scanToken() {
         char c = peek();
+        if (!fStrings.empty()) {
+            if (fStrings.back().braces == FString::IN_TEXT) {
+                fStringText();
+                return;
+            }
+            if (isAtEnd()) {
+                fStrings.clear();
+                report("Unterminated expression in f-string.");
+                return;
+            }
+        }
         if ((c == 'f' || c == 'F') && peekNext() == '"') {
             advance(); // consume f/F
             advance(); // consume opening "
-            fString();
+            fStrings.push_back(FString());
+            fStringText();
             return;
         }
         if (atLineStart) handleIndentation();
@@ -71,23 +217,39 @@ private:
             // Single-character tokens
             case '(': addToken(TokenType::LEFT_PAREN); break;
             case ')': addToken(TokenType::RIGHT_PAREN); break;
-            case '{': addToken(TokenType::LEFT_SQUIGGLE); break;
-            case '}': addToken(TokenType::RIGHT_SQUIGGLE); break;
+            case '{':
+                if (!fStrings.empty()) fStrings.back().braces++;
+                addToken(TokenType::LEFT_SQUIGGLE);
+                break;
+            case '}':
+                if (!fStrings.empty() && fStrings.back().braces == 0) {
+                    fStrings.back().braces = FString::IN_TEXT; // the expression is over
+                    break;
+                }
+                if (!fStrings.empty()) fStrings.back().braces--;
+                addToken(TokenType::RIGHT_SQUIGGLE);
+                break;
             case '[': addToken(TokenType::LEFT_BRACE); break;
             case ']': addToken(TokenType::RIGHT_BRACE); break;
             case ',': addToken(TokenType::COMMA); break;
+            case ':': addToken(TokenType::COLON); break;
             case '.': addToken(TokenType::DOT); break;
             case ';': addToken(TokenType::SEMICOLON); break;
             case ' ':
             case '\r':
-            case '\t': break; // skip whitespace
+            case '\t': skip(kernels.skipBlanks); break; // skip whitespace
             case '\n':
+                if (!fStrings.empty()) { // inside {...}, a newline is just whitespace
+                    line++;
+                    break;
+                }
                 if (!atLineStart) {
                     // We only emit a token if the line wasn't empty/just comments
                     addToken(TokenType::NEWLINE);
                 }
                 line++;
                 atLineStart = true; // Reset for the next line
+                if (lineStarts) recordLineStart();
                 break;
 
             // Operators (two-char handled consistently)
@@ -109,7 +271,7 @@ private:
             case '/':
                 if (match('/')) {
                     // Consume everything until the newline
-                    while (peek() != '\n' && !isAtEnd()) advance();
+                    skip(kernels.skipToNewline);
                     // Do NOT consume the \n here.
                     // Let the 'case \n' handle it so 'atLineStart' logic stays consistent.
                 } else {
@@ -123,7 +285,7 @@ private:
             default:
                 if (isdigit(c)) number();
                 else if (isalpha(c)) identifier();
-                else error(line, "Unexpected character.", source, start, current);
+                else report("Unexpected character.");
                 break;
         }
     }
@@ -142,92 +304,87 @@ private:
             return;
         }
 
+        if (indentMarks) {
+            uint32_t token = chunkTokens + static_cast<uint32_t>(window.size());
+            indentMarks->push_back({token, indent, start, current - start, line});
+            atLineStart = false;
+            return;
+        }
+
         int currentIndent = indentLevels.back();
 
         if (indent > currentIndent) {
             indentLevels.push_back(indent);
+            indentChanged = true;
             addToken(TokenType::INDENT);
         } else if (indent < currentIndent) {
             while (indentLevels.size() > 1 && indent < indentLevels.back()) {
                 indentLevels.pop_back();
+                indentChanged = true;
                 addToken(TokenType::DEDENT);
             }
             if (indent != indentLevels.back()) {
-                error(line, "Inconsistent indentation.", source, start, current);
+                report("Inconsistent indentation.");
             }
         }
         atLineStart = false;
     }
 
-    void fString() {
-        std::string literal;
+    // Scans the literal text of an f-string up to its next {expression}
+    // or its closing quote. Expressions are scanned as ordinary tokens in
+    // between, with the brace depth telling their closing } apart.
+    void fStringText() {
+        FString& fString = fStrings.back();
+        std::string text;
         while (!isAtEnd()) {
-            char c = advance();
+            // Copy the run up to the next quote, brace or newline in one go
+            int runStart = current;
+            while (!isAtEnd() && !isFStringSpecial(peek())) current++;
+            text.append(source.data() + runStart, current - runStart);
+            if (isAtEnd()) break;
 
+            char c = advance();
             if (c == '"') {
-                if (!literal.empty()) addToken(TokenType::STRING, literal);
+                // Without any expression it is a plain string
+                addToken(fString.started ? TokenType::FSTRING_END : TokenType::STRING, std::move(text));
+                fStrings.pop_back();
                 return;
             }
-
-            // Handle escaped {{
-            else if (c == '{' && peek() == '{') {
-                literal += advance(); // Consume the second '{'
-            }
-
-            // Handle start of expression
-            else if (c == '{') {
-                if (!literal.empty()) {
-                    addToken(TokenType::STRING, literal);
-                    literal.clear();
-                }
-
-                int exprStart = current;
-                int braceDepth = 1;
-                while (!isAtEnd() && braceDepth > 0) {
-                    char ch = advance();
-                    if (ch == '{') braceDepth++;
-                    else if (ch == '}') braceDepth--;
-                }
-
-                if (braceDepth > 0) {
-                    error(line, "Unterminated expression in f-string.", source, start, current);
-                    return;
-                }
-
-                int exprEnd = current - 1;
-                std::string exprText = source.substr(exprStart, exprEnd - exprStart);
-                addToken(TokenType::FSTRING_EXPR, exprText);
-            }
-
-            // Handle escaped }}
-            else if (c == '}' && peek() == '}') {
-                literal += advance(); // Consume the second '}'
-            }
-
-            // Normal characters
-            else {
-                literal += c;
+            if ((c == '{' || c == '}') && peek() == c) { // {{ and }}
+                text += advance();
+            } else if (c == '{') {
+                addToken(fString.started ? TokenType::FSTRING_PART : TokenType::FSTRING_START, std::move(text));
+                fString.started = true;
+                fString.braces = 0;
+                return;
+            } else {
+                if (c == '\n') line++;
+                text += c;
             }
         }
-        error(line, "Unterminated f-string.", source, start, current);
+        fStrings.pop_back();
+        report("Unterminated f-string.");
     }
 
-
-
-
-
+    static bool isFStringSpecial(char c) { return c == '"' || c == '{' || c == '}' || c == '\n'; }
 
     void string() {
         std::string value;
         start++; // skip the opening quote
         while (!isAtEnd()) {
+            // Copy the run up to the next quote, backslash or newline in one go
+            int runStart = current;
+            skip(kernels.skipStringBody);
+            value.append(source.data() + runStart, current - runStart);
+            if (isAtEnd()) break;
+
             char c = advance();
             if (c == '"') { // end of string
-                addToken(TokenType::STRING, value);
+                addToken(TokenType::STRING, std::move(value));
                 return;
             }
             if (c == '\\') {
-                if (isAtEnd()) { error(line, "Unterminated escape sequence", source, start, current); return; }
+                if (isAtEnd()) { report("Unterminated escape sequence"); return; }
                 char esc = advance();
                 switch (esc) {
                     case 'n': value += '\n'; break;
@@ -235,59 +392,173 @@ private:
                     case 'r': value += '\r'; break;
                     case '"': value += '"'; break;
                     case '\\': value += '\\'; break;
-                    default: error(line, "Unknown escape sequence", source, start, current);
+                    default: report("Unknown escape sequence");
                 }
             } else {
                 value += c;
                 if (c == '\n') line++;
             }
         }
-        error(line, "Unterminated string", source, start, current);
+        report("Unterminated string");
     }
 
 
+    // Decimal, 0x hex and 0b binary literals, with single `_` separators
+    // between digits. The digits are parsed straight off the source bytes;
+    // only a literal with separators is first copied, onto the stack.
     void number() {
-        while (isdigit(peek())) advance();
-        if (peek() == '.' && isdigit(peekNext())) {
+        int base = 10;
+        if (source[start] == '0' && (peek() == 'x' || peek() == 'X' || peek() == 'b' || peek() == 'B')) {
+            base = (peek() == 'x' || peek() == 'X') ? 16 : 2;
+            advance();
+            if (!isDigitOf(peek(), base)) {
+                report(base == 16 ? "Expect hex digits after '0x'." : "Expect binary digits after '0b'.");
+                return;
+            }
+        }
+        bool separated = false;
+        if (!digits(base, &separated)) return;
+        bool fraction = base == 10 && peek() == '.' && isdigit(peekNext());
+        if (fraction) {
             advance();
-            while (isdigit(peek())) advance();
+            if (!digits(10, &separated)) return;
+        }
+        if (isalnum(peek())) {
+            report("Invalid number literal.");
+            return;
+        }
+
+        int prefix = base == 10 ? 0 : 2;
+        std::string_view text = source.substr(start + prefix, current - start - prefix);
+        char buffer[64];
+        std::string spilled;
+        if (separated) {
+            if (text.size() <= sizeof(buffer)) {
+                size_t length = 0;
+                for (char c : text) if (c != '_') buffer[length++] = c;
+                text = std::string_view(buffer, length);
+            } else {
+                for (char c : text) if (c != '_') spilled += c;
+                text = spilled;
+            }
+        }
+        const char* first = text.data();
+        const char* last = first + text.size();
+
+        if (!fraction) {
+            int64_t integer;
+            std::from_chars_result result = std::from_chars(first, last, integer, base);
+            if (result.ec == std::errc()) {
+                addInteger(integer);
+                return;
+            }
+            if (base != 10) {
+                report("Integer literal too large.");
+                return;
+            }
+            // A decimal integer past 64 bits degrades to a float, like
+            // overflowing arithmetic does.
+        }
+        double value = 0;
+        std::from_chars(first, last, value);
+        addToken(TokenType::NUMBER, Value::number(value));
+    }
+
+    static bool isDigitOf(char c, int base) {
+        if (base == 2) return c == '0' || c == '1';
+        if (base == 16) return isxdigit(static_cast<unsigned char>(c)) != 0;
+        return isdigit(static_cast<unsigned char>(c)) != 0;
+    }
+
+    // A run of digits in `base`, each `_` separator followed by a digit.
+    bool digits(int base, bool* separated) {
+        for (;;) {
+            if (base == 10) skip(kernels.skipDigits);
+            else while (isDigitOf(peek(), base)) advance();
+            if (peek() != '_') return true;
+            advance();
+            *separated = true;
+            if (!isDigitOf(peek(), base)) {
+                report("Digit separators must sit between digits.");
+                return false;
+            }
         }
-        double value = std::stod(source.substr(start, current - start));
-        addToken(TokenType::NUMBER, value);
     }
 
     void identifier() {
-        while (isalnum(peek())) advance();
-        std::string text = source.substr(start, current - start);
-
-        static const std::unordered_map<std::string, TokenType> keywords = {
-            {"and", TokenType::AND}, {"class", TokenType::CLASS}, {"def", TokenType::DEF},
-            {"else", TokenType::ELSE}, {"false", TokenType::FALSE}, {"for", TokenType::FOR},
-            {"if", TokenType::IF}, {"in", TokenType::IN}, {"input", TokenType::INPUT},
-            {"none", TokenType::NONE}, {"or", TokenType::OR}, {"print", TokenType::PRINT},
-            {"return", TokenType::RETURN}, {"super", TokenType::SUPER}, {"this", TokenType::THIS},
-            {"true", TokenType::TRUE}, {"while", TokenType::WHILE}, {"input", TokenType::INPUT}
-        };
+        skip(kernels.skipIdentifier);
+        // Keywords are matched straight on the source bytes; anything else
+        // is a plain identifier, interned from those same bytes.
+        std::string_view text = source.substr(start, current - start);
+        TokenType type = keywordType(text);
+        if (type == TokenType::IDENTIFIER && symbols) emit(type, start, current - start, symbols->intern(text));
+        else addToken(type);
+    }
 
-        auto it = keywords.find(text);
-        if (it != keywords.end()) addToken(it->second);
-        else addToken(TokenType::IDENTIFIER, text);
+    void report(const std::string& message) {
+        errorCount++;
+        if (speculative) {
+            failed = true;
+            return;
+        }
+        if (errors) errors->scanError(line, message, source, start, current);
     }
 
-    void addToken(TokenType type) { addToken(type, std::any{}); }
-    void addToken(TokenType type, const std::any& literal) {
-        std::string lex = source.substr(start, current - start);
+    // Chunk scanning for ParallelScanner: scan every token that starts before
+    // `end` (one may run past it) and move them, with their literals, out of
+    // the window.
+    void scanChunk(int end, std::vector<Token>& out, std::vector<Literal>& outLiterals) {
+        while (!fStrings.empty() || (current < end && !isAtEnd())) scanStep(out, outLiterals);
+    }
 
-        // Check for both STRING and FSTRING_EXPR to override the lexeme
-        if ((type == TokenType::STRING || type == TokenType::FSTRING_EXPR) && literal.has_value()) {
-            try {
-                lex = std::any_cast<std::string>(literal);
-            } catch (const std::bad_any_cast& e) {
-                // Fallback or handle non-string literals (like numbers) if necessary
+    void scanStep(std::vector<Token>& out, std::vector<Literal>& outLiterals) {
+        start = current;
+        scanToken();
+        for (Token token : window) {
+            if (token.hasLiteral()) {
+                outLiterals.push_back(std::move(literals[token.literal % LITERAL_WINDOW]));
+                token.literal = static_cast<uint32_t>(outLiterals.size() - 1);
             }
+            out.push_back(token);
+        }
+        chunkTokens += static_cast<uint32_t>(window.size());
+        window.clear();
+    }
+
+    void recordLineStart() {
+        if (indentChanged) {
+            indentStacks->push_back(indentLevels);
+            stackId = static_cast<uint32_t>(indentStacks->size() - 1);
+            indentChanged = false;
         }
+        uint32_t token = chunkTokens + static_cast<uint32_t>(window.size());
+        lineStarts->push_back({static_cast<uint32_t>(current), token, line, stackId});
+    }
+
+    void addToken(TokenType type) { emit(type, start, current - start, Token::NO_LITERAL); }
+    void addToken(TokenType type, Value value) {
+        Literal& literal = literals[literalCount % LITERAL_WINDOW];
+        literal.value = value;
+        literal.text.clear();
+        emit(type, start, current - start, literalCount++);
+    }
+    void addInteger(int64_t integer) {
+        if (Value::fitsInt(integer)) {
+            addToken(TokenType::NUMBER, Value::integer(integer));
+            return;
+        }
+        addToken(TokenType::NUMBER, Value::none());
+        literals[(literalCount - 1) % LITERAL_WINDOW].integer = integer;
+    }
+    void addToken(TokenType type, std::string text) {
+        Literal& literal = literals[literalCount % LITERAL_WINDOW];
+        literal.value = Value::none();
+        literal.text = std::move(text);
+        emit(type, start, current - start, literalCount++);
+    }
 
-        tokens.emplace_back(type, lex, literal, line);
+    void emit(TokenType type, int offset, int length, uint32_t literal) {
+        window.emplace_back(type, static_cast<uint32_t>(offset), static_cast<uint32_t>(length), literal, line);
     }
 
 };
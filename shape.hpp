@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "interner.hpp"
+
+struct ObjFunction;
+
+// A hidden class: the ordered field names an instance has, so the fields
+// themselves can live in a plain slot array. Instances that gain the same
+// fields in the same order share a shape, because adding a field follows a
+// transition that is created once and reused. Every class has its own root,
+// so a shape also identifies the class and with it the methods.
+//
+// Shapes are immutable once made and live as long as the heap that made
+// them.
+class Shape {
+public:
+    explicit Shape(const Shape* parent = nullptr, SymbolId name = Interner::NONE) {
+        if (parent) fields = parent->fields;
+        if (name != Interner::NONE) fields.push_back(name);
+    }
+
+    // Slot of `name`, or -1. Only inline-cache misses come here.
+    int slotOf(SymbolId name) const {
+        for (size_t i = fields.size(); i-- > 0;) {
+            if (fields[i] == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    size_t size() const { return fields.size(); }
+    SymbolId field(size_t slot) const { return fields[slot]; }
+
+    // The shape after adding `name`; `make` creates it the first time.
+    template <class Make>
+    Shape* withField(SymbolId name, Make make) {
+        for (auto& [field, shape] : transitions) {
+            if (field == name) return shape;
+        }
+        Shape* shape = make(this, name);
+        transitions.emplace_back(name, shape);
+        return shape;
+    }
+
+private:
+    std::vector<SymbolId> fields;
+    std::vector<std::pair<SymbolId, Shape*>> transitions;
+};
+
+// Per-site memory of what a property access found last time, keyed by the
+// receiver's shape. Up to WAYS shapes are remembered (polymorphic); past
+// that entries are recycled in turn, so a megamorphic site still works but
+// mostly misses.
+struct InlineCache {
+    static constexpr int WAYS = 4;
+
+    struct Entry {
+        const Shape* shape = nullptr;
+        Shape* next = nullptr;         // SET_PROPERTY that adds the field: the new shape
+        ObjFunction* method = nullptr; // a method rather than a field
+        uint32_t slot = 0;
+    };
+
+    Entry entries[WAYS];
+    uint8_t used = 0;
+    uint8_t victim = 0;
+
+    const Entry* find(const Shape* shape) const {
+        for (int i = 0; i < used; i++) {
+            if (entries[i].shape == shape) return &entries[i];
+        }
+        return nullptr;
+    }
+
+    void add(const Entry& entry) {
+        if (used < WAYS) {
+            entries[used++] = entry;
+        } else {
+            entries[victim] = entry;
+            victim = (victim + 1) % WAYS;
+        }
+    }
+};
+
+// Hit and miss counts over every inline cache in a VM.
+struct InlineCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+
+    double hitRate() const { return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0; }
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <string_view>
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a script's bytes. Regular files are memory-mapped so the
+// scanner works directly on the page cache; pipes, stdin ("-") and anything
+// mmap refuses fall back to a buffered read into an owned string.
+class SourceFile {
+public:
+    SourceFile() = default;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        buffer = std::move(contents).str();
+        return true;
+#else
+        int fd = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        bool ok = fstat(fd, &info) == 0;
+        if (ok && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, info.st_size, MADV_SEQUENTIAL);
+                mapped = static_cast<const char*>(addr);
+                mappedSize = static_cast<size_t>(info.st_size);
+            } else {
+                ok = readAll(fd);
+            }
+        } else if (ok) {
+            ok = readAll(fd);
+        }
+
+        if (fd != STDIN_FILENO) ::close(fd);
+        return ok;
+#endif
+    }
+
+    std::string_view view() const {
+        return mapped ? std::string_view(mapped, mappedSize) : std::string_view(buffer);
+    }
+
+    bool isMapped() const { return mapped != nullptr; }
+
+private:
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+    std::string buffer;
+
+    void close() {
+#ifndef _WIN32
+        if (mapped) munmap(const_cast<char*>(mapped), mappedSize);
+#endif
+        mapped = nullptr;
+        mappedSize = 0;
+        buffer.clear();
+    }
+
+#ifndef _WIN32
+    bool readAll(int fd) {
+        char chunk[1 << 16];
+        for (;;) {
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n == 0) return true;
+            if (n < 0) return false;
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+#endif
+};
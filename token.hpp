@@ -1,25 +1,54 @@
 #pragma once
-#include <any>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "token_type.hpp"
+#include "value.hpp"
 
+// A decoded literal: numbers sit inline in the NaN-boxed value, the text of
+// a string literal alongside it. An integer too wide for an inline value
+// has no heap to be boxed on yet, so it is kept in `integer` with a none
+// value until the compiler boxes it.
+struct Literal {
+    Value value;
+    int64_t integer = 0;
+    std::string text;
+};
+
+// Compact token record. The lexeme is an (offset, length) slice of the source
+// buffer and decoded literals live in a side table owned by TokenList, so a
+// token never owns heap memory.
 class Token {
 public:
-    const TokenType type;
-    const std::string lexeme;
-    const std::any literal;
-    const int line;
+    static constexpr uint32_t NO_LITERAL = UINT32_MAX;
 
-    Token(TokenType type, const std::string& lexeme, const std::any& literal, int line)
-        : type(type), lexeme(lexeme), literal(literal), line(line) {}
+    TokenType type;
+    uint32_t offset;
+    uint32_t length;
+    // Index into TokenList::literals, or NO_LITERAL. An IDENTIFIER scanned
+    // with an Interner carries its SymbolId here instead.
+    uint32_t literal;
+    int line;
 
-        std::string tokenTypeToString(TokenType type) const {
+    Token(TokenType type, uint32_t offset, uint32_t length, uint32_t literal, int line)
+        : type(type), offset(offset), length(length), literal(literal), line(line) {}
+
+    bool hasLiteral() const { return literal != NO_LITERAL && type != TokenType::IDENTIFIER; }
+    // STRING and the f-string pieces carry their decoded text as a literal.
+    bool hasText() const {
+        return hasLiteral() && (type == TokenType::STRING || type == TokenType::FSTRING_START ||
+                                type == TokenType::FSTRING_PART || type == TokenType::FSTRING_END);
+    }
+
+        static std::string tokenTypeToString(TokenType type) {
             switch (type) {
                 case TokenType::LEFT_PAREN: return "LEFT_PAREN";
                 case TokenType::RIGHT_PAREN: return "RIGHT_PAREN";
                 case TokenType::LEFT_BRACE: return "LEFT_BRACE";
                 case TokenType::RIGHT_BRACE: return "RIGHT_BRACE";
                 case TokenType::COMMA: return "COMMA";
+                case TokenType::COLON: return "COLON";
                 case TokenType::DOT: return "DOT";
                 case TokenType::MINUS: return "MINUS";
                 case TokenType::PLUS: return "PLUS";
@@ -55,6 +84,7 @@ public:
                 case TokenType::THIS: return "THIS";
                 case TokenType::TRUE: return "TRUE";
                 case TokenType::WHILE: return "WHILE";
+                case TokenType::YIELD: return "YIELD";
                 case TokenType::EOF_: return "EOF_";
                 case TokenType::LEFT_SQUIGGLE: return "LEFT_SQUIGGLE";
                 case TokenType::RIGHT_SQUIGGLE: return "RIGHT_SQUIGGLE";
@@ -68,27 +98,57 @@ public:
                 case TokenType::SLASH_EQUAL: return "SLASH_EQUAL";
                 case TokenType::STAR_EQUAL: return "STAR_EQUAL";
                 case TokenType::PERCENT_EQUAL: return "PERCENT_EQUAL";
-                case TokenType::FSTRING_EXPR: return "FSTRING_EXPR";
+                case TokenType::FSTRING_START: return "FSTRING_START";
+                case TokenType::FSTRING_PART: return "FSTRING_PART";
+                case TokenType::FSTRING_END: return "FSTRING_END";
                 default: return "UNKNOWN";
             }
         }
 
-        std::string literalToString() const {
-            if (!literal.has_value()) return "None";
+        static std::string literalToString(Value literal) {
+            if (literal.isInt()) return std::to_string(static_cast<double>(literal.asInt()));
+            if (literal.isDouble()) return std::to_string(literal.asDouble());
+            if (literal.isBool()) return literal.asBool() ? "true" : "false";
+            return "None";
+        }
+};
+
+static_assert(sizeof(Token) == 20, "Token should stay a small fixed-size record");
 
-            if (literal.type() == typeid(double))
-                return std::to_string(std::any_cast<double>(literal));
+// Result of Scanner::scanTokens(): the token records plus the side table of
+// decoded literals. Lexemes are views into the scanned source, which must
+// outlive the list.
+class TokenList {
+public:
+    std::string_view source;
+    std::vector<Token> tokens;
+    std::vector<Literal> literals;
 
-            if (literal.type() == typeid(std::string))
-                return std::any_cast<std::string>(literal);
+    size_t size() const { return tokens.size(); }
+    const Token& operator[](size_t i) const { return tokens[i]; }
+    std::vector<Token>::const_iterator begin() const { return tokens.begin(); }
+    std::vector<Token>::const_iterator end() const { return tokens.end(); }
 
-            if (literal.type() == typeid(bool))
-                return std::any_cast<bool>(literal) ? "true" : "false";
+    Value literal(const Token& token) const {
+        return token.hasLiteral() ? literals[token.literal].value : Value::none();
+    }
 
-            return "<?>"; // something went sideways
-        }
+    // The value of a NUMBER whose literal() is none: an integer too wide to
+    // sit inline.
+    int64_t wideInteger(const Token& token) const { return literals[token.literal].integer; }
 
-    std::string toString() const {
-        return tokenTypeToString(type) + " " + lexeme + " " + literalToString();
+    // String literals and f-string pieces report their decoded text,
+    // everything else the raw slice.
+    std::string_view lexeme(const Token& token) const {
+        if (token.hasText()) return literals[token.literal].text;
+        return source.substr(token.offset, token.length);
+    }
+
+    std::string toString(const Token& token) const {
+        std::string literalText = token.hasText() ? literals[token.literal].text : Token::literalToString(literal(token));
+        if (token.type == TokenType::NUMBER && literal(token).isNone()) {
+            literalText = std::to_string(static_cast<double>(wideInteger(token)));
+        }
+        return Token::tokenTypeToString(token.type) + " " + std::string(lexeme(token)) + " " + literalText;
     }
 };
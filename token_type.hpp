@@ -1,5 +1,7 @@
 #pragma once
-enum class TokenType {
+#include <cstdint>
+
+enum class TokenType : uint8_t {
     // Single character
     LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, LEFT_SQUIGGLE, RIGHT_SQUIGGLE, COMMA, COLON, DOT, MINUS, MINUS_MINUS, PLUS, PLUS_PLUS,
     SEMICOLON, SLASH, STAR, PERCENT, PLUS_EQUAL, MINUS_EQUAL, SLASH_EQUAL, STAR_EQUAL, PERCENT_EQUAL,
@@ -14,12 +16,13 @@ enum class TokenType {
     IDENTIFIER, STRING, NUMBER,
 
     // Keywords
-    AND, CLASS, DEF, ELSE, FALSE, FOR, IF, IN, INPUT, NONE, OR, PRINT, RETURN, SUPER, THIS, TRUE, WHILE,
+    AND, CLASS, DEF, ELSE, FALSE, FOR, IF, IN, INPUT, NONE, OR, PRINT, RETURN, SUPER, THIS, TRUE, WHILE, YIELD,
 
     // Indents and newlines
     INDENT, DEDENT, NEWLINE,
 
-    FSTRING_EXPR,
+    // f"a{x}b{y}c" is FSTRING_START("a") x FSTRING_PART("b") y FSTRING_END("c")
+    FSTRING_START, FSTRING_PART, FSTRING_END,
 
     EOF_
 };
@@ -1,10 +1,12 @@
 #include "../scanner.hpp"
 #include "../token_type.hpp"
 #include "../token.hpp"
+#include "../parallel_scanner.hpp"
+#include "../incremental_scanner.hpp"
+#include <chrono>
 #include <iostream>
 #include <vector>
 #include <cassert>
-#include <any>
 
 std::string tokenTypeToString(TokenType type) {
     static const std::string strings[] = {
@@ -21,25 +23,25 @@ std::string tokenTypeToString(TokenType type) {
         "IDENTIFIER", "STRING", "NUMBER",
 
         // Keywords
-        "AND", "CLASS", "DEF", "ELSE", "FALSE", "FOR", "IF", "IN", "INPUT", "NONE", "OR", "PRINT", "RETURN", "SUPER", "THIS", "TRUE", "WHILE",
+        "AND", "CLASS", "DEF", "ELSE", "FALSE", "FOR", "IF", "IN", "INPUT", "NONE", "OR", "PRINT", "RETURN", "SUPER", "THIS", "TRUE", "WHILE", "YIELD",
 
         // Indents and newlines
         "INDENT", "DEDENT", "NEWLINE",
 
-        "FSTRING_EXPR",
+        "FSTRING_START", "FSTRING_PART", "FSTRING_END",
 
         "EOF_"
     };
     return strings[static_cast<int>(type)];
 }
 
-void printTokens(const std::vector<Token>& tokens) {
+void printTokens(const TokenList& tokens) {
     for (size_t i = 0; i < tokens.size(); ++i) {
         const auto& t = tokens[i];
 
         // Print token index and type
         std::cout << "[" << i << "] " << tokenTypeToString(t.type)
-                  << " : \"" << (t.type == TokenType::EOF_ || t.type == TokenType::NEWLINE ? "" : t.lexeme) << "\"";
+                  << " : \"" << (t.type == TokenType::EOF_ || t.type == TokenType::NEWLINE ? "" : tokens.lexeme(t)) << "\"";
 
         // Handle EOF_ explicitly
         if (t.type == TokenType::EOF_) {
@@ -49,12 +51,12 @@ void printTokens(const std::vector<Token>& tokens) {
             std::cout << " (NEWLINE)";
         }
         // Print literal if it exists
-        else if (t.literal.has_value()) {
+        else if (t.literal != Token::NO_LITERAL) {
             std::cout << " (literal: ";
-            if (t.literal.type() == typeid(std::string)) {
-                std::cout << std::any_cast<std::string>(t.literal);
-            } else if (t.literal.type() == typeid(double)) {
-                std::cout << std::any_cast<double>(t.literal);
+            if (t.type == TokenType::STRING) {
+                std::cout << tokens.lexeme(t);
+            } else if (tokens.literal(t).isNumber()) {
+                std::cout << tokens.literal(t).asNumber();
             } else {
                 std::cout << "unknown";
             }
@@ -66,29 +68,18 @@ void printTokens(const std::vector<Token>& tokens) {
 }
 
 
-
-// Override error function to report during tests
-void error(int line, const std::string& message, const std::string& source, int start, int current) {
-    std::cerr << "[line " << line << "] Error: " << message << "\n";
-    int snippetStart = std::max(0, start - 5);
-    int snippetEnd = std::min((int)source.size(), current + 5);
-    std::cerr << "  source snippet: \"" << source.substr(snippetStart, snippetEnd - snippetStart) << "\"\n";
-    std::cerr << "  start=" << start << ", current=" << current
-              << ", peek='" << (current < source.size() ? source[current] : ' ') << "'\n";
-}
-
 // Helper to compare tokens
-void expect(const Token& token, TokenType type, const std::string& lexeme, int line) {
+void expect(const TokenList& tokens, const Token& token, TokenType type, const std::string& lexeme, int line) {
     if (token.type != type) {
         std::cerr << "[line " << line << "] Expected token type " << static_cast<int>(type)
                   << ", got " << static_cast<int>(token.type) << "\n";
     }
-    if (token.lexeme != lexeme) {
+    if (tokens.lexeme(token) != lexeme) {
         std::cerr << "[line " << line << "] Expected lexeme \"" << lexeme
-                  << "\", got \"" << token.lexeme << "\"\n";
+                  << "\", got \"" << tokens.lexeme(token) << "\"\n";
     }
     assert(token.type == type);
-    assert(token.lexeme == lexeme);
+    assert(tokens.lexeme(token) == lexeme);
 }
 
 // Test 1: basic tokens
@@ -144,19 +135,19 @@ d /= 4
     }
 
     for (size_t i = 0; i < tokens.size() && i < expectedTypes.size(); ++i) {
-        if (tokens[i].type != expectedTypes[i] || tokens[i].lexeme != expectedLexemes[i]) {
+        if (tokens[i].type != expectedTypes[i] || tokens.lexeme(tokens[i]) != expectedLexemes[i]) {
             std::cerr << "[line " << tokens[i].line << "] "
                       << "Expected token type " << static_cast<int>(expectedTypes[i])
                       << ", got " << static_cast<int>(tokens[i].type) << "\n";
             std::cerr << "Expected lexeme \"" << expectedLexemes[i]
-                      << "\", got \"" << tokens[i].lexeme << "\"\n";
+                      << "\", got \"" << tokens.lexeme(tokens[i]) << "\"\n";
         }
     }
 
     assert(tokens.size() == expectedTypes.size());
     for (size_t i = 0; i < tokens.size(); ++i) {
         assert(tokens[i].type == expectedTypes[i]);
-        assert(tokens[i].lexeme == expectedLexemes[i]);
+        assert(tokens.lexeme(tokens[i]) == expectedLexemes[i]);
     }
     std::cout << "test_basic passed!\n";
 }
@@ -171,8 +162,8 @@ void test_string() {
     printTokens(tokens);
 
     assert(tokens.size() >= 2);
-    expect(tokens[0], TokenType::STRING, "hello\nworld", 1);
-    expect(tokens[1], TokenType::EOF_, "", 1);
+    expect(tokens, tokens[0], TokenType::STRING, "hello\nworld", 1);
+    expect(tokens, tokens[1], TokenType::EOF_, "", 1);
     std::cout << "test_string passed\n";
 }
 
@@ -196,7 +187,7 @@ void test_identifiers() {
     assert(tokens.size() == expectedTypes.size());
 
     for (size_t i = 0; i < tokens.size(); i++)
-        expect(tokens[i], expectedTypes[i], expectedLexemes[i], tokens[i].line);
+        expect(tokens, tokens[i], expectedTypes[i], expectedLexemes[i], tokens[i].line);
 
     std::cout << "test_identifiers passed\n";
 }
@@ -209,11 +200,11 @@ void test_fstrings() {
     printTokens(tokens);
 
     std::vector<TokenType> expectedTypes = {
-        TokenType::STRING,
-        TokenType::FSTRING_EXPR,
-        TokenType::STRING,
-        TokenType::FSTRING_EXPR,
-        TokenType::STRING,
+        TokenType::FSTRING_START,
+        TokenType::IDENTIFIER,
+        TokenType::FSTRING_PART,
+        TokenType::IDENTIFIER,
+        TokenType::FSTRING_END,
         TokenType::EOF_
     };
 
@@ -232,8 +223,322 @@ void test_fstrings() {
     }
 
     for (size_t i = 0; i < expectedTypes.size(); i++) {
-        expect(tokens[i], expectedTypes[i], expectedLexemes[i], 1);
+        expect(tokens, tokens[i], expectedTypes[i], expectedLexemes[i], 1);
+    }
+
+    // Expressions are lexed in place: strings with braces in them, nested
+    // f-strings and braces of their own all end where they should
+    std::string nested = R"(f"<{"}" + f"{x}!"}>{ {1} }" f"plain")";
+    auto inner = Scanner(nested).scanTokens();
+    std::vector<TokenType> nestedTypes = {
+        TokenType::FSTRING_START, TokenType::STRING, TokenType::PLUS, TokenType::FSTRING_START,
+        TokenType::IDENTIFIER, TokenType::FSTRING_END, TokenType::FSTRING_PART, TokenType::LEFT_SQUIGGLE,
+        TokenType::NUMBER, TokenType::RIGHT_SQUIGGLE, TokenType::FSTRING_END, TokenType::STRING, TokenType::EOF_
+    };
+    std::vector<std::string> nestedLexemes = {"<", "}", "+", "", "x", "!", ">", "{", "1", "}", "", "plain", ""};
+    assert(inner.size() == nestedTypes.size());
+    for (size_t i = 0; i < nestedTypes.size(); i++) expect(inner, inner[i], nestedTypes[i], nestedLexemes[i], 1);
+}
+
+// Test 5: number literals
+void test_numbers() {
+    std::string source = "42 3.25 0x1F 0XfF 0b101 1_000_000 0x7_f 0b1_0 2.5_5 9223372036854775807 140737488355328 99999999999999999999";
+    Scanner scanner(source);
+    auto tokens = scanner.scanTokens();
+    assert(!scanner.hadError() && tokens.size() == 13);
+    std::vector<int64_t> ints = {42, 0, 31, 255, 5, 1000000, 127, 2};
+    for (size_t i : {0, 2, 3, 4, 5, 6, 7}) assert(tokens.literal(tokens[i]).isInt() && tokens.literal(tokens[i]).asInt() == ints[i]);
+    assert(tokens.literal(tokens[1]).isDouble() && tokens.literal(tokens[1]).asDouble() == 3.25);
+    assert(tokens.literal(tokens[8]).isDouble() && tokens.literal(tokens[8]).asDouble() == 2.55);
+    assert(tokens.lexeme(tokens[5]) == "1_000_000");
+
+    // Past 48 bits an int no longer fits inline; past 64 a decimal is a float
+    assert(tokens.literal(tokens[9]).isNone() && tokens.wideInteger(tokens[9]) == INT64_MAX);
+    assert(tokens.literal(tokens[10]).isNone() && tokens.wideInteger(tokens[10]) == Value::MAX_INT + 1);
+    assert(tokens.literal(tokens[11]).isDouble() && tokens.literal(tokens[11]).asDouble() == 1e20);
+
+    for (const char* bad : {"1__0", "1_", "1_.5", "0x", "0x_ff", "0b2", "12abc", "0x10000000000000000"}) {
+        Scanner malformed(bad);
+        malformed.scanTokens();
+        assert(malformed.hadError());
+    }
+    std::cout << "test_numbers passed\n";
+}
+
+// Test 6: tokens are compact views into the source
+void test_compact_tokens() {
+    std::string source = "total = price * 3 + \"tax\"\n";
+    Scanner scanner(source);
+    auto tokens = scanner.scanTokens();
+
+    printTokens(tokens);
+
+    // Only the number and string literals get a side-table entry
+    assert(tokens.literals.size() == 2);
+    for (const auto& t : tokens) {
+        bool hasLiteral = t.type == TokenType::NUMBER || t.type == TokenType::STRING;
+        assert((t.literal != Token::NO_LITERAL) == hasLiteral);
+    }
+
+    // Non-string lexemes point straight into the source buffer
+    std::string_view total = tokens.lexeme(tokens[0]);
+    assert(total == "total");
+    assert(total.data() == source.data());
+    assert(tokens.lexeme(tokens[2]).data() == source.data() + 8);
+    expect(tokens, tokens[6], TokenType::STRING, "tax", 1);
+    std::cout << "test_compact_tokens passed\n";
+}
+
+// Test 7: pulling tokens one at a time matches the batch scan
+void test_streaming() {
+    std::string source =
+        "def greet(name):\n"
+        "    if name:\n"
+        "        print f\"hi {name}!\"\n"
+        "    return 1.5\n"
+        "x = greet(\"bob\")\n";
+
+    TokenList batch = Scanner(source).scanTokens();
+
+    Scanner streaming(source);
+    size_t i = 0;
+    for (const Token& t : streaming) {
+        assert(i < batch.size());
+        assert(t.type == batch[i].type);
+        assert(t.offset == batch[i].offset && t.length == batch[i].length);
+        assert(t.line == batch[i].line);
+        assert(streaming.lexeme(t) == batch.lexeme(batch[i]));
+        i++;
+    }
+    assert(i == batch.size());
+    assert(batch[batch.size() - 1].type == TokenType::EOF_);
+    assert(batch[batch.size() - 2].type == TokenType::NEWLINE);
+
+    // Literals stay readable through the scanner while the token is recent
+    Scanner numbers("1 2 3");
+    Token one = numbers.nextToken();
+    Token two = numbers.nextToken();
+    assert(numbers.literal(one).isInt() && numbers.literal(one).asInt() == 1);
+    assert(numbers.literal(two).isInt() && numbers.literal(two).asInt() == 2);
+    numbers.nextToken();
+    assert(numbers.nextToken().type == TokenType::EOF_);
+    assert(numbers.nextToken().type == TokenType::EOF_);
+    std::cout << "test_streaming passed\n";
+}
+
+// Test 8: every vectorized kernel set agrees with the scalar one
+void test_scan_kernels() {
+    const ScanKernels* all[3];
+    int count = availableScanKernels(all);
+    const ScanKernels& scalar = *all[count - 1];
+
+    // Mix of long runs and every stop character, including bytes >= 0x80
+    const char alphabet[] = "aZ09 \t\r\n\"\\_{}.\x80\xff";
+    std::string text;
+    unsigned seed = 12345;
+    for (int i = 0; i < 4096; i++) {
+        seed = seed * 1103515245 + 12345;
+        int runLength = (seed >> 16) % 40;
+        char c = alphabet[(seed >> 8) % (sizeof(alphabet) - 1)];
+        text.append(runLength, c);
+    }
+
+    const char* end = text.data() + text.size();
+    for (int k = 0; k < count; k++) {
+        const ScanKernels& kernels = *all[k];
+        for (size_t offset = 0; offset < text.size(); offset += 7) {
+            const char* p = text.data() + offset;
+            assert(kernels.skipBlanks(p, end) == scalar.skipBlanks(p, end));
+            assert(kernels.skipToNewline(p, end) == scalar.skipToNewline(p, end));
+            assert(kernels.skipStringBody(p, end) == scalar.skipStringBody(p, end));
+            assert(kernels.skipIdentifier(p, end) == scalar.skipIdentifier(p, end));
+            assert(kernels.skipDigits(p, end) == scalar.skipDigits(p, end));
+        }
+        std::cout << "kernels " << kernels.name << " match scalar\n";
+    }
+    std::cout << "test_scan_kernels passed\n";
+}
+
+// Test 9: every keyword is recognized and near misses stay identifiers
+void test_keywords() {
+    for (const KeywordEntry& keyword : KEYWORDS) {
+        Scanner scanner(keyword.text);
+        auto tokens = scanner.scanTokens();
+        expect(tokens, tokens[0], keyword.type, std::string(keyword.text), 1);
+    }
+
+    std::string source = "an andx i iff Print prints whiles nonee x1 classy returns";
+    Scanner scanner(source);
+    auto tokens = scanner.scanTokens();
+    assert(tokens.size() == 12);
+    for (size_t i = 0; i + 1 < tokens.size(); i++) assert(tokens[i].type == TokenType::IDENTIFIER);
+    std::cout << "test_keywords passed\n";
+}
+
+static bool sameTokens(const TokenList& a, const TokenList& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].type != b[i].type || a[i].offset != b[i].offset || a[i].length != b[i].length ||
+            a[i].line != b[i].line || a.lexeme(a[i]) != b.lexeme(b[i]) ||
+            Token::literalToString(a.literal(a[i])) != Token::literalToString(b.literal(b[i]))) {
+            std::cerr << "token " << i << " differs: " << a.toString(a[i]) << " vs " << b.toString(b[i]) << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameTokens(const IncrementalScanner& a, const TokenList& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        Token token = a[i];
+        if (token.type != b[i].type || token.offset != b[i].offset || token.length != b[i].length ||
+            token.line != b[i].line || a.lexeme(i) != b.lexeme(b[i]) ||
+            Token::literalToString(a.literal(i)) != Token::literalToString(b.literal(b[i]))) {
+            std::cerr << "token " << i << " differs: " << a.lexeme(i) << " vs " << b.toString(b[i]) << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Test 10: the parallel scanner matches the sequential one token for token
+void test_parallel_scan() {
+    std::string source;
+    for (int i = 0; i < 200; i++) {
+        source += "def f" + std::to_string(i) + "(a, b)\n";
+        source += "    if a >= " + std::to_string(i * 1.5) + "\n";
+        source += "        x = \"multi\nline\nstring\"\n";
+        source += "\n        // a comment\n";
+        source += "        y = f\"{a} and {b\n}\"\n";
+        source += "    return a + b\n";
+        if (i % 7 == 0) source += "z = f\"spans\nlines {x}\"\n";
+    }
+
+    TokenList sequential = Scanner(source).scanTokens();
+    // Many small chunks force boundaries inside strings and f-strings
+    for (unsigned threads : {4u, 64u}) {
+        for (size_t minChunk : {16, 37, 64, 500, 4096}) {
+            TokenList parallel = ParallelScanner(source, threads, minChunk).scanTokens();
+            assert(sameTokens(sequential, parallel));
+        }
+    }
+    std::cout << "test_parallel_scan passed\n";
+}
+
+// Test 11: incremental re-lexing agrees with a full scan after every edit
+void test_incremental_scan() {
+    std::string source;
+    for (int i = 0; i < 200; i++) {
+        source += "def f" + std::to_string(i) + "(a)\n";
+        source += "    if a > 2\n";
+        source += "        s = \"two\nlines\" + f\"{a}!\"\n";
+        source += "    // note\n";
+        source += "    return a\n";
+    }
+    IncrementalScanner incremental(source);
+    assert(sameTokens(incremental, Scanner(source).scanTokens()));
+
+    // A local edit in a big file only re-scans the lines around it
+    size_t middle = source.find("return a", source.size() / 2);
+    auto relex = incremental.edit(middle + 7, 1, "total");
+    assert(relex.scannedBytes < 40);
+    assert(relex.removedTokens == relex.insertedTokens && relex.insertedTokens <= 5);
+    assert(sameTokens(incremental, Scanner(incremental.source()).scanTokens()));
+
+    // A whole line inserted at a line start: the old lines pick up again
+    // right after it
+    incremental.edit(incremental.source().find("    // note", middle), 0, "        t = 2\n");
+    assert(sameTokens(incremental, Scanner(incremental.source()).scanTokens()));
+
+    // Random edits, including quotes, braces, newlines and indentation
+    const char* pieces[] = {"x", " ", "    ", "\n", "\"", "f\"{", "}", "\n    y = 1\n", "// c", "3.5", ""};
+    unsigned seed = 42;
+    for (int i = 0; i < 400; i++) {
+        seed = seed * 1103515245 + 12345;
+        std::string text = incremental.source();
+        size_t offset = (seed >> 8) % (text.size() + 1);
+        size_t removed = std::min<size_t>((seed >> 4) % 4, text.size() - offset);
+        const char* inserted = pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+
+        incremental.edit(offset, removed, inserted);
+        std::string snapshot = incremental.source();
+        TokenList full = Scanner(snapshot).scanTokens();
+        if (!sameTokens(incremental, full)) {
+            std::cerr << "edit " << i << " at " << offset << " diverged\n";
+            assert(false);
+        }
+    }
+    std::cout << "test_incremental_scan passed\n";
+}
+
+// Average time of a one-character insert and delete at `offset`, best of a
+// few rounds.
+static double editSeconds(IncrementalScanner& incremental, size_t offset) {
+    double best = 1e9;
+    for (int round = 0; round < 5; round++) {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < 100; i++) {
+            incremental.edit(offset, 0, "x");
+            incremental.edit(offset, 1, "");
+        }
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - begin;
+        best = std::min(best, took.count() / 200);
+    }
+    return best;
+}
+
+// Test 12: an edit costs the same in a 10k and a 100k line buffer
+void test_incremental_latency() {
+    auto buffer = [](int lines) {
+        std::string source;
+        for (int i = 0; i < lines / 5; i++) {
+            source += "def f" + std::to_string(i) + "(a, b)\n";
+            source += "    if a > 2\n";
+            source += "        s = \"text\" + f\"{a}!\"\n";
+            source += "    // note\n";
+            source += "    return a + b * 3\n";
+        }
+        return source;
+    };
+    std::string smallSource = buffer(10000), largeSource = buffer(100000);
+    IncrementalScanner small(smallSource), large(largeSource);
+    for (double at : {0.0, 0.5}) {
+        size_t smallOffset = smallSource.find("return a", static_cast<size_t>(at * smallSource.size())) + 7;
+        size_t largeOffset = largeSource.find("return a", static_cast<size_t>(at * largeSource.size())) + 7;
+        double smallCost = editSeconds(small, smallOffset);
+        double largeCost = editSeconds(large, largeOffset);
+        assert(largeCost < 3 * smallCost);
+    }
+    assert(sameTokens(large, Scanner(largeSource).scanTokens()));
+    std::cout << "test_incremental_latency passed\n";
+}
+
+// Test 13: identifiers are interned to dense symbol ids
+static void test_interning() {
+    Interner symbols;
+    std::string source = "total = total + count\nif count: total = 0\nprint \"total\"\n";
+    Scanner scanner(source, 1, &symbols);
+    auto tokens = scanner.scanTokens();
+
+    std::vector<uint32_t> ids;
+    for (const Token& token : tokens) {
+        if (token.type == TokenType::IDENTIFIER) ids.push_back(token.literal);
+        else if (token.type != TokenType::STRING && token.type != TokenType::NUMBER) assert(token.literal == Token::NO_LITERAL);
     }
+    assert((ids == std::vector<uint32_t> {0, 0, 1, 1, 0}));
+    assert(symbols.size() == 2 && symbols.name(0) == "total" && symbols.name(1) == "count");
+    assert(symbols.find("count") == 1 && symbols.find("print") == Interner::NONE);
+    assert(tokens.lexeme(tokens[0]) == "total" && !tokens[0].hasLiteral() && tokens.literal(tokens[0]).isNone());
+
+    // Names stay put while the table and the arena grow
+    std::string_view first = symbols.name(0);
+    for (int i = 0; i < 100000; i++) assert(symbols.intern("name" + std::to_string(i)) == SymbolId(i + 2));
+    assert(symbols.name(0).data() == first.data() && symbols.name(0) == "total");
+    assert(symbols.intern("name99999") == 100001 && symbols.name(50002) == "name50000");
+    std::string huge(200000, 'x');
+    assert(symbols.name(symbols.intern(huge)) == huge);
+    std::cout << "test_interning passed\n";
 }
 
 int main() {
@@ -241,6 +546,15 @@ int main() {
     test_string();
     test_identifiers();
     test_fstrings();
+    test_numbers();
+    test_compact_tokens();
+    test_streaming();
+    test_scan_kernels();
+    test_keywords();
+    test_parallel_scan();
+    test_incremental_scan();
+    test_incremental_latency();
+    test_interning();
 
     std::cout << "All tests passed!\n";
     return 0;
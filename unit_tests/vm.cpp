@@ -0,0 +1,794 @@
+#include "../vm.hpp"
+#include "../bytecode_cache.hpp"
+#include "../native_module.hpp"
+#include "../interpreter.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+// Runs a program on a fresh VM and returns what it printed, or its errors.
+static std::string run(const std::string& source, InterpretResult expected = InterpretResult::OK,
+                       const std::string& input = "") {
+    std::ostringstream out, err;
+    std::istringstream in(input);
+    VM vm(out, in, err);
+    InterpretResult result = vm.interpret(source);
+    if (result != expected) {
+        std::cerr << "Unexpected result for:\n" << source << "\n" << err.str();
+    }
+    assert(result == expected);
+    if (result != InterpretResult::OK) return err.str();
+    return out.str();
+}
+
+// Instructions in a chunk with the given opcode.
+static int countOps(const Chunk& chunk, OpCode op) {
+    int count = 0;
+    for (size_t ip = 0; ip < chunk.code.size(); ip += 1 + operandBytes(static_cast<OpCode>(chunk.code[ip]))) {
+        if (static_cast<OpCode>(chunk.code[ip]) == op) count++;
+    }
+    return count;
+}
+
+static void test_values() {
+    static_assert(sizeof(Value) == 8);
+    for (double d : {0.0, -0.0, 1.5, -2.25, 1e308, std::numeric_limits<double>::infinity()}) {
+        Value v = Value::number(d);
+        assert(v.isDouble() && !v.isInt() && !v.isObj() && !v.isNone() && v.asDouble() == d);
+    }
+    Value nan = Value::number(std::nan(""));
+    assert(nan.isDouble() && nan.asDouble() != nan.asDouble() && !nan.same(nan));
+
+    for (int64_t i : {int64_t(0), int64_t(-1), int64_t(42), Value::MAX_INT, Value::MIN_INT}) {
+        Value v = Value::integer(i);
+        assert(v.isInt() && v.isNumber() && !v.isDouble() && v.asInt() == i && v.asNumber() == double(i));
+    }
+    assert(Value::numberOrInt(3.0).isInt() && Value::numberOrInt(3.5).isDouble());
+    assert(Value::numberOrInt(double(Value::MAX_INT) + 1).isDouble());
+
+    assert(Value::none().isNone() && !Value::none().isBool() && !Value::none().isEmpty());
+    assert(Value::boolean(true).isBool() && Value::boolean(true).asBool());
+    assert(Value::boolean(false).isBool() && !Value::boolean(false).asBool());
+    assert(Value::empty().isEmpty() && !Value::empty().isNumber());
+
+    Heap heap;
+    ObjString* string = heap.makeString("boxed");
+    Value object = Value::object(string);
+    assert(object.isObj() && !object.isNumber() && object.asObj() == string && isString(object));
+    assert(valuesEqual(Value::integer(2), Value::number(2.0)) && !Value::integer(2).same(Value::number(2.0)));
+
+    // Integers stay inline until they overflow 48 bits, then become doubles
+    assert(run("print 140737488355327 + 1, 7 * 6, 7 / 7, -3 % 2, 2.5 % 1\n") == "140737488355328 42 1 1 0.5\n");
+    assert(run("big = 140737488355327\nprint big * big > big, -(-140737488355327 - 1)\n") == "true 140737488355328\n");
+    std::cout << "values passed\n";
+}
+
+static void test_expressions() {
+    assert(run("print 1 + 2 * 3, (1 + 2) * 3, 7 / 2, 7 % 3, -7 % 3\n") == "7 9 3.5 1 2\n");
+    assert(run("print 1 < 2, 2 <= 1, \"a\" < \"b\", 1 == 1, \"x\" == \"x\", 1 != none\n") ==
+           "true false true true true true\n");
+    assert(run("print 0 or \"y\", 1 and 2, none and 1, !0, !\"\"\n") == "y 2 none true true\n");
+    assert(run("print \"con\" + \"cat\", [1, 2] + [3], 0.1 + 0.2\n") == "concat [1, 2, 3] 0.30000000000000004\n");
+
+    // f-strings: expressions with strings, braces and f-strings of their own,
+    // joined with neighbouring literals by a single BUILD_STRING
+    assert(run("x = 2\nprint f\"<{\"}\" + f\"{x * 2}!\"}>\" \"|\" f\"{x}{none}{{}}\", f\"\", f\"{\n x}\"\n") ==
+           "<}4!>|2none{}  2\n");
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    vm.optimize = false;
+    ObjFunction* script = vm.compile("a = 1\nprint f\"a{a}b{a + 1}c\" \"d\"\n");
+    assert(script && countOps(script->chunk, OpCode::BUILD_STRING) == 1 && countOps(script->chunk, OpCode::ADD) == 1);
+    assert(vm.interpret(script) == InterpretResult::OK && out.str() == "a1b2cd\n");
+    assert(run("print f\"{1 2}\"\n", InterpretResult::COMPILE_ERROR).find("Expect '}' after f-string expression.") != std::string::npos);
+    assert(run("print f\"{1\n", InterpretResult::COMPILE_ERROR).find("Unterminated expression in f-string.") != std::string::npos);
+    std::cout << "expressions passed\n";
+}
+
+static void test_integers() {
+    assert(run("print 0xff + 0b11, 1_000 * 3, 0x7fff_ffff\n") == "258 3000 2147483647\n");
+
+    // Ints are 64-bit: boxed past 48 bits, floats only past 64
+    assert(run("x = 140737488355327\nprint x + 1, x * 2 + 2, -x - 2, x + 1 - 1\n") ==
+           "140737488355328 281474976710656 -140737488355329 140737488355327\n");
+    assert(run("print 9223372036854775807, -9223372036854775807 - 1, 9223372036854775807 % -1\n") ==
+           "9223372036854775807 -9223372036854775808 0\n");
+    assert(run("print 9223372036854775807 + 1\n") == "9.223372036854776e+18\n");
+    assert(run("print 9007199254740993 != 9007199254740992, 140737488355328 == 140737488355327 + 1, "
+               "140737488355328 > 1.5, [0][140737488355328 - 140737488355328]\n") == "true true true 0\n");
+    assert(run("i = 140737488355326\ni += 1\ni += 1\nprint i, -i\n") == "140737488355328 -140737488355328\n");
+    assert(run("print list(range(140737488355327, 140737488355329))\n") == "[140737488355327, 140737488355328]\n");
+
+    // Boxed ints are heap objects: they move and survive like any other
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err, HeapConfig {1024, 16 * 1024});
+    assert(vm.interpret("total = 0\nfor i in range(10000):\n    total += 140737488355328 + i\nprint total\n") ==
+           InterpretResult::OK);
+    assert(out.str() == "1407374883603275000\n" && vm.heap.gcStats().minorCollections > 0);
+
+    // and round-trip through the bytecode cache
+    std::string source = "print 123456789012345678\n";
+    ObjFunction* script = vm.compile(source);
+    std::string bytes = BytecodeCache::serialize(script, source, vm.symbols, vm.globals);
+    ObjFunction* cached = BytecodeCache::deserialize(bytes, source, vm.heap, vm.symbols, vm.globals);
+    assert(cached && vm.interpret(cached) == InterpretResult::OK);
+    assert(out.str().substr(out.str().find('\n') + 1) == "123456789012345678\n");
+    std::cout << "integers passed\n";
+}
+
+static void test_dicts() {
+    // Every key shares one 7-bit tag, so each lookup sifts a group of false hits
+    DictTable table;
+    for (int64_t i = 0; i < 1000; i++) table.insert(uint64_t(i) << 7 | 5, Value::integer(i), Value::integer(-i));
+    for (int64_t i = 0; i < 1000; i++) {
+        auto* entry = table.find(uint64_t(i) << 7 | 5, [i](Value key) { return key.asInt() == i; });
+        assert(entry && entry->value.asInt() == -i);
+    }
+    assert(!table.find(uint64_t(1000) << 7 | 5, [](Value) { return true; }) && table[999].key.asInt() == 999);
+
+    // Lists keep their first items inline, then spill to the C++ heap
+    ValueList items;
+    for (int64_t i = 0; i < 3; i++) items.push_back(Value::integer(i));
+    ValueList moved(std::move(items));
+    assert(moved.size() == 3 && items.empty() && moved[2].asInt() == 2);
+    for (int64_t i = 3; i < 100; i++) moved.push_back(Value::integer(i));
+    const Value* spilled = moved.data();
+    ValueList stolen(std::move(moved));
+    assert(stolen.data() == spilled && stolen.size() == 100 && stolen[99].asInt() == 99);
+
+    assert(run("d = {\"a\": 1, 2: \"two\", none: [], }\nd[\"a\"] += 10\nd[3.0] = true\nprint d, len(d), d[2], d[3]\n") ==
+           "{\"a\": 11, 2: \"two\", none: [], 3: true} 4 two true\n");
+    assert(run("d = {}\nprint !d, !{1: 1}, d == d, {} == {}\n") == "true false true false\n");
+    assert(run("d = {\"x\": 1, \"y\": 2}\nd[\"x\"] = 3\nfor k in d:\n    print k, d[k]\n") == "x 3\ny 2\n");
+    assert(run("print {1: \"a\", 1.0: \"b\"}, f\"{ {\"k\": 1}[\"k\"] }\"\n") == "{1: \"b\"} 1\n");
+
+    // Long literals are built in batches; growth keeps insertion order
+    std::string literal = "d = {";
+    for (int i = 0; i < 100; i++) literal += std::to_string(i) + ": " + std::to_string(i * i) + ", ";
+    assert(run(literal + "}\nprint len(d), d[99], d[0]\n") == "100 9801 0\n");
+
+    assert(run("print {}[\"missing\"]\n", InterpretResult::RUNTIME_ERROR).find("Key not found.") == 0);
+    assert(run("d = {}\nd[[1]] = 2\n", InterpretResult::RUNTIME_ERROR).find("Dict keys must be") == 0);
+
+    // String keys survive being moved by the collector; their hashes are
+    // content-based
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err, HeapConfig {1024, 16 * 1024});
+    const char* source = "d = {}\n"
+                         "for i in range(3000):\n"
+                         "    d[f\"key{i}\"] = [i]\n"
+                         "    d[i] = f\"v{i}\"\n"
+                         "total = 0\n"
+                         "for i in range(3000):\n"
+                         "    total += d[f\"key{i}\"][0]\n"
+                         "print len(d), total, d[2999], d[\"key7\"]\n";
+    assert(vm.interpret(source) == InterpretResult::OK);
+    assert(out.str() == "6000 4498500 v2999 [7]\n" && vm.heap.gcStats().minorCollections > 0);
+    std::cout << "dicts passed\n";
+}
+
+static void test_variables() {
+    assert(run("a = 1\nb = a = 2\na += 10\nb *= 3\nprint a, b\n") == "12 6\n");
+    assert(run("i = 5\nj = i++\nk = ++i\ni--\nprint i, j, k\n") == "6 5 7\n");
+    assert(run("xs = [1, 2, 3]\nxs[0] = 9\nxs[-1] += 4\nprint xs, xs[1], len(xs)\n") == "[9, 2, 7] 2 3\n");
+    assert(run("s = \"abc\"\nprint s[1], s[-1], len(s)\n") == "b c 3\n");
+    std::cout << "variables passed\n";
+}
+
+static void test_control_flow() {
+    std::string source = R"(
+x = 4
+if x > 5:
+    print "big"
+else if x > 3:
+    print "medium"
+else:
+    print "small"
+n = 0
+while n < 3: n += 1
+print n
+total = 0
+for i in range(1, 5):
+    for j in [10, 20]:
+        total += i * j
+print total
+for c in "hi": print c
+)";
+    assert(run(source) == "medium\n3\n300\nh\ni\n");
+    std::cout << "control flow passed\n";
+}
+
+static void test_functions() {
+    std::string source = R"(
+def fib(n):
+    if n < 2:
+        return n
+    return fib(n - 1) + fib(n - 2)
+
+def greet(name):
+    message = f"hi {name}, fib is {fib(10)}"
+    return message
+
+print greet("axiom")
+count = 0
+def bump():
+    count += 1
+bump()
+bump()
+print count, bump(), str(1.5) + "!"
+)";
+    assert(run(source) == "hi axiom, fib is 55\n2 none 1.5!\n");
+    assert(run("name = input(\"who? \")\nprint name\nprint input()\n", InterpretResult::OK, "ada\n") ==
+           "who? ada\nnone\n");
+    std::cout << "functions passed\n";
+}
+
+static void test_tail_calls() {
+    // Far deeper than FRAMES_MAX: each tail call reuses its caller's frame
+    std::string source = R"(
+def count(n, acc):
+    if n == 0: return acc
+    return count(n - 1, acc + n)
+def isEven(n):
+    if n == 0: return true
+    return isOdd(n - 1)
+def isOdd(n):
+    if n == 0: return false
+    return isEven(n - 1)
+print count(1000000, 0), isEven(100001)
+class P:
+    def init(x):
+        this.x = x
+    def scaled(k):
+        return P(this.x * k)
+def size(xs):
+    return len(xs)
+def nested(n):
+    return count(n, 0) + 1
+print size([1, 2]), P(2).scaled(3).x, nested(10)
+)";
+    assert(run(source) == "500000500000 false\n2 6 56\n");
+    assert(run("def f(a):\n    return f()\nf(1)\n", InterpretResult::RUNTIME_ERROR).find("Expected 1 arguments") == 0);
+    // A generator's frame must stay its own
+    assert(run("def g(n):\n    yield n\n    return g(n + 1)\nfor x in g(1): print x\n") == "1\n");
+
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    ObjFunction* script = vm.compile("def f(n):\n    if n: return f(n - 1)\n    return g(n) + 1\n");
+    ObjFunction* f = asFunction(script->chunk.constants[0]);
+    assert(countOps(f->chunk, OpCode::TAIL_CALL) == 1 && countOps(f->chunk, OpCode::CALL) == 1);
+    std::cout << "tail calls passed\n";
+}
+
+static void test_iteration() {
+    // Ranges are lazy: nothing is stored, whatever their length
+    assert(run("r = range(2, 11, 3)\nprint r, len(r), r[1], r[-1], list(r), range(5), list(range(5, 0, -2))\n") ==
+           "range(2, 11, 3) 3 5 8 [2, 5, 8] range(0, 5) [5, 3, 1]\n");
+    assert(run("print len(range(-9223372036854775807, 9223372036854775807, 2)), range(3, 3) or \"empty\"\n") ==
+           "9223372036854775807 empty\n");
+    assert(run("range(-9223372036854775807 - 1, 9223372036854775807)\n", InterpretResult::RUNTIME_ERROR)
+               .find("range() is too long.") == 0);
+    assert(run("big = range(1_000_000_000_000)\nprint big[999_999_999_999], len(big), list(range(4, -2))\n") ==
+           "999999999999 1000000000000 []\n");
+    assert(run("range(1, 2, 0)\n", InterpretResult::RUNTIME_ERROR).find("range() step must not be zero.") == 0);
+    assert(run("range(3)[3]\n", InterpretResult::RUNTIME_ERROR).find("Index out of range.") == 0);
+
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err, HeapConfig {1024, 16 * 1024});
+    assert(vm.interpret("total = 0\nfor i in range(100000):\n    total += i\nprint total\n") == InterpretResult::OK);
+    assert(out.str() == "4999950000\n" && vm.heap.gcStats().minorCollections == 0);
+
+    // Generators run a step per item, so a pipeline never holds more than
+    // one item per stage
+    std::string source = R"(
+def evens(xs):
+    for x in xs:
+        if x % 2 == 0: yield x
+def squares(xs):
+    for x in xs: yield x * x
+def take(n, xs):
+    for x in xs:
+        if n == 0: return
+        n -= 1
+        yield x
+out = []
+for x in take(3, squares(evens(range(1_000_000_000)))): out += [x]
+print out
+g = evens([1, 2, 3, 4])
+print g
+for x in g: print x
+for x in g: print "again"
+class Tree:
+    def init(left, value, right):
+        this.left = left; this.value = value; this.right = right
+    def walk():
+        if this.left: for x in this.left.walk(): yield x
+        yield this.value
+        if this.right: for x in this.right.walk(): yield x
+t = Tree(Tree(none, 1, none), 2, Tree(Tree(none, 3, none), 4, none))
+for x in t.walk(): print x
+)";
+    assert(run(source) == "[0, 4, 16]\n<generator evens>\n2\n4\n1\n2\n3\n4\n");
+
+    // Suspended generators keep their young locals alive across collections
+    assert(vm.interpret("def words(n):\n    for i in range(n): yield f\"w{i}\"\n"
+                        "s = 0\nfor w in words(5000): s += len(w)\nprint s\n") == InterpretResult::OK);
+    assert(out.str() == "4999950000\n23890\n" && vm.heap.gcStats().minorCollections > 0);
+
+    assert(run("yield 1\n", InterpretResult::COMPILE_ERROR).find("Can't yield from top-level code.") != std::string::npos);
+    assert(run("class A:\n    def init():\n        yield 1\n", InterpretResult::COMPILE_ERROR)
+               .find("Can't yield from an initializer.") != std::string::npos);
+    assert(run("def g():\n    for x in me: yield x\nme = g()\nfor x in me: print x\n", InterpretResult::RUNTIME_ERROR)
+               .find("Generator is already running.") == 0);
+    assert(run("def g():\n    yield 1\nlist(g())\n", InterpretResult::RUNTIME_ERROR).find("list() can't run") == 0);
+    std::cout << "iteration passed\n";
+}
+
+static void test_long_list() {
+    std::string source = "xs = [";
+    for (int i = 0; i < 300; i++) source += std::to_string(i) + ", ";
+    source += "]\nprint len(xs), xs[0], xs[64], xs[299]\n";
+    assert(run(source) == "300 0 64 299\n");
+    std::cout << "long list passed\n";
+}
+
+static void test_errors() {
+    assert(run("print (1 +\n", InterpretResult::COMPILE_ERROR).find("Expect expression.") != std::string::npos);
+    assert(run("1 + 2 = 3\n", InterpretResult::COMPILE_ERROR).find("Invalid assignment target.") != std::string::npos);
+    run("return 1\n", InterpretResult::COMPILE_ERROR);
+    run("def f():\n    x = 1\n    def g():\n        print x\n", InterpretResult::COMPILE_ERROR);
+
+    assert(run("print missing\n", InterpretResult::RUNTIME_ERROR) ==
+           "Undefined variable 'missing'.\n[line 1] in script\n");
+    std::string trace = run("def f(a):\n    return a - \"x\"\n\nf(1)\n", InterpretResult::RUNTIME_ERROR);
+    assert(trace == "Operands must be numbers.\n[line 2] in f()\n[line 4] in script\n");
+    assert(run("[1][3]\n", InterpretResult::RUNTIME_ERROR).find("Index out of range.") == 0);
+    assert(run("def f(a):\n    return a\nf()\n", InterpretResult::RUNTIME_ERROR).find("Expected 1 arguments") == 0);
+    assert(run("def r():\n    return 1 + r()\nr()\n", InterpretResult::RUNTIME_ERROR).find("Stack overflow.") == 0);
+    assert(run("print 1 / 0\n", InterpretResult::RUNTIME_ERROR).find("Division by zero.") == 0);
+    std::cout << "errors passed\n";
+}
+
+static void test_persistent_globals() {
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    assert(vm.interpret("x = 40\ndef add(a, b):\n    return a + b\n") == InterpretResult::OK);
+    assert(vm.interpret("print add(x, 2)\n") == InterpretResult::OK);
+    assert(vm.interpret("print nope\n") == InterpretResult::RUNTIME_ERROR);
+    assert(vm.interpret("print x\n") == InterpretResult::OK);
+    assert(out.str() == "42\n40\n");
+    std::cout << "persistent globals passed\n";
+}
+
+// What a module's init would register: sums a list in place.
+static bool totalNative(VM& vm, int argCount, Value* args, Value* result) {
+    ValueSpan arg = borrowArgs(argCount, args);
+    if (!isList(arg[0])) return vm.runtimeError("total() takes a list.");
+    double sum = 0;
+    for (Value item : borrowList(arg[0])) sum += toDouble(item);
+    *result = Value::number(sum);
+    return true;
+}
+
+static void test_native_modules() {
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    NativeModules::install(vm);
+    ModuleRegistry registry(vm);
+    registry.add("total", totalNative, 1, 1);
+    assert(vm.interpret("print total([1, 2.5, 3]), total(list(range(101)))\n") == InterpretResult::OK);
+    assert(out.str() == "6.5 5050\n");
+
+    assert(vm.interpret("load(\"missing.so\")\n") == InterpretResult::RUNTIME_ERROR);
+    assert(err.str().find("Could not load module 'missing.so'") == 0);
+    assert(vm.interpret("load(1)\n") == InterpretResult::RUNTIME_ERROR);
+    assert(err.str().find("load() takes a path.") != std::string::npos);
+    std::cout << "native modules passed\n";
+}
+
+// Records every report instead of printing it.
+struct RecordingSink : ErrorSink {
+    std::vector<std::string> reports;
+    void scanError(int line, const std::string& message, std::string_view, int, int) override {
+        reports.push_back("scan " + std::to_string(line) + ": " + message);
+    }
+    void compileError(int line, const std::string& where, const std::string& message) override {
+        reports.push_back("compile " + std::to_string(line) + where + ": " + message);
+    }
+    void runtimeError(const std::string& report) override { reports.push_back("runtime " + report); }
+};
+
+static void test_embedding() {
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    RecordingSink sink;
+    vm.errorSink = &sink;
+    assert(vm.interpret("x = 1\nprint (x +\n") == InterpretResult::COMPILE_ERROR);
+    assert(vm.interpret("s = \"open\n") == InterpretResult::COMPILE_ERROR);
+    assert(vm.interpret("def f():\n    return missing\nf()\n") == InterpretResult::RUNTIME_ERROR);
+    assert(sink.reports.size() == 4 && err.str().empty());
+    assert(sink.reports[0] == "compile 2 at end of line: Expect expression.");
+    assert(sink.reports[1] == "scan 2: Unterminated string");
+    assert(sink.reports[2] == "compile 2 at end: Expect expression.");
+    assert(sink.reports[3] == "runtime Undefined variable 'missing'.\n[line 2] in f()\n[line 3] in script\n");
+
+    // An interpreter keeps its globals between runs and captures its output
+    Interpreter interpreter;
+    ScriptResult first = interpreter.run("name = input()\nprint \"hi\", name\n", "ada\n");
+    assert(first.status == InterpretResult::OK && first.output == "hi ada\n" && first.errors.empty());
+    ScriptResult second = interpreter.run("print name + \"!\"\nprint 1 +\n");
+    assert(second.status == InterpretResult::COMPILE_ERROR && second.output.empty());
+    assert(second.errors == "[line 2] Error at end of line: Expect expression.\n");
+    assert(interpreter.run("print name\n").output == "ada\n");
+
+    // Pooled scripts run in isolation, each with its own result
+    InterpreterPool pool(4, HeapConfig {16 * 1024, 1 << 20});
+    std::vector<std::future<ScriptResult>> results;
+    for (int i = 0; i < 200; i++) {
+        std::string n = std::to_string(i);
+        results.push_back(pool.submit("total = 0\nfor i in range(" + n + "):\n    total += i\nprint " + n + ", total\n"));
+    }
+    results.push_back(pool.submit("print name\n"));
+    for (int i = 0; i < 200; i++) {
+        ScriptResult result = results[i].get();
+        assert(result.status == InterpretResult::OK);
+        assert(result.output == std::to_string(i) + " " + std::to_string(i * (i - 1) / 2) + "\n");
+    }
+    ScriptResult isolated = results.back().get();
+    assert(isolated.status == InterpretResult::RUNTIME_ERROR && isolated.errors.find("Undefined variable 'name'.") == 0);
+    std::cout << "embedding passed\n";
+}
+
+static void test_profiler() {
+    Profiler profiler;
+    Profiler::Frame outer[] = {{"", 9}, {"fib", 4}, {"fib", 2}};
+    Profiler::Frame inner[] = {{"", 9}, {"work", 6}};
+    profiler.sample(outer, 3);
+    profiler.sample(outer, 3);
+    profiler.sample(inner, 2);
+    assert(profiler.sampleCount() == 3);
+    std::ostringstream folded, summary;
+    profiler.writeFolded(folded);
+    assert(folded.str() == "<script>:9;fib:4;fib:2 2\n<script>:9;work:6 1\n");
+    profiler.writeSummary(summary);
+    // Recursion counts once towards fib's total
+    assert(summary.str().find("  fib                              66.7%    66.7%\n") != std::string::npos);
+    assert(summary.str().find("  <script>                          0.0%   100.0%\n") != std::string::npos);
+    assert(summary.str().find("  fib:2                            66.7%\n") != std::string::npos);
+
+    // Counting sees every instruction; the results are unchanged
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    Profiler counter(std::chrono::microseconds(1000), true);
+    vm.profiler = &counter;
+    assert(vm.interpret("total = 0\nfor i in range(1000):\n    total += i\nprint total\n") == InterpretResult::OK);
+    assert(out.str() == "499500\n");
+    assert(counter.opcodeCounts[static_cast<int>(OpCode::LOOP)] == 1000);
+    assert(counter.opcodeCounts[static_cast<int>(OpCode::FOR_ITER)] == 1001);
+
+    // Sampling lands in the function doing the work
+    Profiler sampler(std::chrono::microseconds(1000));
+    vm.profiler = &sampler;
+    assert(vm.interpret("def spin(n):\n    total = 0\n    for i in range(n):\n        total += i % 7\n    return total\n") ==
+           InterpretResult::OK);
+    if (sampler.start()) {
+        for (int i = 0; i < 100 && sampler.sampleCount() < 5; i++) {
+            assert(vm.interpret("spin(100000)\n") == InterpretResult::OK);
+        }
+        sampler.stop();
+        assert(sampler.sampleCount() >= 5);
+        std::ostringstream stacks;
+        sampler.writeFolded(stacks);
+        assert(stacks.str().find("<script>:1;spin:") == 0);
+    }
+    vm.profiler = nullptr;
+    std::cout << "profiler passed\n";
+}
+
+static void test_bytecode_cache() {
+    std::string source = R"(
+def square(x):
+    return x * x
+total = 0
+for i in range(4):
+    total += square(i)
+print f"total {total}", 2.5, "done"
+)";
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM writer(out, in, err);
+    ObjFunction* script = writer.compile(source);
+    assert(script);
+    std::string bytes = BytecodeCache::serialize(script, source, writer.symbols, writer.globals);
+
+    // The reader lays its globals out differently; slots are relocated
+    VM reader(out, in, err);
+    assert(reader.interpret("unrelated = 1\nother = 2\n") == InterpretResult::OK);
+    ObjFunction* cached = BytecodeCache::deserialize(bytes, source, reader.heap, reader.symbols, reader.globals);
+    assert(cached && reader.interpret(cached) == InterpretResult::OK);
+    assert(reader.interpret("print total, unrelated\n") == InterpretResult::OK);
+    assert(out.str() == "total 14 2.5 done\n14 1\n");
+
+    // Stale, truncated or damaged caches are misses, never crashes
+    assert(!BytecodeCache::deserialize(bytes, source + " ", reader.heap, reader.symbols, reader.globals));
+    std::string edited = source;
+    edited[edited.find('4')] = '5';
+    assert(!BytecodeCache::deserialize(bytes, edited, reader.heap, reader.symbols, reader.globals));
+    for (size_t length = 0; length < bytes.size(); length += 7) {
+        assert(!BytecodeCache::deserialize(bytes.substr(0, length), source, reader.heap, reader.symbols, reader.globals));
+    }
+    std::string damaged = bytes;
+    damaged[damaged.size() / 2] ^= 0x40;
+    assert(!BytecodeCache::deserialize(damaged, source, reader.heap, reader.symbols, reader.globals));
+
+    assert(BytecodeCache::pathFor("jobs/report.ax") == "jobs/report.axc");
+    assert(BytecodeCache::pathFor("script") == "script.axc");
+    std::cout << "bytecode cache passed\n";
+}
+
+static void test_classes() {
+    std::string source = R"(
+class Point:
+    def init(x, y):
+        this.x = x
+        this.y = y
+    def sum():
+        return this.x + this.y
+
+class Point3(Point):
+    def init(x, y, z):
+        super.init(x, y)
+        this.z = z
+    def sum():
+        return super.sum() + this.z
+
+p = Point(1, 2)
+p.x += 10
+q = Point3(1, 2, 3)
+m = q.sum
+print p.sum(), q.sum(), m(), q, Point
+)";
+    assert(run(source) == "13 6 6 <Point3 instance> <class Point>\n");
+    assert(run("class A: def f(): return 1\na = A()\na.f = 5\nprint a.f\n") == "5\n");
+    // One class statement run twice makes two classes, each with its own super
+    assert(run("class A: def hi(): return \"A\"\nclass B: def hi(): return \"B\"\n"
+               "def make(base):\n    class C(base):\n        def hi(): return super.hi()\n    return C\n"
+               "c1 = make(A)\nc2 = make(B)\nprint c1().hi(), c2().hi()\n") == "A B\n");
+
+    assert(run("print this\n", InterpretResult::COMPILE_ERROR).find("Can't use 'this' outside of a method.") != std::string::npos);
+    run("class A:\n    def f():\n        return super.f()\n", InterpretResult::COMPILE_ERROR);
+    run("class A:\n    def init():\n        return 1\n", InterpretResult::COMPILE_ERROR);
+    assert(run("class A: def f(): return 1\nA().g\n", InterpretResult::RUNTIME_ERROR).find("Undefined property 'g'.") == 0);
+    assert(run("x = 1\nx.y = 2\n", InterpretResult::RUNTIME_ERROR).find("Only instances have fields.") == 0);
+    assert(run("B = 1\nclass A(B): def f(): return 1\n", InterpretResult::RUNTIME_ERROR).find("Superclass must") == 0);
+
+    // Instances that gain the same fields in the same order share a shape
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    assert(vm.interpret("class C: def f(): return 1\na = C()\nb = C()\nc = C()\n"
+                        "a.x = 1\na.y = 2\nb.x = 3\nb.y = 4\nc.y = 5\nc.x = 6\n") == InterpretResult::OK);
+    auto instance = [&vm](const char* name) { return asInstance(vm.globals.values[vm.globals.slot(vm.symbols.intern(name))]); };
+    assert(instance("a")->shape == instance("b")->shape && instance("a")->shape != instance("c")->shape);
+    assert(instance("c")->shape->slotOf(vm.symbols.intern("x")) == 1);
+
+    // A site that sees two shapes stays cached for both
+    vm.cacheStats = InlineCacheStats();
+    assert(vm.interpret("def each(xs):\n    t = 0\n    for o in xs:\n        t += o.x\n    return t\n"
+                        "print each([a, c, a, c, a, c, a, c])\n") == InterpretResult::OK);
+    assert(out.str() == "28\n" && vm.cacheStats.misses == 2 && vm.cacheStats.hits == 6);
+
+    // Inline caches are per function and come back empty from the cache file
+    ObjFunction* script = vm.compile(source);
+    std::string bytes = BytecodeCache::serialize(script, source, vm.symbols, vm.globals);
+    VM reader(out, in, err);
+    ObjFunction* cached = BytecodeCache::deserialize(bytes, source, reader.heap, reader.symbols, reader.globals);
+    assert(cached && cached->caches.size() == script->caches.size() && reader.interpret(cached) == InterpretResult::OK);
+    assert(out.str() == "28\n13 6 6 <Point3 instance> <class Point>\n");
+    std::cout << "classes passed\n";
+}
+
+static void test_gc() {
+    // Nursery allocation is a pointer bump
+    Heap heap;
+    ObjString* a = heap.makeString("ab");
+    ObjString* b = heap.makeString("cd");
+    assert(reinterpret_cast<char*>(b) - reinterpret_cast<char*>(a) == ((sizeof(ObjString) + 3 + 7) & ~size_t(7)));
+
+    // A tiny heap collects constantly. The list and the old nodes are
+    // promoted early and then handed young values, which only the write
+    // barrier keeps alive.
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err, HeapConfig {1024, 16 * 1024});
+    const char* source = "class Node:\n"
+                         "    def init(v):\n"
+                         "        this.v = v\n"
+                         "        this.next = none\n"
+                         "head = Node(\"0\")\n"
+                         "log = [\"start\"]\n"
+                         "for i in range(2000):\n"
+                         "    n = Node(f\"n{i}\")\n"
+                         "    n.next = head\n"
+                         "    head = n\n"
+                         "    log[0] = f\"last {i}\"\n"
+                         "    junk = [f\"{i}{i}\" + \"x\", i]\n"
+                         "count = 0\n"
+                         "node = head\n"
+                         "while node != none:\n"
+                         "    count += 1\n"
+                         "    node = node.next\n"
+                         "print count, head.v, head.next.v, log[0], junk\n";
+    assert(vm.interpret(source) == InterpretResult::OK);
+    assert(out.str() == "2001 n1999 n1998 last 1999 [\"19991999x\", 1999]\n");
+    const GcStats& stats = vm.heap.gcStats();
+    assert(stats.minorCollections > 0 && stats.majorCollections > 0 && stats.freedBytes > 0);
+    assert(stats.minorPause.count() > 0 && stats.maxPause.count() > 0);
+
+    // Globals survive a full collection between runs
+    vm.collectGarbage(true);
+    assert(vm.heap.nurseryUsed() == 0);
+    assert(vm.interpret("print head.next.next.v, len(log)\n") == InterpretResult::OK);
+    assert(out.str().substr(out.str().find('\n') + 1) == "n1997 1\n");
+    std::cout << "gc passed\n";
+}
+
+static ObjFunction* compileWith(VM& vm, const std::string& source, bool optimize) {
+    vm.optimize = optimize;
+    ObjFunction* script = vm.compile(source);
+    assert(script);
+    return script;
+}
+
+static void test_optimizer() {
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+
+    ObjFunction* folded = compileWith(vm, "DAY = 60 * 60 * 24\nprint DAY, f\"{60 * 60}s\", -(2 + 3), 1 < 2\n", true);
+    assert(countOps(folded->chunk, OpCode::MULTIPLY) == 0 && countOps(folded->chunk, OpCode::BUILD_STRING) == 0);
+    assert(countOps(folded->chunk, OpCode::LESS) == 0 && countOps(folded->chunk, OpCode::NEGATE) == 0);
+
+    ObjFunction* dead = compileWith(vm, "if false:\n    print \"never\"\nprint \"after\"\n", true);
+    assert(countOps(dead->chunk, OpCode::PRINT) == 1 && countOps(dead->chunk, OpCode::JUMP_IF_FALSE) == 0);
+
+    std::string loop = "def f(n):\n    i = 0\n    while i < n:\n        i += 1\n    return i\ncount = 0\ncount++\n";
+    ObjFunction* plain = compileWith(vm, loop, false);
+    ObjFunction* optimized = compileWith(vm, loop, true);
+    const Chunk& body = asFunction(optimized->chunk.constants[0])->chunk;
+    assert(countOps(body, OpCode::INC_LOCAL) == 1 && countOps(body, OpCode::JUMP_UNLESS) == 1);
+    assert(countOps(optimized->chunk, OpCode::INC_GLOBAL) == 1);
+    assert(optimized->chunk.code.size() < plain->chunk.code.size());
+    assert(vm.optimizerStats.after < vm.optimizerStats.before && vm.optimizerStats.increments == 2);
+
+    std::string arithmetic = "def k(a, b):\n    c = a * 3 + b % 4\n    d = a + b\n    return c - d\n";
+    const Chunk& fused = asFunction(compileWith(vm, arithmetic, true)->chunk.constants[0])->chunk;
+    assert(countOps(fused, OpCode::LOCAL_OP_CONSTANT) == 2 && countOps(fused, OpCode::GET_LOCALS) == 2);
+    assert(countOps(fused, OpCode::STORE_LOCAL) == 2 && countOps(fused, OpCode::GET_LOCAL) == 0);
+
+    // Same output with and without, including the errors that folding leaves
+    // for the VM
+    const char* programs[] = {
+        "print 7 / 2, 7 % -3, -7.5 % 2, 140737488355327 + 1, 2 * 3 == 6, \"b\" > \"a\", 1 == \"1\"\n",
+        "x = 1\nif x > 0 and 1 < 2: print \"yes\"\nelse: print \"no\"\nprint 0 or 3, true and none, !0\n",
+        "i = 0\nwhile i < 5:\n    if i == 2: print \"two\"\n    i++\nprint i, i--, --i\n",
+        "def g():\n    n = 2.5\n    n -= 1\n    s = \"a\"\n    s += \"b\"\n    return f\"{n} {s} {1 + 1}\"\nprint g()\n",
+        "print 1 / 0\n",
+        "s = \"a\"\ns -= 1\n",
+        "t = [1]\nt += 1\n",
+        "print 1 < \"a\"\n",
+        "if missing < 3: print 1\n",
+        "def k(a, b):\n    c = a * 3 + b % 4 - 1\n    d = a + b\n    return c * d\n"
+        "print k(5, 7), k(2.5, -3), k(140737488355327, 1), k(-3074457345618258602, 0)\n",
+        "def m(s):\n    return s + 1\nprint m(\"a\")\n",
+        "def z(x):\n    return x % 0\nprint z(3)\n",
+        // The else branch's jump lands on a dropped `x; POP`, so `y = 1` must not fuse with `x`
+        "def f(x):\n    if true:\n        y = 1\n    else:\n        x = x\n    x\n    print x\nf(5)\n",
+    };
+    for (const char* program : programs) {
+        std::ostringstream outs[2], errs[2];
+        InterpretResult results[2];
+        for (int optimize = 0; optimize < 2; optimize++) {
+            VM fresh(outs[optimize], in, errs[optimize]);
+            fresh.optimize = optimize;
+            results[optimize] = fresh.interpret(program);
+        }
+        assert(results[0] == results[1] && outs[0].str() == outs[1].str() && errs[0].str() == errs[1].str());
+    }
+
+    // Optimized code round-trips through the cache
+    std::string bytes = BytecodeCache::serialize(optimized, loop, vm.symbols, vm.globals);
+    VM reader(out, in, err);
+    ObjFunction* cached = BytecodeCache::deserialize(bytes, loop, reader.heap, reader.symbols, reader.globals);
+    assert(cached && reader.interpret(cached) == InterpretResult::OK);
+    assert(reader.interpret("print f(4), count\n") == InterpretResult::OK && out.str() == "4 1\n");
+    std::cout << "optimizer passed\n";
+}
+
+#ifdef AXIOM_JIT
+// Machine code must print and fail exactly as the interpreter does,
+// including where its guards hand back mid-loop.
+static void test_jit() {
+    const char* programs[] = {
+        "def spin(n):\n    total = 0\n    i = 0\n    while i < n:\n        total = total + i * 3 % 7 - 1\n        i++\n    return total\nprint spin(1000)\n",
+        "x = 1\nfor i in range(60):\n    x = x * 2\nprint x, -(-140737488355327 - 1)\n",
+        "def mixed(n):\n    t = 0\n    for i in range(n):\n        if i == 5: t = t + 0.5\n        t += i\n    return t\nprint mixed(10)\n",
+        "for i in range(-7, 8):\n    print i % 3, i % -3, -i, i >= 0, !i, i == 2\n",
+        "def fib(n):\n    if n < 2: return n\n    return fib(n - 1) + fib(n - 2)\nprint fib(15)\n",
+        "n = 3\nwhile n:\n    n -= 1\nwhile none: print 1\nfor k in {\"a\": 1, \"b\": 2}: print k\nfor c in \"hi\": print c\n",
+        "s = 0\nfor x in [1, 2.5, \"no\"]:\n    s = s + x\n",
+        "i = 0\nwhile i < 3:\n    i = i + 1\n    if i == 2: print missing\n",
+        "def z(d):\n    i = 0\n    while i < 5:\n        i = i + 10 % d\n    return i\nprint z(3), z(0)\n",
+        "def count(n, acc):\n    if n == 0: return acc\n    return count(n - 1, acc + n)\n"
+        "def even(n):\n    if n == 0: return true\n    return odd(n - 1)\ndef odd(n):\n    if n == 0: return false\n    return even(n - 1)\n"
+        "print count(100000, 0), count(3, 140737488355327), even(1001)\ndef bad(n):\n    return bad()\nbad(1)\n",
+    };
+    for (const char* program : programs) {
+        std::ostringstream outs[2], errs[2];
+        std::istringstream in;
+        InterpretResult results[2];
+        size_t compiled = 0;
+        for (int jit = 0; jit < 2; jit++) {
+            VM vm(outs[jit], in, errs[jit]);
+            vm.jitThreshold = jit ? 0 : UINT32_MAX;
+            results[jit] = vm.interpret(program);
+            if (jit) compiled = vm.jitStats.compiled;
+            else assert(vm.jitStats.compiled == 0);
+        }
+        assert(compiled > 0);
+        assert(results[0] == results[1] && outs[0].str() == outs[1].str() && errs[0].str() == errs[1].str());
+    }
+
+    // Only hot functions are compiled
+    std::ostringstream out, err;
+    std::istringstream in;
+    VM vm(out, in, err);
+    vm.jitThreshold = 100;
+    assert(vm.interpret("def once():\n    return 1\ndef often(n):\n    return n + 1\nonce()\n"
+                        "i = 0\nwhile i < 50:\n    i = often(i)\n") == InterpretResult::OK);
+    assert(vm.jitStats.compiled == 0);
+    assert(vm.interpret("i = 0\nwhile i < 500:\n    i = often(i)\nprint i\n") == InterpretResult::OK);
+    assert(vm.jitStats.compiled == 2 && vm.jitStats.entries > 0 && out.str() == "500\n");
+    std::cout << "jit passed\n";
+}
+#endif
+
+int main() {
+    test_values();
+    test_expressions();
+    test_integers();
+    test_dicts();
+    test_variables();
+    test_control_flow();
+    test_functions();
+    test_tail_calls();
+    test_iteration();
+    test_long_list();
+    test_errors();
+    test_persistent_globals();
+    test_native_modules();
+    test_embedding();
+    test_profiler();
+    test_bytecode_cache();
+    test_optimizer();
+    test_classes();
+    test_gc();
+#ifdef AXIOM_JIT
+    test_jit();
+#endif
+
+    std::cout << "All tests passed!\n";
+    return 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+struct Obj;
+struct ObjString;
+
+// A runtime value in 64 bits. Doubles are stored as themselves; everything
+// else lives in the payload of a quiet NaN that arithmetic never produces:
+//
+//   sign  exponent + quiet  tag  payload (48 bits)
+//   0     0x7ffc            00   1 none, 2 false, 3 true, 4 empty
+//   0     0x7ffc            01   signed 48-bit integer
+//   1     0x7ffc            00   object pointer
+//
+// Type checks are mask-and-compare and no value ever allocates. EMPTY never
+// escapes to Axiom code; it marks unset globals.
+class Value {
+public:
+    static constexpr int64_t MAX_INT = (int64_t(1) << 47) - 1;
+    static constexpr int64_t MIN_INT = -(int64_t(1) << 47);
+
+    Value() : bits(QNAN | NONE_TAG) {}
+
+    static Value none() { return Value(); }
+    static Value boolean(bool b) { return fromBits(QNAN | (b ? TRUE_TAG : FALSE_TAG)); }
+    static Value number(double d) {
+        if (d != d) return fromBits(CANONICAL_NAN); // keep stray NaN payloads out of the tag space
+        uint64_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        return fromBits(bits);
+    }
+    // `i` must be within [MIN_INT, MAX_INT]; see fitsInt().
+    static Value integer(int64_t i) { return fromBits(QNAN | INT_TAG | (static_cast<uint64_t>(i) & PAYLOAD)); }
+    static Value object(Obj* o) { return fromBits(SIGN | QNAN | reinterpret_cast<uintptr_t>(o)); }
+    static Value empty() { return fromBits(QNAN | EMPTY_TAG); }
+
+    static bool fitsInt(int64_t i) { return i >= MIN_INT && i <= MAX_INT; }
+    // An integer when `d` is integral and small enough, otherwise a double.
+    static Value numberOrInt(double d) {
+        if (d >= MIN_INT && d <= MAX_INT && static_cast<double>(static_cast<int64_t>(d)) == d) {
+            return integer(static_cast<int64_t>(d));
+        }
+        return number(d);
+    }
+
+    bool isNone() const { return bits == (QNAN | NONE_TAG); }
+    bool isBool() const { return (bits | 1) == (QNAN | TRUE_TAG); }
+    bool isDouble() const { return (bits & QNAN) != QNAN; }
+    bool isInt() const { return (bits & (SIGN | QNAN | TAG)) == (QNAN | INT_TAG); }
+    bool isNumber() const { return isDouble() || isInt(); }
+    bool isObj() const { return (bits & (SIGN | QNAN)) == (SIGN | QNAN); }
+    bool isEmpty() const { return bits == (QNAN | EMPTY_TAG); }
+
+    bool asBool() const { return bits == (QNAN | TRUE_TAG); }
+    int64_t asInt() const { return static_cast<int64_t>(bits << 16) >> 16; }
+    double asDouble() const {
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        return d;
+    }
+    // Either kind of number as a double.
+    double asNumber() const { return isInt() ? static_cast<double>(asInt()) : asDouble(); }
+    Obj* asObj() const { return reinterpret_cast<Obj*>(static_cast<uintptr_t>(bits & PAYLOAD)); }
+
+    // Identity: same kind and payload. Doubles compare as doubles, so
+    // 0.0 and -0.0 are the same and NaN is not itself.
+    bool same(Value other) const {
+        if (isDouble() && other.isDouble()) return asDouble() == other.asDouble();
+        return bits == other.bits;
+    }
+
+    uint64_t raw() const { return bits; }
+
+private:
+    static constexpr uint64_t SIGN = uint64_t(1) << 63;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+    static constexpr uint64_t TAG = uint64_t(3) << 48;
+    static constexpr uint64_t INT_TAG = uint64_t(1) << 48;
+    static constexpr uint64_t PAYLOAD = (uint64_t(1) << 48) - 1;
+    static constexpr uint64_t NONE_TAG = 1;
+    static constexpr uint64_t FALSE_TAG = 2;
+    static constexpr uint64_t TRUE_TAG = 3;
+    static constexpr uint64_t EMPTY_TAG = 4;
+    static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+
+    uint64_t bits;
+
+    static Value fromBits(uint64_t bits) {
+        Value v;
+        v.bits = bits;
+        return v;
+    }
+};
+
+static_assert(sizeof(Value) == 8, "Value should be one NaN-boxed word");
@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include "value.hpp"
+
+// A list's items: a contiguous growable array that keeps its first INLINE
+// values inside the owning object, so short lists never touch the C++ heap.
+class ValueList {
+public:
+    static constexpr size_t INLINE = 4;
+
+    ValueList() = default;
+    ValueList(const ValueList&) = delete;
+    ValueList& operator=(const ValueList&) = delete;
+    ValueList(ValueList&& other) noexcept : count(other.count), capacity(other.capacity) {
+        if (other.isInline()) {
+            std::copy(other.small, other.small + count, small);
+        } else {
+            items = other.items;
+            other.items = other.small;
+            other.capacity = INLINE;
+        }
+        other.count = 0;
+    }
+    ~ValueList() {
+        if (!isInline()) ::operator delete(items);
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Value* data() { return items; }
+    const Value* data() const { return items; }
+    Value* begin() { return items; }
+    Value* end() { return items + count; }
+    const Value* begin() const { return items; }
+    const Value* end() const { return items + count; }
+    Value& operator[](size_t i) { return items[i]; }
+    const Value& operator[](size_t i) const { return items[i]; }
+
+    void push_back(Value value) {
+        if (count == capacity) grow(count + 1);
+        items[count++] = value;
+    }
+
+    void reserve(size_t wanted) {
+        if (wanted > capacity) grow(wanted);
+    }
+
+    void assign(const Value* first, const Value* last) {
+        count = 0;
+        append(first, last);
+    }
+
+    // `[first, last)` must not lie inside this list.
+    void append(const Value* first, const Value* last) {
+        size_t added = static_cast<size_t>(last - first);
+        if (count + added > capacity) grow(count + added);
+        std::copy(first, last, items + count);
+        count += added;
+    }
+
+private:
+    Value small[INLINE];
+    Value* items = small;
+    size_t count = 0;
+    size_t capacity = INLINE;
+
+    bool isInline() const { return items == small; }
+
+    void grow(size_t wanted) {
+        size_t bigger = std::max(wanted, capacity * 2);
+        // Values are plain bits: the new buffer needs no construction
+        Value* moved = static_cast<Value*>(::operator new(bigger * sizeof(Value)));
+        std::memcpy(moved, items, count * sizeof(Value));
+        if (!isInline()) ::operator delete(items);
+        items = moved;
+        capacity = bigger;
+    }
+};
@@ -0,0 +1,1151 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "chunk.hpp"
+#include "compiler.hpp"
+#include "error_sink.hpp"
+#include "globals.hpp"
+#include "interner.hpp"
+#ifdef AXIOM_JIT
+#include "jit.hpp"
+#endif
+#include "object.hpp"
+#include "profiler.hpp"
+#include "value.hpp"
+
+enum class InterpretResult { OK, COMPILE_ERROR, RUNTIME_ERROR };
+
+// Computed-goto dispatch where the compiler has labels as values. Define
+// AXIOM_SWITCH_DISPATCH to build the portable switch instead, for instance
+// to compare the two with bench/axiom_bench.
+#if defined(__GNUC__) && !defined(AXIOM_SWITCH_DISPATCH)
+#define AXIOM_THREADED_DISPATCH 1
+#endif
+
+// -DAXIOM_JIT builds in the baseline JIT (jit.hpp). AXIOM_JIT_THRESHOLD is
+// the default VM::jitThreshold; 0 compiles everything on first use, which
+// is how the tests exercise the machine code.
+#ifdef AXIOM_JIT
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "AXIOM_JIT needs x86-64 Linux"
+#endif
+#ifndef AXIOM_JIT_THRESHOLD
+#define AXIOM_JIT_THRESHOLD 1000
+#endif
+#endif
+
+// Stack-based bytecode interpreter. Globals and the heap persist across
+// interpret() calls, so a REPL can feed it one line at a time. VMs share no
+// state, so separate VMs may run on separate threads at once.
+class VM {
+public:
+    static constexpr int FRAMES_MAX = 256;
+    static constexpr int STACK_MAX = FRAMES_MAX * 256;
+    static constexpr int STACK_HEADROOM = 512; // temporaries above a frame's slots
+
+    explicit VM(std::ostream& out = std::cout, std::istream& in = std::cin, std::ostream& err = std::cerr,
+                HeapConfig heapConfig = HeapConfig())
+        : heap(heapConfig), out(out), in(in), streamErrors(err), stack(static_cast<Value*>(::operator new(STACK_MAX * sizeof(Value)))) {
+        stackTop = stack.get();
+        initSymbol = symbols.intern("init");
+        defineNative("clock", clockNative, 0, 0);
+        defineNative("len", lenNative, 1, 1);
+        defineNative("list", listNative, 1, 1);
+        defineNative("range", rangeNative, 1, 3);
+        defineNative("str", strNative, 1, 1);
+    }
+
+    InterpretResult interpret(std::string_view source) {
+        ObjFunction* script = compile(source);
+        if (!script) return InterpretResult::COMPILE_ERROR;
+        return interpret(script);
+    }
+
+    // Compiles against this VM's symbols and globals without running.
+    ObjFunction* compile(std::string_view source) {
+        Optimizer optimizer(heap, optimizerStats);
+        return Compiler(heap, symbols, globals, optimize ? &optimizer : nullptr, errorSink).compile(source);
+    }
+
+    InterpretResult interpret(ObjFunction* script) {
+        push(Value::object(script));
+        if (!call(script, 0)) return InterpretResult::RUNTIME_ERROR;
+        if (!profiler) return run<Instrumentation::NONE>();
+        return runProfiled();
+    }
+
+    void defineNative(std::string_view name, NativeFn function, int minArity, int maxArity) {
+        Heap::Tenured tenured(heap);
+        globals.values[globals.slot(symbols.intern(name))] =
+            Value::object(heap.makeNative(function, minArity, maxArity, heap.makeString(name)));
+    }
+
+    // Collects with the stack, call frames and globals as roots. Only safe
+    // between instructions, when no object pointer lives outside them.
+    void collectGarbage(bool major = false) {
+        heap.collect([this](const auto& visit) {
+            for (Value* slot = stack.get(); slot < stackTop; slot++) visit(*slot);
+            for (int i = 0; i < frameCount; i++) {
+                visit(frames[i].function);
+                if (frames[i].generator) visit(frames[i].generator);
+            }
+            for (Value& value : globals.values) visit(value);
+        }, major);
+    }
+
+    // Prints the message and a stack trace, then unwinds everything. Returns
+    // false so natives can `return vm.runtimeError(...)`.
+    bool runtimeError(const std::string& message) {
+        std::string report = message + "\n";
+        std::string last;
+        int repeats = 0;
+        for (int i = frameCount - 1; i >= 0; i--) {
+            const CallFrame& frame = frames[i];
+            const Chunk& chunk = frame.function->chunk;
+            size_t offset = frame.ip - chunk.code.data() - 1;
+            std::string where = "[line " + std::to_string(chunk.lineAt(offset)) + "] in " +
+                                (frame.function->name ? std::string(frame.function->name->view()) + "()" : "script");
+            if (where == last) {
+                repeats++;
+                continue;
+            }
+            if (repeats) report += "  (repeated " + std::to_string(repeats) + " more times)\n";
+            report += where + "\n";
+            last = std::move(where);
+            repeats = 0;
+        }
+        if (repeats) report += "  (repeated " + std::to_string(repeats) + " more times)\n";
+        errorSink->runtimeError(report);
+        resetStack();
+        return false;
+    }
+
+    Heap heap;
+    Interner symbols;
+    Globals globals;
+    bool optimize = true;
+    OptimizerStats optimizerStats; // totals over everything compiled
+    InlineCacheStats cacheStats;   // property accesses served by inline caches
+    Profiler* profiler = nullptr;  // samples interpret() runs while set
+    // Scan, compile and runtime errors; by default written to `err`
+    ErrorSink* errorSink = &streamErrors;
+#ifdef AXIOM_JIT
+    uint32_t jitThreshold = AXIOM_JIT_THRESHOLD; // calls plus back-edges before a function is compiled
+    JitStats jitStats;
+#endif
+
+private:
+    struct CallFrame {
+        ObjFunction* function;
+        const uint8_t* ip;
+        Value* slots;
+        ObjGenerator* generator; // the generator this frame runs, if any
+        uint16_t exit;           // for a generator, its FOR_ITER's jump past the loop
+    };
+
+    std::ostream& out;
+    std::istream& in;
+    StreamErrorSink streamErrors;
+    // Slots are written before they are read, so the stack is left
+    // uninitialized and its pages are only touched as it grows
+    struct FreeStack {
+        void operator()(Value* slots) const { ::operator delete(slots); }
+    };
+    std::unique_ptr<Value, FreeStack> stack;
+    Value* stackTop;
+    CallFrame frames[FRAMES_MAX];
+    int frameCount = 0;
+    std::vector<Profiler::Frame> profileFrames; // scratch for takeSample
+    bool handOff = false;                       // run() stopped for the profiler, not the script
+    SymbolId initSymbol;
+    std::vector<std::string> formatted; // BUILD_STRING's non-string pieces, reused
+#ifdef AXIOM_JIT
+    std::vector<std::unique_ptr<JitCode>> jitCode; // every function's, freed with the VM
+#endif
+
+    void resetStack() {
+        // A generator an error unwound through can't be resumed
+        for (int i = 0; i < frameCount; i++) {
+            if (frames[i].generator) frames[i].generator->state = ObjGenerator::State::DONE;
+        }
+        stackTop = stack.get();
+        frameCount = 0;
+    }
+
+    void push(Value value) { *stackTop++ = value; }
+    Value pop() { return *--stackTop; }
+    Value peek(int distance) const { return stackTop[-1 - distance]; }
+
+    bool call(ObjFunction* function, int argCount) {
+        if (argCount != function->arity) {
+            return runtimeError("Expected " + std::to_string(function->arity) + " arguments but got " +
+                                std::to_string(argCount) + ".");
+        }
+        if (frameCount == FRAMES_MAX ||
+            stackTop + (function->slotCount - argCount - 1) + STACK_HEADROOM > stack.get() + STACK_MAX) {
+            return runtimeError("Stack overflow.");
+        }
+        if (function->generator) return startGenerator(function, argCount);
+        CallFrame& frame = frames[frameCount++];
+        frame.function = function;
+        frame.ip = function->chunk.code.data();
+        frame.slots = stackTop - argCount - 1;
+        frame.generator = nullptr;
+        for (int i = argCount + 1; i < function->slotCount; i++) push(Value::none());
+        return true;
+    }
+
+    // Calling a generator function runs none of it: the frame it would have
+    // had, callee, arguments and locals, is packed into a generator instead.
+    bool startGenerator(ObjFunction* function, int argCount) {
+        ObjGenerator* generator = heap.makeGenerator(function);
+        Value* slots = stackTop - argCount - 1;
+        generator->saved.assign(slots, stackTop);
+        generator->saved.resize(static_cast<size_t>(function->slotCount), Value::none());
+        heap.writeBarrier(generator);
+        stackTop = slots;
+        push(Value::object(generator));
+        return true;
+    }
+
+    // Runs a generator from where it last yielded, in a frame above the
+    // FOR_ITER driving it. Its YIELD returns there; its RETURN leaves the
+    // loop by `exit`.
+    bool resume(ObjGenerator* generator, uint16_t exit) {
+        if (generator->state == ObjGenerator::State::RUNNING) return runtimeError("Generator is already running.");
+        size_t count = generator->saved.size();
+        if (frameCount == FRAMES_MAX || stackTop + count + STACK_HEADROOM > stack.get() + STACK_MAX) {
+            return runtimeError("Stack overflow.");
+        }
+        CallFrame& frame = frames[frameCount++];
+        frame.function = generator->function;
+        frame.ip = generator->function->chunk.code.data() + generator->resume;
+        frame.slots = stackTop;
+        frame.generator = generator;
+        frame.exit = exit;
+        stackTop = std::copy(generator->saved.begin(), generator->saved.end(), stackTop);
+        generator->saved.clear();
+        generator->state = ObjGenerator::State::RUNNING;
+        return true;
+    }
+
+    bool callValue(Value callee, int argCount) {
+        if (isObjType(callee, ObjType::FUNCTION)) return call(asFunction(callee), argCount);
+        if (isObjType(callee, ObjType::NATIVE)) {
+            ObjNative* native = asNative(callee);
+            if (argCount < native->minArity || argCount > native->maxArity) {
+                return runtimeError(std::string(native->name->view()) + "() takes " +
+                                    arityText(native->minArity, native->maxArity) + " but got " +
+                                    std::to_string(argCount) + ".");
+            }
+            Value result;
+            if (!native->function(*this, argCount, stackTop - argCount, &result)) return false;
+            stackTop -= argCount + 1;
+            push(result);
+            return true;
+        }
+        if (isObjType(callee, ObjType::BOUND_METHOD)) {
+            ObjBoundMethod* bound = asBoundMethod(callee);
+            stackTop[-argCount - 1] = bound->receiver;
+            return call(bound->method, argCount);
+        }
+        if (isObjType(callee, ObjType::CLASS)) {
+            ObjClass* klass = asClass(callee);
+            stackTop[-argCount - 1] = Value::object(heap.makeInstance(klass));
+            if (klass->initializer) return call(klass->initializer, argCount);
+            if (argCount != 0) return runtimeError("Expected 0 arguments but got " + std::to_string(argCount) + ".");
+            return true;
+        }
+        return runtimeError("Can only call functions and classes.");
+    }
+
+    // ---- properties --------------------------------------------------------
+
+    // Inline-cache miss on a read: finds the field or method and remembers
+    // it for this shape. nullptr if the instance has neither.
+    const InlineCache::Entry* lookupProperty(InlineCache& cache, ObjInstance* instance, ObjString* name) {
+        cacheStats.misses++;
+        SymbolId symbol = symbols.intern(name->view());
+        InlineCache::Entry entry;
+        entry.shape = instance->shape;
+        int slot = instance->shape->slotOf(symbol);
+        if (slot >= 0) {
+            entry.slot = static_cast<uint32_t>(slot);
+        } else {
+            auto method = instance->klass->methods.find(symbol);
+            if (method == instance->klass->methods.end()) return nullptr;
+            entry.method = method->second;
+        }
+        cache.add(entry);
+        return cache.find(instance->shape);
+    }
+
+    // Inline-cache miss on a write: the existing slot, or the transition to
+    // the shape with the field added.
+    const InlineCache::Entry* lookupField(InlineCache& cache, ObjInstance* instance, ObjString* name) {
+        cacheStats.misses++;
+        SymbolId symbol = symbols.intern(name->view());
+        InlineCache::Entry entry;
+        entry.shape = instance->shape;
+        int slot = instance->shape->slotOf(symbol);
+        if (slot >= 0) {
+            entry.slot = static_cast<uint32_t>(slot);
+        } else {
+            entry.slot = static_cast<uint32_t>(instance->shape->size());
+            entry.next = heap.addField(instance->shape, symbol);
+        }
+        cache.add(entry);
+        return cache.find(instance->shape);
+    }
+
+    bool invoke(ObjString* name, InlineCache& cache, int argCount) {
+        Value receiver = peek(argCount);
+        if (!isInstance(receiver)) return runtimeError("Only instances have methods.");
+        ObjInstance* instance = asInstance(receiver);
+        const InlineCache::Entry* entry = cache.find(instance->shape);
+        if (entry) cacheStats.hits++;
+        else if (!(entry = lookupProperty(cache, instance, name))) return undefinedProperty(name);
+        if (entry->method) return call(entry->method, argCount);
+        // A field holding something callable
+        Value callee = instance->fields[entry->slot];
+        stackTop[-argCount - 1] = callee;
+        return callValue(callee, argCount);
+    }
+
+    // The method `name` of the class above the one that defined the running
+    // method, or nullptr.
+    ObjFunction* superMethod(ObjString* name) {
+        ObjClass* owner = frames[frameCount - 1].function->owner;
+        if (!owner || !owner->superclass) return nullptr;
+        auto method = owner->superclass->methods.find(symbols.intern(name->view()));
+        return method == owner->superclass->methods.end() ? nullptr : method->second;
+    }
+
+    bool undefinedProperty(ObjString* name) {
+        return runtimeError("Undefined property '" + std::string(name->view()) + "'.");
+    }
+
+    static std::string arityText(int minArity, int maxArity) {
+        std::string count = minArity == maxArity ? std::to_string(minArity)
+                                                 : std::to_string(minArity) + " to " + std::to_string(maxArity);
+        return count + (maxArity == 1 ? " argument" : " arguments");
+    }
+
+    // INC_LOCAL / INC_GLOBAL: adds `delta` in place. A negative delta was a
+    // SUBTRACT, so a bad operand is reported the way that would have been.
+    // Returns the error message, or nullptr.
+    const char* incrementError(Value* variable, int delta) {
+        Value value = *variable;
+        int64_t i;
+        if (value.isInt() && Value::fitsInt(i = value.asInt() + delta)) *variable = Value::integer(i);
+        else if (isInteger(value) && addInt(asInteger(value), delta, &i)) *variable = heap.makeInteger(i);
+        else if (isNumeric(value)) *variable = Value::number(toDouble(value) + delta);
+        else return delta < 0 ? "Operands must be numbers." : "Operands must be two numbers, two strings or two lists.";
+        return nullptr;
+    }
+
+    // Index into a list or string, Python-style: negative counts from the
+    // end. Returns the error message, or nullptr if the index is valid.
+    static const char* indexError(Value index, size_t size, size_t* position) {
+        int64_t i;
+        if (isInteger(index)) i = asInteger(index);
+        else if (index.isDouble() && index.asDouble() == std::trunc(index.asDouble())) i = static_cast<int64_t>(index.asDouble());
+        else return "Index must be an integer.";
+        if (i < 0) i += static_cast<int64_t>(size);
+        if (i < 0 || i >= static_cast<int64_t>(size)) return "Index out of range.";
+        *position = static_cast<size_t>(i);
+        return nullptr;
+    }
+
+
+    static const char* keyError(Value key) {
+        uint64_t hash;
+        return hashValue(key, &hash) ? "Key not found." : "Dict keys must be none, bools, numbers or strings.";
+    }
+
+    // Int fast paths for ARITHMETIC_OP. Division always leaves ints.
+    static bool divideNever(int64_t, int64_t, int64_t*) { return false; }
+    static bool moduloInt(int64_t a, int64_t b, int64_t* result) {
+        if (b == 0) return false;
+        *result = a % b;
+        if (*result != 0 && (*result < 0) != (b < 0)) *result += b;
+        return true;
+    }
+
+#ifdef AXIOM_JIT
+    // Counts a call or back-edge of `function`, compiling it once it is hot.
+    // Its machine code, or nullptr to keep interpreting.
+    const JitCode* hotCode(ObjFunction* function) {
+        if (function->jitCode || function->hotness == ObjFunction::JIT_NEVER ||
+            function->hotness++ < jitThreshold) {
+            return function->jitCode;
+        }
+        std::unique_ptr<JitCode> code = JitCompiler(jitStats).compile(function);
+        if (!code) {
+            function->hotness = ObjFunction::JIT_NEVER;
+            return nullptr;
+        }
+        function->jitCode = code.get();
+        jitCode.push_back(std::move(code));
+        return function->jitCode;
+    }
+#endif
+
+    // Hands the call stack, positioned at `ip`, to the profiler.
+    void takeSample(CallFrame* frame, const uint8_t* ip) {
+        frame->ip = ip;
+        profileFrames.clear();
+        for (int i = 0; i < frameCount; i++) {
+            const Chunk& chunk = frames[i].function->chunk;
+            // Callers' ips sit just past their CALL
+            size_t offset = frames[i].ip - chunk.code.data() - (i < frameCount - 1);
+            ObjString* name = frames[i].function->name;
+            profileFrames.push_back({name ? name->view() : std::string_view(), chunk.lineAt(offset)});
+        }
+        profiler->sample(profileFrames.data(), frameCount);
+    }
+
+    // What run() does besides executing. NONE is the loop as it would be
+    // without a profiler. SAMPLED polls the timer only at back-edges, calls
+    // and returns, which every long-running path crosses, and hands off to
+    // STEPPING when it is due. STEPPING runs a pseudo-random number of
+    // further instructions, one at a time, then samples exactly where it
+    // stopped and hands back, so samples land on the lines that spend the
+    // time rather than on the poll points. COUNTED counts every instruction
+    // and polls before each one.
+    enum class Instrumentation { NONE, SAMPLED, STEPPING, COUNTED };
+
+    InterpretResult runProfiled() {
+        if (profiler->countOpcodes) return run<Instrumentation::COUNTED>();
+        for (bool stepping = false;; stepping = !stepping) {
+            InterpretResult result = stepping ? run<Instrumentation::STEPPING>() : run<Instrumentation::SAMPLED>();
+            if (!handOff) return result;
+            handOff = false;
+        }
+    }
+
+    template <Instrumentation MODE>
+    InterpretResult run() {
+        CallFrame* frame = &frames[frameCount - 1];
+        const uint8_t* ip = frame->ip;
+        uint32_t steps = MODE == Instrumentation::STEPPING ? profiler->stride() : 0;
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, static_cast<uint16_t>((ip[-2] << 8) | ip[-1]))
+#define READ_CONSTANT() (frame->function->chunk.constants[READ_SHORT()])
+#define READ_STRING() asString(READ_CONSTANT())
+#define RUNTIME_ERROR(message)                 \
+    do {                                       \
+        frame->ip = ip;                        \
+        runtimeError(message);                 \
+        return InterpretResult::RUNTIME_ERROR; \
+    } while (false)
+// Collects if the heap asks to. Everything live must be on the stack, so
+// values already read into locals are reread afterwards.
+#define SAFEPOINT(...)                 \
+    do {                               \
+        if (heap.needsCollection()) {  \
+            collectGarbage();          \
+            __VA_ARGS__;               \
+        }                              \
+    } while (false)
+// Leaves run() at an instruction boundary for runProfiled to switch loops.
+#define HAND_OFF()                      \
+    do {                                \
+        frame->ip = ip;                 \
+        handOff = true;                 \
+        return InterpretResult::OK;     \
+    } while (false)
+#define POLL_PROFILER()                                                        \
+    do {                                                                       \
+        if constexpr (MODE == Instrumentation::SAMPLED) {                      \
+            if (Profiler::due()) HAND_OFF();                                   \
+        }                                                                      \
+    } while (false)
+// At a function start or loop head: runs the function's machine code, if it
+// is hot, up to the first instruction it leaves to the interpreter. Never
+// while profiling, which needs every instruction interpreted.
+#ifdef AXIOM_JIT
+#define ENTER_JIT()                                                                         \
+    do {                                                                                    \
+        if constexpr (MODE == Instrumentation::NONE) {                                      \
+            const uint8_t* code = frame->function->chunk.code.data();                       \
+            const JitCode* jitted = hotCode(frame->function);                               \
+            if (jitted && jitted->canEnter(ip - code)) {                                    \
+                jitStats.entries++;                                                         \
+                ip = code + jitted->run(ip - code, frame->slots, &stackTop, globals.values.data()); \
+            }                                                                               \
+        }                                                                                   \
+    } while (false)
+#else
+#define ENTER_JIT() do {} while (false)
+#endif
+// Inline ints with an inline result take the fast path; everything else,
+// boxed ints included, goes through the shared helpers.
+#define ARITHMETIC_OP(intOp, opcode, zeroMessage)                                 \
+    do {                                                                          \
+        Value b = peek(0), a = peek(1);                                           \
+        Value result;                                                             \
+        int64_t i;                                                                \
+        if (a.isInt() && b.isInt() && intOp(a.asInt(), b.asInt(), &i) && Value::fitsInt(i)) { \
+            result = Value::integer(i);                                           \
+        } else if (!numericOp(heap, opcode, a, b, &result)) {                     \
+            RUNTIME_ERROR(isNumeric(a) && isNumeric(b) ? zeroMessage : "Operands must be numbers."); \
+        }                                                                         \
+        stackTop -= 2;                                                            \
+        push(result);                                                             \
+    } while (false)
+#define COMPARE_OP(op, opcode)                                                    \
+    do {                                                                          \
+        Value b = peek(0), a = peek(1);                                           \
+        bool result;                                                              \
+        if (a.isInt() && b.isInt()) result = a.asInt() op b.asInt();              \
+        else if (!compareValues(opcode, a, b, &result)) RUNTIME_ERROR("Operands must be two numbers or two strings."); \
+        stackTop -= 2;                                                            \
+        push(Value::boolean(result));                                             \
+    } while (false)
+
+// The profiler's stepping and counting, before every instruction.
+#define BEFORE_INSTRUCTION()                                     \
+    do {                                                         \
+        if constexpr (MODE == Instrumentation::STEPPING) {       \
+            if (steps-- == 0) {                                  \
+                takeSample(frame, ip);                           \
+                HAND_OFF();                                      \
+            }                                                    \
+        } else if constexpr (MODE == Instrumentation::COUNTED) { \
+            if (Profiler::due()) takeSample(frame, ip);          \
+            profiler->opcodeCounts[*ip]++;                       \
+        }                                                        \
+    } while (false)
+#ifdef AXIOM_THREADED_DISPATCH
+// Every handler ends in its own jump through the table to the next one, so
+// each has its own entry in the branch predictor. The switch only starts
+// things off.
+#define CASE(name) case OpCode::name: op_##name
+#define NEXT()                                \
+    do {                                      \
+        BEFORE_INSTRUCTION();                 \
+        goto* dispatchTable[READ_BYTE()];     \
+    } while (false)
+#define HANDLER(name) &&op_##name,
+        static const void* const dispatchTable[] = {AXIOM_OPCODES(HANDLER)};
+#undef HANDLER
+#else
+#define CASE(name) case OpCode::name
+#define NEXT() continue
+#endif
+
+        for (;;) {
+            BEFORE_INSTRUCTION();
+            switch (static_cast<OpCode>(READ_BYTE())) {
+                CASE(CONSTANT): push(READ_CONSTANT()); NEXT();
+                CASE(NONE): push(Value::none()); NEXT();
+                CASE(TRUE): push(Value::boolean(true)); NEXT();
+                CASE(FALSE): push(Value::boolean(false)); NEXT();
+                CASE(POP): stackTop--; NEXT();
+                CASE(DUP): push(peek(0)); NEXT();
+                CASE(DUP2): {
+                    Value a = peek(1), b = peek(0);
+                    push(a);
+                    push(b);
+                    NEXT();
+                }
+                CASE(GET_LOCAL): push(frame->slots[READ_BYTE()]); NEXT();
+                CASE(SET_LOCAL): frame->slots[READ_BYTE()] = peek(0); NEXT();
+                CASE(STORE_LOCAL): frame->slots[READ_BYTE()] = pop(); NEXT();
+                CASE(GET_LOCALS): {
+                    Value* slots = frame->slots;
+                    push(slots[ip[0]]);
+                    push(slots[ip[1]]);
+                    ip += 2;
+                    NEXT();
+                }
+                CASE(LOCAL_OP_CONSTANT): {
+                    Value b = READ_CONSTANT();
+                    Value a = frame->slots[READ_BYTE()];
+                    if (a.isInt() && b.isInt()) {
+                        int64_t x = a.asInt(), y = b.asInt(), i;
+                        bool exact;
+                        switch (static_cast<OpCode>(*ip)) {
+                            case OpCode::ADD: exact = addInt(x, y, &i); break;
+                            case OpCode::SUBTRACT: exact = subtractInt(x, y, &i); break;
+                            case OpCode::MULTIPLY: exact = multiplyInt(x, y, &i); break;
+                            default: exact = moduloInt(x, y, &i); break;
+                        }
+                        if (exact && Value::fitsInt(i)) {
+                            ip++;
+                            push(Value::integer(i));
+                            NEXT();
+                        }
+                    }
+                    // Otherwise the operands go on the stack and the op byte
+                    // runs next as the plain instruction
+                    push(a);
+                    push(b);
+                    NEXT();
+                }
+                CASE(GET_GLOBAL): {
+                    uint16_t slot = READ_SHORT();
+                    Value value = globals.values[slot];
+                    if (value.isEmpty()) RUNTIME_ERROR("Undefined variable '" + std::string(symbols.name(globals.symbols[slot])) + "'.");
+                    push(value);
+                    NEXT();
+                }
+                CASE(SET_GLOBAL): globals.values[READ_SHORT()] = peek(0); NEXT();
+                CASE(INC_LOCAL): {
+                    Value* variable = &frame->slots[READ_BYTE()];
+                    const char* message = incrementError(variable, static_cast<int8_t>(READ_BYTE()));
+                    if (message) RUNTIME_ERROR(message);
+                    NEXT();
+                }
+                CASE(INC_GLOBAL): {
+                    uint16_t slot = READ_SHORT();
+                    int delta = static_cast<int8_t>(READ_BYTE());
+                    if (globals.values[slot].isEmpty()) RUNTIME_ERROR("Undefined variable '" + std::string(symbols.name(globals.symbols[slot])) + "'.");
+                    const char* message = incrementError(&globals.values[slot], delta);
+                    if (message) RUNTIME_ERROR(message);
+                    NEXT();
+                }
+                CASE(GET_INDEX): {
+                    Value index = peek(0), container = peek(1);
+                    size_t position;
+                    Value result;
+                    if (isList(container)) {
+                        ObjList* list = asList(container);
+                        if (const char* message = indexError(index, list->items.size(), &position)) RUNTIME_ERROR(message);
+                        result = list->items[position];
+                    } else if (isString(container)) {
+                        ObjString* string = asString(container);
+                        if (const char* message = indexError(index, string->length, &position)) RUNTIME_ERROR(message);
+                        result = Value::object(heap.makeString(string->view().substr(position, 1)));
+                    } else if (isDict(container)) {
+                        if (!dictGet(asDict(container), index, &result)) RUNTIME_ERROR(keyError(index));
+                    } else if (isRange(container)) {
+                        ObjRange* range = asRange(container);
+                        if (const char* message = indexError(index, range->count, &position)) RUNTIME_ERROR(message);
+                        result = heap.makeInteger(range->at(position));
+                    } else {
+                        RUNTIME_ERROR("Only lists, strings, dicts and ranges can be indexed.");
+                    }
+                    stackTop -= 2;
+                    push(result);
+                    NEXT();
+                }
+                CASE(SET_INDEX): {
+                    Value value = peek(0), index = peek(1), container = peek(2);
+                    if (isDict(container)) {
+                        ObjDict* dict = asDict(container);
+                        if (!dictSet(dict, index, value)) RUNTIME_ERROR(keyError(index));
+                        heap.writeBarrier(dict);
+                        stackTop -= 3;
+                        push(value);
+                        NEXT();
+                    }
+                    if (!isList(container)) RUNTIME_ERROR("Only list and dict elements can be assigned.");
+                    ObjList* list = asList(container);
+                    size_t position;
+                    if (const char* message = indexError(index, list->items.size(), &position)) RUNTIME_ERROR(message);
+                    list->items[position] = value;
+                    heap.writeBarrier(list, value);
+                    stackTop -= 3;
+                    push(value);
+                    NEXT();
+                }
+                CASE(EQUAL): {
+                    Value b = pop(), a = pop();
+                    push(Value::boolean(valuesEqual(a, b)));
+                    NEXT();
+                }
+                CASE(NOT_EQUAL): {
+                    Value b = pop(), a = pop();
+                    push(Value::boolean(!valuesEqual(a, b)));
+                    NEXT();
+                }
+                CASE(GREATER): COMPARE_OP(>, OpCode::GREATER); NEXT();
+                CASE(GREATER_EQUAL): COMPARE_OP(>=, OpCode::GREATER_EQUAL); NEXT();
+                CASE(LESS): COMPARE_OP(<, OpCode::LESS); NEXT();
+                CASE(LESS_EQUAL): COMPARE_OP(<=, OpCode::LESS_EQUAL); NEXT();
+                CASE(ADD): {
+                    Value b = peek(0), a = peek(1);
+                    Value result;
+                    int64_t i;
+                    if (a.isInt() && b.isInt() && Value::fitsInt(i = a.asInt() + b.asInt())) {
+                        result = Value::integer(i);
+                    } else if (isNumeric(a) && isNumeric(b)) {
+                        numericOp(heap, OpCode::ADD, a, b, &result);
+                    } else if (isString(a) && isString(b)) {
+                        SAFEPOINT(b = peek(0), a = peek(1));
+                        result = Value::object(heap.concat(asString(a), asString(b)));
+                    } else if (isList(a) && isList(b)) {
+                        SAFEPOINT(b = peek(0), a = peek(1));
+                        ObjList* list = heap.makeList();
+                        list->items.assign(asList(a)->items.begin(), asList(a)->items.end());
+                        list->items.append(asList(b)->items.begin(), asList(b)->items.end());
+                        result = Value::object(list);
+                    } else {
+                        RUNTIME_ERROR("Operands must be two numbers, two strings or two lists.");
+                    }
+                    stackTop -= 2;
+                    push(result);
+                    NEXT();
+                }
+                CASE(SUBTRACT): ARITHMETIC_OP(subtractInt, OpCode::SUBTRACT, ""); NEXT();
+                CASE(MULTIPLY): ARITHMETIC_OP(multiplyInt, OpCode::MULTIPLY, ""); NEXT();
+                CASE(DIVIDE): ARITHMETIC_OP(divideNever, OpCode::DIVIDE, "Division by zero."); NEXT();
+                CASE(MODULO): ARITHMETIC_OP(moduloInt, OpCode::MODULO, "Modulo by zero."); NEXT();
+                CASE(NOT): push(Value::boolean(isFalsey(pop()))); NEXT();
+                CASE(NEGATE): {
+                    Value a = peek(0), result;
+                    if (a.isInt() && Value::fitsInt(-a.asInt())) result = Value::integer(-a.asInt());
+                    else if (!negateValue(heap, a, &result)) RUNTIME_ERROR("Operand must be a number.");
+                    stackTop--;
+                    push(result);
+                    NEXT();
+                }
+                CASE(BUILD_STRING): {
+                    int count = READ_BYTE();
+                    SAFEPOINT();
+                    Value* pieces = stackTop - count;
+                    if (count == 1 && isString(pieces[0])) NEXT();
+                    // Format first so the result is allocated once, at its final size
+                    size_t length = 0;
+                    formatted.clear();
+                    for (int i = 0; i < count; i++) {
+                        if (isString(pieces[i])) {
+                            length += asString(pieces[i])->length;
+                        } else {
+                            formatted.push_back(valueToString(pieces[i]));
+                            length += formatted.back().size();
+                        }
+                    }
+                    if (length > UINT32_MAX) RUNTIME_ERROR("String too long.");
+                    ObjString* string = heap.buildString(static_cast<uint32_t>(length), [&](char* out) {
+                        size_t next = 0;
+                        for (int i = 0; i < count; i++) {
+                            std::string_view piece = isString(pieces[i]) ? asString(pieces[i])->view()
+                                                                         : std::string_view(formatted[next++]);
+                            std::memcpy(out, piece.data(), piece.size());
+                            out += piece.size();
+                        }
+                    });
+                    stackTop -= count;
+                    push(Value::object(string));
+                    NEXT();
+                }
+                CASE(PRINT): {
+                    int count = READ_BYTE();
+                    for (int i = count - 1; i >= 0; i--) {
+                        out << valueToString(peek(i));
+                        if (i) out << ' ';
+                    }
+                    out << '\n';
+                    stackTop -= count;
+                    NEXT();
+                }
+                CASE(INPUT): {
+                    if (READ_BYTE()) {
+                        out << valueToString(pop());
+                        out.flush();
+                    }
+                    std::string line;
+                    if (std::getline(in, line)) push(Value::object(heap.makeString(line)));
+                    else push(Value::none());
+                    NEXT();
+                }
+                CASE(JUMP): {
+                    uint16_t offset = READ_SHORT();
+                    ip += offset;
+                    NEXT();
+                }
+                CASE(JUMP_IF_FALSE): {
+                    uint16_t offset = READ_SHORT();
+                    if (isFalsey(peek(0))) ip += offset;
+                    NEXT();
+                }
+                CASE(JUMP_UNLESS): {
+                    uint16_t offset = READ_SHORT();
+                    OpCode op = static_cast<OpCode>(READ_BYTE());
+                    Value b = peek(0), a = peek(1);
+                    bool result;
+                    if (a.isInt() && b.isInt()) {
+                        int64_t x = a.asInt(), y = b.asInt();
+                        switch (op) {
+                            case OpCode::EQUAL: result = x == y; break;
+                            case OpCode::NOT_EQUAL: result = x != y; break;
+                            case OpCode::GREATER: result = x > y; break;
+                            case OpCode::GREATER_EQUAL: result = x >= y; break;
+                            case OpCode::LESS: result = x < y; break;
+                            default: result = x <= y; break;
+                        }
+                    } else if (!compareValues(op, a, b, &result)) {
+                        RUNTIME_ERROR("Operands must be two numbers or two strings.");
+                    }
+                    stackTop -= 2;
+                    if (!result) ip += offset;
+                    NEXT();
+                }
+                CASE(LOOP): {
+                    uint16_t offset = READ_SHORT();
+                    ip -= offset;
+                    SAFEPOINT();
+                    POLL_PROFILER();
+                    ENTER_JIT();
+                    NEXT();
+                }
+                CASE(FOR_ITER): {
+                    uint8_t slot = READ_BYTE();
+                    uint16_t exit = READ_SHORT();
+                    Value iterable = frame->slots[slot];
+                    size_t position = static_cast<size_t>(frame->slots[slot + 1].asInt());
+                    if (isRange(iterable)) {
+                        ObjRange* range = asRange(iterable);
+                        if (position >= range->count) {
+                            ip += exit;
+                            NEXT();
+                        }
+                        push(heap.makeInteger(range->at(position)));
+                    } else if (isList(iterable)) {
+                        ObjList* list = asList(iterable);
+                        if (position >= list->items.size()) {
+                            ip += exit;
+                            NEXT();
+                        }
+                        push(list->items[position]);
+                    } else if (isString(iterable)) {
+                        ObjString* string = asString(iterable);
+                        if (position >= string->length) {
+                            ip += exit;
+                            NEXT();
+                        }
+                        push(Value::object(heap.makeString(string->view().substr(position, 1))));
+                    } else if (isDict(iterable)) {
+                        ObjDict* dict = asDict(iterable);
+                        if (position >= dict->table.size()) {
+                            ip += exit;
+                            NEXT();
+                        }
+                        push(dict->table[position].key);
+                    } else if (isGenerator(iterable)) {
+                        // The generator's YIELD pushes the item in this frame
+                        ObjGenerator* generator = asGenerator(iterable);
+                        if (generator->state == ObjGenerator::State::DONE) {
+                            ip += exit;
+                            NEXT();
+                        }
+                        frame->ip = ip;
+                        if (!resume(generator, exit)) return InterpretResult::RUNTIME_ERROR;
+                        frame = &frames[frameCount - 1];
+                        ip = frame->ip;
+                        NEXT();
+                    } else {
+                        RUNTIME_ERROR("Can only iterate over lists, strings, dicts, ranges and generators.");
+                    }
+                    frame->slots[slot + 1] = Value::integer(static_cast<int64_t>(position + 1));
+                    NEXT();
+                }
+                CASE(BUILD_LIST): {
+                    int count = READ_BYTE();
+                    SAFEPOINT();
+                    ObjList* list = heap.makeList();
+                    list->items.assign(stackTop - count, stackTop);
+                    stackTop -= count;
+                    push(Value::object(list));
+                    NEXT();
+                }
+                CASE(EXTEND_LIST): {
+                    int count = READ_BYTE();
+                    ObjList* list = asList(peek(count));
+                    list->items.append(stackTop - count, stackTop);
+                    heap.writeBarrier(list);
+                    stackTop -= count;
+                    NEXT();
+                }
+                CASE(BUILD_DICT): {
+                    int count = READ_BYTE();
+                    SAFEPOINT();
+                    ObjDict* dict = heap.makeDict();
+                    for (Value* pair = stackTop - 2 * count; pair < stackTop; pair += 2) {
+                        if (!dictSet(dict, pair[0], pair[1])) RUNTIME_ERROR(keyError(pair[0]));
+                    }
+                    stackTop -= 2 * count;
+                    push(Value::object(dict));
+                    NEXT();
+                }
+                CASE(EXTEND_DICT): {
+                    int count = READ_BYTE();
+                    ObjDict* dict = asDict(peek(2 * count));
+                    for (Value* pair = stackTop - 2 * count; pair < stackTop; pair += 2) {
+                        if (!dictSet(dict, pair[0], pair[1])) RUNTIME_ERROR(keyError(pair[0]));
+                    }
+                    heap.writeBarrier(dict);
+                    stackTop -= 2 * count;
+                    NEXT();
+                }
+                CASE(CALL): {
+                    int argCount = READ_BYTE();
+                    frame->ip = ip;
+                    SAFEPOINT();
+                    if (!callValue(peek(argCount), argCount)) return InterpretResult::RUNTIME_ERROR;
+                    frame = &frames[frameCount - 1];
+                    ip = frame->ip;
+                    POLL_PROFILER();
+                    if (ip == frame->function->chunk.code.data()) ENTER_JIT();
+                    NEXT();
+                }
+                CASE(TAIL_CALL): {
+                    int argCount = READ_BYTE();
+                    frame->ip = ip;
+                    SAFEPOINT();
+                    // A function takes over this frame: the callee and its
+                    // arguments slide down over the caller's slots, so tail
+                    // recursion runs in constant stack. Any other call is
+                    // made as CALL would, and the RETURN after this returns it.
+                    Value callee = peek(argCount);
+                    if (isObjType(callee, ObjType::FUNCTION) && !frame->generator) {
+                        ObjFunction* function = asFunction(callee);
+                        if (argCount == function->arity && !function->generator &&
+                            frame->slots + function->slotCount + STACK_HEADROOM <= stack.get() + STACK_MAX) {
+                            stackTop = std::copy(stackTop - argCount - 1, stackTop, frame->slots);
+                            for (int i = argCount + 1; i < function->slotCount; i++) push(Value::none());
+                            frame->function = function;
+                            ip = function->chunk.code.data();
+                            POLL_PROFILER();
+                            ENTER_JIT();
+                            NEXT();
+                        }
+                    }
+                    if (!callValue(callee, argCount)) return InterpretResult::RUNTIME_ERROR;
+                    frame = &frames[frameCount - 1];
+                    ip = frame->ip;
+                    POLL_PROFILER();
+                    if (ip == frame->function->chunk.code.data()) ENTER_JIT();
+                    NEXT();
+                }
+                CASE(CLASS):
+                    push(Value::object(heap.makeClass(READ_STRING())));
+                    NEXT();
+                CASE(INHERIT): {
+                    if (!isObjType(peek(0), ObjType::CLASS)) RUNTIME_ERROR("Superclass must be a class.");
+                    ObjClass* superclass = asClass(pop());
+                    ObjClass* klass = asClass(peek(0));
+                    klass->superclass = superclass;
+                    klass->methods = superclass->methods;
+                    klass->initializer = superclass->initializer;
+                    NEXT();
+                }
+                CASE(METHOD): {
+                    SymbolId name = symbols.intern(READ_STRING()->view());
+                    ObjFunction* method = asFunction(pop());
+                    ObjClass* klass = asClass(peek(0));
+                    // Each run of a class statement makes a new class from
+                    // the same function constant; a copy per class keeps
+                    // every class's `super` starting above itself
+                    if (method->owner && method->owner != klass) method = heap.copyFunction(method);
+                    method->owner = klass;
+                    klass->methods[name] = method;
+                    if (name == initSymbol) klass->initializer = method;
+                    NEXT();
+                }
+                CASE(GET_PROPERTY): {
+                    ObjString* name = READ_STRING();
+                    InlineCache& cache = frame->function->caches[READ_SHORT()];
+                    Value receiver = peek(0);
+                    if (!isInstance(receiver)) RUNTIME_ERROR("Only instances have properties.");
+                    ObjInstance* instance = asInstance(receiver);
+                    const InlineCache::Entry* entry = cache.find(instance->shape);
+                    if (entry) {
+                        cacheStats.hits++;
+                    } else if (!(entry = lookupProperty(cache, instance, name))) {
+                        RUNTIME_ERROR("Undefined property '" + std::string(name->view()) + "'.");
+                    }
+                    stackTop[-1] = entry->method ? Value::object(heap.makeBoundMethod(receiver, entry->method))
+                                                 : instance->fields[entry->slot];
+                    NEXT();
+                }
+                CASE(SET_PROPERTY): {
+                    ObjString* name = READ_STRING();
+                    InlineCache& cache = frame->function->caches[READ_SHORT()];
+                    Value receiver = peek(1), value = peek(0);
+                    if (!isInstance(receiver)) RUNTIME_ERROR("Only instances have fields.");
+                    ObjInstance* instance = asInstance(receiver);
+                    const InlineCache::Entry* entry = cache.find(instance->shape);
+                    if (entry) cacheStats.hits++;
+                    else entry = lookupField(cache, instance, name);
+                    if (entry->next) {
+                        instance->shape = entry->next;
+                        instance->fields.push_back(value);
+                    } else {
+                        instance->fields[entry->slot] = value;
+                    }
+                    heap.writeBarrier(instance, value);
+                    stackTop--;
+                    stackTop[-1] = value;
+                    NEXT();
+                }
+                CASE(INVOKE): {
+                    ObjString* name = READ_STRING();
+                    InlineCache& cache = frame->function->caches[READ_SHORT()];
+                    int argCount = READ_BYTE();
+                    frame->ip = ip;
+                    SAFEPOINT();
+                    if (!invoke(name, cache, argCount)) return InterpretResult::RUNTIME_ERROR;
+                    frame = &frames[frameCount - 1];
+                    ip = frame->ip;
+                    POLL_PROFILER();
+                    if (ip == frame->function->chunk.code.data()) ENTER_JIT();
+                    NEXT();
+                }
+                CASE(GET_SUPER): {
+                    ObjString* name = READ_STRING();
+                    ObjFunction* method = superMethod(name);
+                    if (!method) RUNTIME_ERROR("Undefined property '" + std::string(name->view()) + "'.");
+                    stackTop[-1] = Value::object(heap.makeBoundMethod(peek(0), method));
+                    NEXT();
+                }
+                CASE(SUPER_INVOKE): {
+                    ObjString* name = READ_STRING();
+                    int argCount = READ_BYTE();
+                    frame->ip = ip;
+                    SAFEPOINT();
+                    ObjFunction* method = superMethod(name);
+                    if (!(method ? call(method, argCount) : undefinedProperty(name))) return InterpretResult::RUNTIME_ERROR;
+                    frame = &frames[frameCount - 1];
+                    ip = frame->ip;
+                    POLL_PROFILER();
+                    ENTER_JIT();
+                    NEXT();
+                }
+                CASE(YIELD): {
+                    ObjGenerator* generator = frame->generator;
+                    if (!generator) RUNTIME_ERROR("Can only yield inside a generator.");
+                    Value item = pop();
+                    generator->saved.assign(frame->slots, stackTop);
+                    generator->resume = static_cast<uint32_t>(ip - frame->function->chunk.code.data());
+                    generator->state = ObjGenerator::State::SUSPENDED;
+                    heap.writeBarrier(generator);
+                    frameCount--;
+                    stackTop = frame->slots;
+                    push(item);
+                    frame = &frames[frameCount - 1];
+                    ip = frame->ip;
+                    POLL_PROFILER();
+                    NEXT();
+                }
+                CASE(RETURN): {
+                    Value result = pop();
+                    frameCount--;
+                    if (frameCount == 0) {
+                        stackTop = stack.get();
+                        return InterpretResult::OK;
+                    }
+                    stackTop = frame->slots;
+                    if (ObjGenerator* generator = frame->generator) {
+                        // Finished: the value is dropped and the loop driving it ends
+                        generator->state = ObjGenerator::State::DONE;
+                        uint16_t exit = frame->exit;
+                        frame = &frames[frameCount - 1];
+                        ip = frame->ip + exit;
+                    } else {
+                        push(result);
+                        frame = &frames[frameCount - 1];
+                        ip = frame->ip;
+                    }
+                    POLL_PROFILER();
+                    NEXT();
+                }
+            }
+        }
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_STRING
+#undef RUNTIME_ERROR
+#undef SAFEPOINT
+#undef HAND_OFF
+#undef POLL_PROFILER
+#undef ENTER_JIT
+#undef BEFORE_INSTRUCTION
+#undef CASE
+#undef NEXT
+#undef ARITHMETIC_OP
+#undef COMPARE_OP
+    }
+
+    // ---- natives -----------------------------------------------------------
+
+    static bool clockNative(VM&, int, Value*, Value* result) {
+        using namespace std::chrono;
+        *result = Value::number(duration<double>(steady_clock::now().time_since_epoch()).count());
+        return true;
+    }
+
+    static bool lenNative(VM& vm, int, Value* args, Value* result) {
+        if (isString(args[0])) *result = Value::integer(asString(args[0])->length);
+        else if (isList(args[0])) *result = Value::integer(static_cast<int64_t>(asList(args[0])->items.size()));
+        else if (isDict(args[0])) *result = Value::integer(static_cast<int64_t>(asDict(args[0])->table.size()));
+        else if (isRange(args[0])) *result = vm.heap.makeInteger(static_cast<int64_t>(asRange(args[0])->count));
+        else return vm.runtimeError("len() takes a string, a list, a dict or a range.");
+        return true;
+    }
+
+    // A new list of what a for loop over the argument would see. Generators
+    // are left to for loops, since a native can't run script code.
+    static bool listNative(VM& vm, int, Value* args, Value* result) {
+        ObjList* list = vm.heap.makeList();
+        Value value = args[0];
+        if (isList(value)) {
+            list->items.assign(asList(value)->items.begin(), asList(value)->items.end());
+        } else if (isString(value)) {
+            ObjString* string = asString(value);
+            list->items.reserve(string->length);
+            for (uint32_t i = 0; i < string->length; i++) {
+                list->items.push_back(Value::object(vm.heap.makeString(string->view().substr(i, 1))));
+            }
+        } else if (isDict(value)) {
+            for (const DictTable::Entry& entry : asDict(value)->table) list->items.push_back(entry.key);
+        } else if (isRange(value)) {
+            ObjRange* range = asRange(value);
+            if (range->count > UINT32_MAX) return vm.runtimeError("Range too long for a list.");
+            list->items.reserve(static_cast<size_t>(range->count));
+            for (uint64_t i = 0; i < range->count; i++) list->items.push_back(vm.heap.makeInteger(range->at(i)));
+        } else if (isGenerator(value)) {
+            return vm.runtimeError("list() can't run a generator; build the list with a for loop.");
+        } else {
+            return vm.runtimeError("list() takes a list, a string, a dict or a range.");
+        }
+        *result = Value::object(list);
+        return true;
+    }
+
+    // range(stop), range(start, stop) or range(start, stop, step). Lazy: a
+    // for loop over it counts without building a list.
+    static bool rangeNative(VM& vm, int argCount, Value* args, Value* result) {
+        for (int i = 0; i < argCount; i++) {
+            if (!isInteger(args[i])) return vm.runtimeError("range() takes integers.");
+        }
+        int64_t start = argCount >= 2 ? asInteger(args[0]) : 0;
+        int64_t stop = asInteger(args[argCount == 1 ? 0 : 1]);
+        int64_t step = argCount == 3 ? asInteger(args[2]) : 1;
+        if (step == 0) return vm.runtimeError("range() step must not be zero.");
+        ObjRange* range = vm.heap.makeRange(start, stop, step);
+        // so len() and indexing stay in int range
+        if (range->count > static_cast<uint64_t>(INT64_MAX)) return vm.runtimeError("range() is too long.");
+        *result = Value::object(range);
+        return true;
+    }
+
+    static bool strNative(VM& vm, int, Value* args, Value* result) {
+        *result = isString(args[0]) ? args[0] : Value::object(vm.heap.makeString(valueToString(args[0])));
+        return true;
+    }
+};